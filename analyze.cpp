@@ -0,0 +1,454 @@
+//analyze.cpp
+
+#include "defs.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+extern char START_FEN[];
+
+//A game read from a PGN file. Only the tags the analysis reports are kept.
+typedef struct {
+    long index;             //Position of the game in the input, from 1
+    string file;
+    string white, black, result;
+    string fen;             //The FEN tag, empty for the standard start position
+    vector<string> moves;   //Main line moves in SAN
+} S_PGNGAME;
+
+//Reads one game at a time so archives are streamed rather than loaded whole
+typedef struct {
+    vector<string> files;   //Every PGN file to read, in order
+    size_t nextFile;
+    ifstream in;
+    string pending;         //A tag line read past the end of a game without a result, which starts the next one
+    int hasPending;
+    long games;             //Games read so far
+} S_PGNREADER;
+
+//Games waiting for a worker. Bounded, so the reader never gets far ahead of the analysis.
+typedef struct {
+    deque<S_PGNGAME> games;
+    size_t capacity;
+    int done;               //TRUE once the reader has queued every game
+    mutex lock;
+    condition_variable notEmpty;
+    condition_variable notFull;
+} S_GAMEQUEUE;
+
+//Output lines from all workers go through one lock so they are never interleaved
+static mutex OutputLock;
+
+
+/*
+    Name:    JsonString
+    Vars:    const string &s - Text to quote.
+    Purpose: Quote a PGN tag value for a JSON line.
+    Returns: The quoted and escaped string.
+*/
+static string JsonString(const string &s) {
+    string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+
+/*
+    Name:    NextLine
+    Vars:    S_PGNREADER *r - The reader.
+             string *line   - Set to the next line.
+    Purpose: Read the next line of the input, moving on to the next file at the end of each one.
+    Returns: FALSE once every file is read.
+*/
+static int NextLine(S_PGNREADER *r, string *line) {
+    if (r->hasPending) {
+        *line = r->pending;
+        r->hasPending = FALSE;
+        return TRUE;
+    }
+
+    while (TRUE) {
+        if (r->in.is_open() && getline(r->in, *line)) {
+            if (!line->empty() && line->back() == '\r')
+                line->pop_back();
+            return TRUE;
+        }
+        if (r->in.is_open())
+            r->in.close();
+        if (r->nextFile >= r->files.size())
+            return FALSE;
+
+        r->in.clear();
+        r->in.open(r->files[r->nextFile++]);
+        if (!r->in.is_open())
+            cerr << "Cannot open " << r->files[r->nextFile - 1] << "\n";
+    }
+}
+
+
+/*
+    Name:    ReadTag
+    Vars:    const string &line - A tag line. Ex. [White "Carlsen, Magnus"]
+             S_PGNGAME *game    - The game the tag belongs to.
+    Purpose: Store the value of a tag the analysis uses.
+*/
+static void ReadTag(const string &line, S_PGNGAME *game) {
+    size_t nameEnd = line.find(' ');
+    size_t open = line.find('"');
+    size_t close = line.rfind('"');
+    if (nameEnd == string::npos || open == string::npos || close <= open)
+        return;
+
+    string name = line.substr(1, nameEnd - 1);
+    string value;
+    for (size_t i = open + 1; i < close; ++i) {  //Tag values escape quotes and backslashes with a backslash
+        if (line[i] == '\\' && i + 1 < close)
+            ++i;
+        value += line[i];
+    }
+
+    if      (name == "White")  game->white = value;
+    else if (name == "Black")  game->black = value;
+    else if (name == "Result") game->result = value;
+    else if (name == "FEN")    game->fen = value;
+}
+
+
+/*
+    Name:    ReadPgnGame
+    Vars:    S_PGNREADER *r  - The reader.
+             S_PGNGAME *game - Filled with the next game.
+    Purpose: Read the tags and main line of the next game. Comments, variations, NAGs and move numbers are skipped.
+             A game ends at its result token, or at the tags of the next game if the result or the whole movetext is missing.
+    Returns: FALSE once there are no more games.
+*/
+static int ReadPgnGame(S_PGNREADER *r, S_PGNGAME *game) {
+    string line;
+    int inComment = FALSE;  //Inside {...}, which can span lines
+    int variation = 0;      //Depth of (...) variations
+    int ended = FALSE;
+    int tags = FALSE;       //The game has tags
+    int tagsDone = FALSE;   //A line that isn't a tag has followed them
+
+    game->white = game->black = game->result = game->fen = "";
+    game->moves.clear();
+
+    while (!ended && NextLine(r, &line)) {
+        if (!inComment && !line.empty() && line[0] == '[') {
+            if (!game->moves.empty() || tagsDone) {  //The next game started without this one giving a result or any moves
+                r->pending = line;
+                r->hasPending = TRUE;
+                break;
+            }
+            ReadTag(line, game);
+            tags = TRUE;
+            continue;
+        }
+        if (tags)
+            tagsDone = TRUE;
+        if (!inComment && !line.empty() && line[0] == '%')  //Escaped line
+            continue;
+
+        size_t i = 0;
+        while (i < line.size() && !ended) {
+            char c = line[i];
+
+            if (inComment) {
+                if (c == '}') inComment = FALSE;
+                ++i;
+                continue;
+            }
+            if (c == '{') { inComment = TRUE; ++i; continue; }
+            if (c == ';') break;  //Comment to the end of the line
+            if (c == '(') { variation++; ++i; continue; }
+            if (c == ')') { variation--; ++i; continue; }
+            if (isspace((unsigned char)c)) { ++i; continue; }
+
+            size_t start = i;
+            while (i < line.size() && !isspace((unsigned char)line[i]) && strchr("{}();", line[i]) == NULL)
+                ++i;
+            string token = line.substr(start, i - start);
+
+            if (variation > 0 || token[0] == '$')
+                continue;
+
+            if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+                if (game->result.empty())
+                    game->result = token;
+                ended = TRUE;
+                break;
+            }
+
+            //Drop a move number, which can be written against the move. Ex. 12.Nf3 or 12...Nf3
+            size_t digits = 0;
+            while (digits < token.size() && isdigit((unsigned char)token[digits]))
+                ++digits;
+            if (digits > 0 && digits < token.size() && token[digits] == '.') {
+                while (digits < token.size() && token[digits] == '.')
+                    ++digits;
+                token = token.substr(digits);
+            }
+            if (!token.empty() && (!isdigit((unsigned char)token[0]) || token.compare(0, 3, "0-0") == 0))
+                game->moves.push_back(token);
+        }
+    }
+
+    if (game->moves.empty() && game->result.empty() && game->white.empty() && game->fen.empty())
+        return FALSE;
+
+    game->index = ++r->games;
+    game->file = (r->nextFile > 0)? r->files[r->nextFile - 1] : "";
+    return TRUE;
+}
+
+
+/*
+    Name:    ClampScore
+    Vars:    int score - A search score.
+    Purpose: Limit mate scores so a missed mate counts as a large loss instead of an enormous one,
+             and a longer mate than the best is not counted at all.
+    Returns: The score limited to +-1000.
+*/
+static int ClampScore(int score) {
+    return max(-1000, min(1000, score));
+}
+
+
+/*
+    Name:    AnalyzeGame
+    Vars:    S_PGNGAME *game        - The game to analyze.
+             S_BOARD *pos           - The worker's board. Its pv table is kept warm across the game's positions.
+             S_SEARCHINFO *limits   - The search budget of every position.
+             int blunderMargin      - Centipawns a move must lose against the best move to be flagged.
+    Purpose: Search every position of the game and print one JSON line per move with the evaluation after it,
+             the engine's best move, the centipawns lost and a blunder flag. A summary line follows the moves.
+             Evaluations are from white's point of view. The loss of a move is measured from the mover's.
+    Returns: The number of positions searched.
+*/
+static long AnalyzeGame(S_PGNGAME *game, S_BOARD *pos, S_SEARCHINFO *limits, int blunderMargin) {
+    S_SEARCHINFO info[1];
+    *info = *limits;
+    info->quiet = TRUE;
+    info->multiPV = 1;
+
+    char fen[128];
+    snprintf(fen, sizeof(fen), "%s", (game->fen.empty())? START_FEN : game->fen.c_str());
+    if (ParseFen(fen, pos) != 0) {
+        lock_guard<mutex> guard(OutputLock);
+        printf("{\"type\":\"error\",\"game\":%ld,\"error\":\"bad FEN\"}\n", game->index);
+        return 0;
+    }
+
+    int startTime = GetTimeMs();
+    long nodes = 0;
+    long positions = 0;
+    int blunders[2] = {0, 0};
+    int prevBest = NOMOVE;
+    int prevScore = 0;      //Score of the previous position for its side to move
+    int prevScored = FALSE; //FALSE if the previous position's search stopped before its first iteration
+    int prevSide = WHITE;
+    string prevSan;
+    int prevMove = NOMOVE;
+    const char *error = NULL;
+
+    //Position i is searched before move i is played. Move i is reported once position i+1 has been searched, since
+    //the score after a move is the negated score of the position it leads to.
+    for (size_t ply = 0; ply <= game->moves.size(); ++ply) {
+        info->keepHash = (ply > 0);
+        SearchPosition(pos, info);
+        nodes += info->nodes;
+        positions++;
+
+        //A search stopped (ex. by -time) before depth 1 completed has no score. One with no moves to search is scored
+        //without searching, so only a missing best move with legal moves left means that.
+        int scored = (info->bestMove != NOMOVE || !HasLegalMove(pos));
+
+        if (ply > 0) {
+            char move[6], best[6];
+            MoveToUci(prevMove, move);
+            MoveToUci(prevBest, best);
+
+            //The scores are printed as null and the move isn't judged if either side of it has no score
+            char eval[12] = "null", bestEval[12] = "null", loss[12] = "null";
+            int blunder = FALSE;
+            if (scored && prevScored) {
+                int after = -info->bestScore;  //The position after the move, scored for the mover
+                int lost = (prevMove == prevBest)? 0 : max(0, ClampScore(prevScore) - ClampScore(after));
+                blunder = (lost >= blunderMargin);
+                blunders[prevSide] += blunder;
+                snprintf(eval, sizeof(eval), "%d", (prevSide == WHITE)? after : -after);
+                snprintf(bestEval, sizeof(bestEval), "%d", (prevSide == WHITE)? prevScore : -prevScore);
+                snprintf(loss, sizeof(loss), "%d", lost);
+            } else if (scored) {
+                snprintf(eval, sizeof(eval), "%d", (prevSide == WHITE)? -info->bestScore : info->bestScore);
+            } else if (prevScored) {
+                snprintf(bestEval, sizeof(bestEval), "%d", (prevSide == WHITE)? prevScore : -prevScore);
+            }
+
+            lock_guard<mutex> guard(OutputLock);
+            printf("{\"type\":\"move\",\"game\":%ld,\"ply\":%d,\"san\":%s,\"move\":\"%s\",\"eval\":%s,"
+                   "\"best\":%s,\"bestEval\":%s,\"loss\":%s,\"blunder\":%s}\n",
+                   game->index, (int)ply, JsonString(prevSan).c_str(), move, eval,
+                   (prevBest != NOMOVE)? JsonString(best).c_str() : "null", bestEval, loss, (blunder)? "true" : "false");
+        }
+
+        if (ply == game->moves.size())
+            break;
+
+        //Leave room in the history for the search below the last position
+        if (pos->hisPly >= MAXGAMEMOVES - MAXDEPTH - 1) {
+            error = "game too long";
+            break;
+        }
+
+        int move = ParseSan(game->moves[ply].c_str(), pos);
+        if (move == NOMOVE) {
+            error = "illegal move";
+            prevSan = game->moves[ply];
+            break;
+        }
+
+        prevBest = info->bestMove;
+        prevScore = info->bestScore;
+        prevScored = scored;
+        prevSide = pos->side;
+        prevSan = game->moves[ply];
+        prevMove = move;
+        MakeMove(pos, move);
+    }
+
+    lock_guard<mutex> guard(OutputLock);
+    if (error != NULL)
+        printf("{\"type\":\"error\",\"game\":%ld,\"ply\":%d,\"san\":%s,\"error\":\"%s\"}\n",
+               game->index, pos->hisPly + 1, JsonString(prevSan).c_str(), error);
+    printf("{\"type\":\"game\",\"game\":%ld,\"file\":%s,\"white\":%s,\"black\":%s,\"result\":%s,"
+           "\"plies\":%d,\"whiteBlunders\":%d,\"blackBlunders\":%d,\"nodes\":%ld,\"ms\":%d}\n",
+           game->index, JsonString(game->file).c_str(), JsonString(game->white).c_str(),
+           JsonString(game->black).c_str(), JsonString(game->result).c_str(),
+           pos->hisPly, blunders[WHITE], blunders[BLACK], nodes, GetTimeMs() - startTime);
+    fflush(stdout);
+
+    return positions;
+}
+
+
+/*
+    Name:    AnalysisWorker
+    Vars:    S_GAMEQUEUE *queue     - The games to analyze.
+             S_SEARCHINFO *limits   - The search budget of every position.
+             int blunderMargin      - Centipawns a move must lose to be flagged.
+             long *positions        - Set to the number of positions this worker searched.
+    Purpose: Take games off the queue until it is empty and the reader is done. Each worker has its own board and pv table.
+*/
+static void AnalysisWorker(S_GAMEQUEUE *queue, S_SEARCHINFO *limits, int blunderMargin, long *positions) {
+    S_BOARD board[1];
+    board->PvTable->pTable = NULL;
+    InitPvTable(board->PvTable);
+
+    while (TRUE) {
+        S_PGNGAME game;
+        {
+            unique_lock<mutex> guard(queue->lock);
+            queue->notEmpty.wait(guard, [queue] { return !queue->games.empty() || queue->done; });
+            if (queue->games.empty())
+                break;
+            game = move(queue->games.front());
+            queue->games.pop_front();
+        }
+        queue->notFull.notify_one();
+
+        *positions += AnalyzeGame(&game, board, limits, blunderMargin);
+    }
+
+    free(board->PvTable->pTable);
+    ProfileMerge();
+}
+
+
+/*
+    Name:    AnalyzePgn
+    Vars:    const char *path       - A PGN file, or a directory whose .pgn files are read in name order.
+             S_SEARCHINFO *limits   - The search budget of every position: depth, nodeLimit and/or moveTime.
+             int threads            - Worker threads. Games are shared out whole, so each game is searched in order by one worker.
+             int blunderMargin      - Centipawns a move must lose against the best move to be flagged as a blunder.
+    Purpose: Headless batch analysis for game review. Games are streamed from the input through a bounded queue to a pool
+             of workers, which write JSON lines to stdout. A worker keeps its pv table between the positions of a game,
+             so each search starts with the previous position's principal variation.
+    Returns: The number of games analyzed.
+*/
+int AnalyzePgn(const char *path, S_SEARCHINFO *limits, int threads, int blunderMargin) {
+    S_PGNREADER reader;
+    reader.nextFile = 0;
+    reader.hasPending = FALSE;
+    reader.games = 0;
+
+    error_code ec;
+    if (filesystem::is_directory(path, ec)) {
+        for (const auto &entry : filesystem::directory_iterator(path, ec))
+            if (entry.is_regular_file() && entry.path().extension() == ".pgn")
+                reader.files.push_back(entry.path().string());
+        sort(reader.files.begin(), reader.files.end());
+    } else {
+        reader.files.push_back(path);
+    }
+
+    if (threads < 1)
+        threads = 1;
+
+    S_GAMEQUEUE queue;
+    queue.capacity = 2 * threads;
+    queue.done = FALSE;
+
+    int startTime = GetTimeMs();
+    vector<long> positions(threads, 0);
+    vector<thread> workers;
+    for (int i = 0; i < threads; ++i)
+        workers.emplace_back(AnalysisWorker, &queue, limits, blunderMargin, &positions[i]);
+
+    S_PGNGAME game;
+    while (ReadPgnGame(&reader, &game)) {
+        unique_lock<mutex> guard(queue.lock);
+        queue.notFull.wait(guard, [&queue] { return queue.games.size() < queue.capacity; });
+        queue.games.push_back(move(game));
+        guard.unlock();
+        queue.notEmpty.notify_one();
+    }
+
+    {
+        lock_guard<mutex> guard(queue.lock);
+        queue.done = TRUE;
+    }
+    queue.notEmpty.notify_all();
+
+    for (thread &t : workers)
+        t.join();
+
+    long total = 0;
+    for (long p : positions)
+        total += p;
+    cerr << "Analyzed " << reader.games << " games, " << total << " positions in " << GetTimeMs() - startTime << "ms\n";
+    ProfileReport("analyze");
+
+    return (int)reader.games;
+}
@@ -5,11 +5,127 @@
 #include <iostream>
 
 
-//Values define possible moves or move directions and are relative to the 120 int bit board
-const int KnDir[8] = {-8, -19, -21, -12, 8, 19, 21, 12};
-const int RkDir[4] = {-1, -10, 1, 10};
-const int BiDir[4] = {-9, -11, 11, 9};
-const int KiDir[8] = {-1, -10, 1, 10, -9, -11, 11, 9};
+#define LSB(b) (__builtin_ctzll(b))        //Index of the least significant set bit. b must not be 0
+#define MSB(b) (63 - __builtin_clzll(b))   //Index of the most significant set bit. b must not be 0
+
+
+/*
+    Name:    RayAttacks
+    Vars:    int sq64 - The square the ray starts from.
+             U64 occ  - Every occupied square.
+             int dir  - The direction of the ray as given by the DIR_ enum.
+    Purpose: Find the squares a sliding piece reaches in one direction. The ray stops at, and includes, the first blocker.
+    Returns: A bitboard of the reachable squares.
+*/
+static inline U64 RayAttacks(const int sq64, const U64 occ, const int dir) {
+    U64 ray = Rays[dir][sq64];
+    U64 blockers = ray & occ;
+
+    if (blockers) {
+        //Directions towards rank 8 or file H increase the square index, so the nearest blocker is the lowest bit. The rest are the highest.
+        int blockSq = (dir == DIR_N || dir == DIR_NE || dir == DIR_E || dir == DIR_NW)? LSB(blockers) : MSB(blockers);
+        ray ^= Rays[dir][blockSq];
+    }
+    return ray;
+}
+
+/*
+    Name:    BishopAttacks
+    Vars:    int sq64 - The square the bishop is on.
+             U64 occ  - Every occupied square.
+    Purpose: Find the squares a bishop (or the diagonal part of a queen) attacks.
+    Returns: A bitboard of the attacked squares.
+*/
+U64 BishopAttacks(const int sq64, const U64 occ) {
+    return RayAttacks(sq64, occ, DIR_NE) | RayAttacks(sq64, occ, DIR_SE)
+         | RayAttacks(sq64, occ, DIR_SW) | RayAttacks(sq64, occ, DIR_NW);
+}
+
+/*
+    Name:    RookAttacks
+    Vars:    int sq64 - The square the rook is on.
+             U64 occ  - Every occupied square.
+    Purpose: Find the squares a rook (or the straight part of a queen) attacks.
+    Returns: A bitboard of the attacked squares.
+*/
+U64 RookAttacks(const int sq64, const U64 occ) {
+    return RayAttacks(sq64, occ, DIR_N) | RayAttacks(sq64, occ, DIR_E)
+         | RayAttacks(sq64, occ, DIR_S) | RayAttacks(sq64, occ, DIR_W);
+}
+
+/*
+    Name:    AttackersTo
+    Vars:    int sq       - The square being looked at (120 based).
+             U64 occ      - The occupancy to use for sliding pieces. Passing something other than pos->occupied[BOTH]
+                            allows questions like "is the square attacked once the king has left it?"
+             S_BOARD *pos - A pointer to the current position.
+    Purpose: Find every piece of either colour that attacks a square.
+    Returns: A bitboard of the attacking pieces.
+*/
+U64 AttackersTo(const int sq, const U64 occ, const S_BOARD *pos) {
+    ASSERT(SqOnBoard(sq));
+
+    int sq64 = SQ64(sq);
+    U64 bishopsQueens = pos->pceBB[wB] | pos->pceBB[wQ] | pos->pceBB[bB] | pos->pceBB[bQ];
+    U64 rooksQueens   = pos->pceBB[wR] | pos->pceBB[wQ] | pos->pceBB[bR] | pos->pceBB[bQ];
+
+    //A white pawn attacks sq if a black pawn on sq would attack the white pawn's square, and vice versa
+    return (PawnAttacks[BLACK][sq64] & pos->pceBB[wP])
+         | (PawnAttacks[WHITE][sq64] & pos->pceBB[bP])
+         | (KnightAttacks[sq64] & (pos->pceBB[wN] | pos->pceBB[bN]))
+         | (KingAttacks[sq64]   & (pos->pceBB[wK] | pos->pceBB[bK]))
+         | (BishopAttacks(sq64, occ) & bishopsQueens)
+         | (RookAttacks(sq64, occ)   & rooksQueens);
+}
+
+/*
+    Name:    AttackMap
+    Vars:    S_BOARD *pos - A pointer to the current position.
+             int side     - The side attacking.
+    Purpose: Find every square attacked by one side. The map is computed once and cached on the position
+             until the next MakeMove/TakeMove, so repeated queries in a node are a single AND.
+    Returns: A bitboard of the attacked squares.
+*/
+U64 AttackMap(const S_BOARD *pos, const int side) {
+    ASSERT(SideValid(side));
+
+    if (pos->attackMapValid & (1 << side))
+        return pos->attackMap[side];
+
+    U64 occ = pos->occupied[BOTH];
+    U64 map = 0ULL;
+    U64 bb;
+    int pce;
+
+    //Pawns attack diagonally forward. Masking off the edge file stops the shift wrapping onto the other side of the board.
+    bb = pos->pawns[side];
+    if (side == WHITE)
+        map |= ((bb & ~0x0101010101010101ULL) << 7) | ((bb & ~0x8080808080808080ULL) << 9);
+    else
+        map |= ((bb & ~0x0101010101010101ULL) >> 9) | ((bb & ~0x8080808080808080ULL) >> 7);
+
+    pce = (side == WHITE)? wN : bN;
+    for (int i = 0; i < pos->pceNum[pce]; ++i)
+        map |= KnightAttacks[SQ64(pos->pList[pce][i])];
+
+    pce = (side == WHITE)? wB : bB;
+    for (int i = 0; i < pos->pceNum[pce]; ++i)
+        map |= BishopAttacks(SQ64(pos->pList[pce][i]), occ);
+
+    pce = (side == WHITE)? wR : bR;
+    for (int i = 0; i < pos->pceNum[pce]; ++i)
+        map |= RookAttacks(SQ64(pos->pList[pce][i]), occ);
+
+    pce = (side == WHITE)? wQ : bQ;
+    for (int i = 0; i < pos->pceNum[pce]; ++i)
+        map |= BishopAttacks(SQ64(pos->pList[pce][i]), occ) | RookAttacks(SQ64(pos->pList[pce][i]), occ);
+
+    map |= KingAttacks[SQ64(pos->KingSq[side])];
+
+    pos->attackMap[side] = map;
+    pos->attackMapValid |= (1 << side);
+    return map;
+}
 
 /*
     Name:    SqAttacked
@@ -20,73 +136,119 @@ const int KiDir[8] = {-1, -10, 1, 10, -9, -11, 11, 9};
     Returns: TRUE (1) if it is attacked, FALSE(0) otherwise.
 */
 int SqAttacked(const int sq, const int side, const S_BOARD *pos) {
-    int pce, i, t_sq, dir;
+    PROFILE(PROF_SQATTACKED);
 
     //First, ensure that the square is on the board, the side is valid, and the position is valid
     ASSERT(SqOnBoard(sq));
     ASSERT(SideValid(side));
     ASSERT(CheckBoard(pos));
 
-    //Check if a pawn is attacking
-    //If the side attacking is white and there's a white pawn on 1 of 2 possible attacking squares, then the sq is being attacked by a wP. Same idea for black.
-    if (side == WHITE) {
-        if (pos->pieces[sq-11] == wP || pos->pieces[sq-9] == wP)
-            return TRUE;
-    } else {
-        if (pos->pieces[sq+11] == bP || pos->pieces[sq+9] == bP)
-            return TRUE;
-    }
+    //Use the cached attack map when it has already been built for this position
+    if (pos->attackMapValid & (1 << side))
+        return (pos->attackMap[side] & SetMask[SQ64(sq)])? TRUE : FALSE;
 
-    //Check if a knight is attacking
-    //Loop through all possible squares a knight may be attacking from. If the square holds a knight of the attacking colour, return true.
-    for (i = 0; i < 8; ++i) {
-        dir = KnDir[i];
-        t_sq = sq + dir;
-        pce = pos->pieces[t_sq];
-        if(pce != OFFBOARD && pce != EMPTY && IsKn(pce) && PieceCol[pce] == side) //Check that pce is not offboard or empty first since IsKn array only has 13 elements.
-            return TRUE;
-    }
+    int sq64 = SQ64(sq);
+    U64 occ = pos->occupied[BOTH];
+    int pawn   = (side == WHITE)? wP : bP;
+    int knight = (side == WHITE)? wN : bN;
+    int bishop = (side == WHITE)? wB : bB;
+    int rook   = (side == WHITE)? wR : bR;
+    int queen  = (side == WHITE)? wQ : bQ;
+    int king   = (side == WHITE)? wK : bK;
 
-    //Check if a bishop/queen is attacking
-    for (i = 0; i < 4; ++i) {       //Can attack from 4 diagonals
-        dir = BiDir[i];
-        t_sq = sq + dir;
-        pce = pos->pieces[t_sq];
-        while (pce != OFFBOARD) {   //Loop through until a piece is found or the end of the board
-            if (pce != EMPTY) {     //Break once a piece has been found since bishops cannot jump pieces 
-                if (IsBQ(pce) && PieceCol[pce] == side)  //Return true if there's a rook in the attacking square 
-                    return TRUE;
-                break;
-            }
-            t_sq += dir;            //Increment down the row/column
-            pce = pos->pieces[t_sq];
-        }
-    }
+    //Check the cheap, non-sliding pieces first. A pawn of 'side' attacks sq if a pawn of the other colour on sq would attack it.
+    if (PawnAttacks[side ^ 1][sq64] & pos->pceBB[pawn])  return TRUE;
+    if (KnightAttacks[sq64] & pos->pceBB[knight])        return TRUE;
+    if (KingAttacks[sq64] & pos->pceBB[king])            return TRUE;
 
-    //Check if a rook/queen is attacking
-    for (i = 0; i < 4; ++i) {   //Can attack from up, down, left, and right
-        dir = RkDir[i];
-        t_sq = sq + dir;
-        pce = pos->pieces[t_sq];
-        while (pce != OFFBOARD) {   //Loop through the columns/rows since rooks can slide across the entire board
-            if (pce != EMPTY) {     //Since rooks cannot jump pieces, if there's a piece other than a rook, break
-                if (IsRQ(pce) && PieceCol[pce] == side)  //Return true if there's a rook in the attacking square 
-                    return TRUE;
-                break;
-            }
-            t_sq += dir;    //Increment down the row/column
-            pce = pos->pieces[t_sq];
-        }
-    }
+    //Then the sliding pieces, which need the rays to be walked
+    if (BishopAttacks(sq64, occ) & (pos->pceBB[bishop] | pos->pceBB[queen])) return TRUE;
+    if (RookAttacks(sq64, occ) & (pos->pceBB[rook] | pos->pceBB[queen]))     return TRUE;
 
-    //Check if a king is attacking
-    for (i = 0; i < 8; ++i) {   //A king can attack from 8 directions
-        dir = KiDir[i];
-        t_sq = sq + dir;
-        pce = pos->pieces[t_sq];
-        if (pce != OFFBOARD && pce != EMPTY && IsKi(pce) && PieceCol[pce] == side) //Check that pce is not offboard or empty first since IsKi array only has 13 elements.
-            return TRUE;
-    }
-    
     return FALSE; //Finally, return false if no attacking pieces are found
-}
\ No newline at end of file
+}
+
+/*
+    Name:    SliderBlockers
+    Vars:    S_BOARD *pos  - A pointer to the current position.
+             int kingSq64  - The king the sliders are aimed at.
+             int sliderCol - The colour of the sliding pieces.
+    Purpose: Find every piece that is the only thing standing between a slider of sliderCol and the king.
+    Returns: A bitboard of those single blockers, of either colour.
+*/
+static U64 SliderBlockers(const S_BOARD *pos, const int kingSq64, const int sliderCol) {
+    int bishop = (sliderCol == WHITE)? wB : bB;
+    int rook   = (sliderCol == WHITE)? wR : bR;
+    int queen  = (sliderCol == WHITE)? wQ : bQ;
+    U64 blockers = 0ULL;
+
+    //Sliders that would hit the king on an empty board
+    U64 snipers = (BishopAttacks(kingSq64, 0ULL) & (pos->pceBB[bishop] | pos->pceBB[queen]))
+                | (RookAttacks(kingSq64, 0ULL)   & (pos->pceBB[rook]   | pos->pceBB[queen]));
+
+    while (snipers) {
+        U64 between = Between[kingSq64][POP(&snipers)] & pos->occupied[BOTH];
+        if (between && !(between & (between - 1)))  //Exactly one piece in the way
+            blockers |= between;
+    }
+    return blockers;
+}
+
+/*
+    Name:    UpdateCheckInfo
+    Vars:    S_BOARD *pos - A pointer to the current position.
+    Purpose: Compute the checkers, pinned pieces and discovered check candidates for the side to move, if they are not already cached.
+*/
+static void UpdateCheckInfo(const S_BOARD *pos) {
+    if (pos->checkInfoValid)
+        return;
+
+    int side = pos->side;
+    int kingSq64  = SQ64(pos->KingSq[side]);
+    int enemySq64 = SQ64(pos->KingSq[side ^ 1]);
+
+    pos->checkers    = AttackersTo(pos->KingSq[side], pos->occupied[BOTH], pos) & pos->occupied[side ^ 1];
+    pos->pinned      = SliderBlockers(pos, kingSq64, side ^ 1) & pos->occupied[side];
+    pos->discoverers = SliderBlockers(pos, enemySq64, side) & pos->occupied[side];
+    pos->checkInfoValid = TRUE;
+}
+
+/*
+    Name:    Checkers
+    Vars:    S_BOARD *pos - A pointer to the current position.
+    Returns: A bitboard of the pieces giving check to the side to move.
+*/
+U64 Checkers(const S_BOARD *pos) {
+    UpdateCheckInfo(pos);
+    return pos->checkers;
+}
+
+/*
+    Name:    DiscoveredCheckCandidates
+    Vars:    S_BOARD *pos - A pointer to the current position.
+    Returns: A bitboard of the pieces of the side to move that uncover a check on the enemy king when they leave the line.
+*/
+U64 DiscoveredCheckCandidates(const S_BOARD *pos) {
+    UpdateCheckInfo(pos);
+    return pos->discoverers;
+}
+
+/*
+    Name:    InCheck
+    Vars:    S_BOARD *pos - A pointer to the current position.
+    Returns: TRUE if the side to move is in check, FALSE otherwise.
+*/
+int InCheck(const S_BOARD *pos) {
+    UpdateCheckInfo(pos);
+    return (pos->checkers)? TRUE : FALSE;
+}
+
+/*
+    Name:    PinnedPieces
+    Vars:    S_BOARD *pos - A pointer to the current position.
+    Returns: A bitboard of the pieces of the side to move that are pinned to their king.
+*/
+U64 PinnedPieces(const S_BOARD *pos) {
+    UpdateCheckInfo(pos);
+    return pos->pinned;
+}
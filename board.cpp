@@ -17,6 +17,8 @@ using namespace std;
     Returns: True if all asserts pass.
 */
 int CheckBoard(const S_BOARD *pos) {
+    PROFILE(PROF_CHECKBOARD);
+
     //The following t_ variables hold info mirroring the real board.
     int t_pceNum[13] = {0};
     int t_bigPce[2] = {0};
@@ -43,6 +45,8 @@ int CheckBoard(const S_BOARD *pos) {
     for (sq64 = 0; sq64 < 64; ++sq64) {
         t_piece = pos->pieces[SQ120(sq64)];
         ++t_pceNum[t_piece];
+        if (t_piece == EMPTY)       //Empty squares have colour BOTH, which the 2 entry counters can't hold
+            continue;
         colour = PieceCol[t_piece];
         if (PieceBig[t_piece])      t_bigPce[colour]++;
         if (PieceMaj[t_piece])      t_majPce[colour]++;
@@ -78,6 +82,20 @@ int CheckBoard(const S_BOARD *pos) {
         ASSERT(pos->pieces[SQ120(sq64)] == wP || pos->pieces[SQ120(sq64)] == bP);
     }
 
+    //Check the piece and occupancy bitboards against the board
+    U64 t_occupied[3] = {0ULL};
+    for (t_piece = wP; t_piece <= bK; ++t_piece) {
+        U64 t_pceBB = pos->pceBB[t_piece];
+        ASSERT(CNT(t_pceBB) == pos->pceNum[t_piece]);
+        while (t_pceBB) {
+            sq64 = POP(&t_pceBB);
+            ASSERT(pos->pieces[SQ120(sq64)] == t_piece);
+        }
+        t_occupied[PieceCol[t_piece]] |= pos->pceBB[t_piece];
+    }
+    ASSERT(t_occupied[WHITE] == pos->occupied[WHITE] && t_occupied[BLACK] == pos->occupied[BLACK]);
+    ASSERT((t_occupied[WHITE] | t_occupied[BLACK]) == pos->occupied[BOTH]);
+
     //
     ASSERT(t_material[WHITE] == pos->material[WHITE] && t_material[BLACK] == pos->material[BLACK]); //Material counts are the same
     ASSERT(t_minPce[WHITE] == pos->minPce[WHITE] && t_minPce[BLACK] == pos->minPce[BLACK]); //Min piece counts are the same
@@ -95,113 +113,279 @@ int CheckBoard(const S_BOARD *pos) {
 }
 
 /*
-    Name:    ParseFen
-    Vars:    char *fen    - Pointer to the start of the FEN.
-             S_BOARD *pos - Pointer to a position.
-    Purpose: Update the board based on the position defined by the FEN. Generate a position key.
-    Returns: 0 if everything worked correctly, -1 otherwise
+    Name:    FenFail
+    Vars:    size_t at         - Where in the FEN the problem is.
+             size_t *errorAt   - Set to at, if not NULL.
+             const char *error - What is wrong.
+    Returns: The error, for SetupFen to return.
 */
-int ParseFen(char *fen, S_BOARD *pos) {
-    ASSERT(fen != NULL);
-    ASSERT(pos != NULL);
-
-    //Reset all board values
-    int rank = RANK_8;
-    int file = FILE_A;
-    int piece = 0;
-    int count = 0;
-    int i = 0;
-    int sq64 = 0;
-    int sq120 = 0;
+static const char *FenFail(size_t at, size_t *errorAt, const char *error) {
+    if (errorAt != NULL)
+        *errorAt = at;
+    return error;
+}
 
-    ResetBoard(pos);
 
-    //Parse the FEN to extract board info
-    while ((rank >= RANK_1) && *fen) {
-        count = 1;
-        switch (*fen) {
-            case 'p': piece = bP; break;    //If char is a letter, set piece.
-            case 'r': piece = bR; break;
-            case 'n': piece = bN; break;
-            case 'b': piece = bB; break;
-            case 'k': piece = bK; break;
-            case 'q': piece = bQ; break;
-            case 'P': piece = wP; break;
-            case 'R': piece = wR; break;
-            case 'N': piece = wN; break;
-            case 'B': piece = wB; break;
-            case 'K': piece = wK; break;
-            case 'Q': piece = wQ; break;
-
-            case '1':                       //If char is a number, it must represent blank squares
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-                piece = EMPTY;
-                count = *fen - '0';         //Ex. if FEN shows 8, there are 8 blank squares in the row
-                break;
-
-            case '/':                       //If char is '/' or blank, move to the next rank(row) and continue to the next character
-            case ' ':
-                rank--;
-                file = FILE_A;
-                fen++;
-                continue;
+static int IsFenSpace(const char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
 
-            default:
-                cout << "FEN error\n";
-                return -1;
-        }
 
-        //Place the piece given by the current position in the FEN on the board and update the file(column) number
-        for (i = 0; i < count; ++i, ++file) {
-            sq64 = rank * 8 + file;
-            sq120 = SQ120(sq64);
-            if (piece != EMPTY) 
-                pos->pieces[sq120] = piece;
-        }
-        fen++; //Move to side(next player's turn)
+/*
+    Name:    EmptyBoard
+    Vars:    S_BOARD *pos - A board that has been set up before.
+    Purpose: Take every piece off and forget the game, ready for SetupPiece. Unlike ResetBoard only what a position
+             needs is cleared: the squares of the pieces on the board are emptied, the repetition table is emptied by
+             taking back the keys of the old history, and the move ordering tables are left for SearchPosition, which
+             clears them itself.
+*/
+static void EmptyBoard(S_BOARD *pos) {
+    for (int i = 0; i < pos->hisPly; ++i)
+        pos->repTable[REPINDEX(pos->history[i].posKey)]--;
+
+    U64 occ = pos->occupied[BOTH];
+    while (occ)
+        pos->pieces[SQ120(POP(&occ))] = EMPTY;
+
+    for (int i = 0; i < 2; ++i)
+        pos->bigPce[i] = pos->majPce[i] = pos->minPce[i] = pos->material[i] = 0;
+    for (int i = 0; i < 3; ++i)
+        pos->pawns[i] = pos->occupied[i] = 0ULL;
+    for (int i = 0; i < 13; ++i) {
+        pos->pceNum[i] = 0;
+        pos->pceBB[i] = 0ULL;
     }
 
-    ASSERT(*fen == 'w' || *fen == 'b');
-    pos->side = (*fen == 'w')? WHITE : BLACK; //Who's turn is it?
-    fen += 2; //Move to castling permissions
-
-    //Check and update castling permissions
-    for (i = 0; i < 4; ++i) {   //At most, castling perms will be 4 characters, break early if less
-        if (*fen == ' ')
-            break;
-        
-        switch (*fen) {     //OR the relevant bits from castling permissions
-            case 'K': pos->castlePerm |= WKCA; break;
-            case 'Q': pos->castlePerm |= WQCA; break;
-            case 'k': pos->castlePerm |= BKCA; break;
-            case 'q': pos->castlePerm |= BQCA; break;
-            default: break;
-        }
-        fen++;
+    pos->KingSq[WHITE] = pos->KingSq[BLACK] = NO_SQ;
+    pos->side       = BOTH;
+    pos->enPas      = NO_SQ;
+    pos->castlePerm = 0;
+    pos->fiftyMove  = 0;
+    pos->ply        = 0;
+    pos->hisPly     = 0;
+    pos->moveNumber = 1;
+    pos->posKey     = 0ULL;
+    pos->attackMapValid = 0;
+    pos->checkInfoValid = FALSE;
+}
+
+
+/*
+    Name:    SetupPiece
+    Vars:    S_BOARD *pos    - A board being set up.
+             const int sq    - An empty square.
+             const int piece - The piece to put there.
+    Purpose: Place a piece and update the piece lists, counts, material, bitboards and key with it, so a position is
+             built in one pass over its pieces instead of a scan by UpdateListsMaterial and GeneratePosKey afterwards.
+    Returns: FALSE if the piece list of that piece is already full.
+*/
+int SetupPiece(S_BOARD *pos, const int sq, const int piece) {
+    if (pos->pceNum[piece] == 10)
+        return FALSE;
+
+    int colour = PieceCol[piece];
+    int sq64 = SQ64(sq);
+
+    pos->pieces[sq] = piece;
+    pos->pList[piece][pos->pceNum[piece]++] = sq;
+    if (PieceBig[piece]) pos->bigPce[colour]++;
+    if (PieceMin[piece]) pos->minPce[colour]++;
+    if (PieceMaj[piece]) pos->majPce[colour]++;
+    pos->material[colour] += PieceVal[piece];
+
+    SETBIT(pos->pceBB[piece], sq64);
+    SETBIT(pos->occupied[colour], sq64);
+    SETBIT(pos->occupied[BOTH], sq64);
+    if (piece == wP || piece == bP) {
+        SETBIT(pos->pawns[colour], sq64);
+        SETBIT(pos->pawns[BOTH], sq64);
     }
-    fen++; //Move to en passant square
+    if (piece == wK || piece == bK)
+        pos->KingSq[colour] = sq;
+
+    pos->posKey ^= PieceKeys[piece][sq];
+    return TRUE;
+}
 
-    //If the char is not a dash, there's an en passant square(Letter+Number representing square)
-    if (*fen != '-') {
-        file = fen[0] - 'a';    
-        rank = fen[1] - '1';
 
-        ASSERT(file >= FILE_A && file <= FILE_H); //Letter should be A to H
-        ASSERT(rank >= RANK_1 && rank <= RANK_8); //Number should be 1 to 8
+/*
+    Name:    SetupFen
+    Vars:    std::string_view fen - A FEN. Anything after the clocks, such as EPD opcodes or a result, is ignored, and so
+                                    are the clocks if they are missing.
+             S_BOARD *pos         - A board that has been set up before by ParseFen or ResetBoard.
+             size_t *errorAt      - Set to where in the FEN the error is, if there is one. May be NULL.
+    Purpose: Set up a position without printing anything, for loading positions in bulk. The pieces are listed and
+             keyed as they are read, and the FEN is checked as it goes instead of asserting: the board must be 8 ranks
+             of 8 squares with one king a side and no pawns on the back ranks, castling rights need their king and rook
+             at home, an en passant square needs the pawn that just moved past it, and the side that just moved can't
+             be left in check. The board is not usable after an error.
+    Returns: NULL if the position was set up, otherwise what is wrong with the FEN.
+*/
+const char *SetupFen(std::string_view fen, S_BOARD *pos, size_t *errorAt) {
+    size_t i = 0, n = fen.size();
+
+    EmptyBoard(pos);
+
+    while (i < n && IsFenSpace(fen[i]))
+        i++;
+
+    //Pieces. The ranks are found first and then read from the first rank up, so the piece lists come out in the
+    //same square order as UpdateListsMaterial makes them and the search visits moves in the same order.
+    size_t rankStart[8];
+    int ranks = 0;
+    rankStart[ranks++] = i;
+    for (; i < n && !IsFenSpace(fen[i]); ++i) {
+        if (fen[i] == '/') {
+            if (ranks == 8)
+                return FenFail(i, errorAt, "the board has more than 8 ranks");
+            rankStart[ranks++] = i + 1;
+        }
+    }
+    if (ranks != 8)
+        return FenFail(i, errorAt, "the board has fewer than 8 ranks");
+
+    for (int rank = RANK_1; rank <= RANK_8; ++rank) {
+        int file = FILE_A;
+        size_t at;
+        for (at = rankStart[RANK_8 - rank]; at < n && fen[at] != '/' && !IsFenSpace(fen[at]); ++at) {
+            char c = fen[at];
+            if (c >= '1' && c <= '8') {
+                file += c - '0';
+                if (file > 8)
+                    return FenFail(at, errorAt, "a rank has more than 8 squares");
+                continue;
+            }
+            int piece;
+            switch (c) {
+                case 'P': piece = wP; break;
+                case 'N': piece = wN; break;
+                case 'B': piece = wB; break;
+                case 'R': piece = wR; break;
+                case 'Q': piece = wQ; break;
+                case 'K': piece = wK; break;
+                case 'p': piece = bP; break;
+                case 'n': piece = bN; break;
+                case 'b': piece = bB; break;
+                case 'r': piece = bR; break;
+                case 'q': piece = bQ; break;
+                case 'k': piece = bK; break;
+                default: return FenFail(at, errorAt, "unknown piece letter");
+            }
+            if (file > FILE_H)
+                return FenFail(at, errorAt, "a rank has more than 8 squares");
+            if ((piece == wP || piece == bP) && (rank == RANK_1 || rank == RANK_8))
+                return FenFail(at, errorAt, "a pawn is on the first or last rank");
+            if (!SetupPiece(pos, FR2SQ(file, rank), piece))
+                return FenFail(at, errorAt, "more than 10 pieces of one kind");
+            file++;
+        }
+        if (file != 8)
+            return FenFail(at, errorAt, "a rank has fewer than 8 squares");
+    }
+    if (pos->pceNum[wK] != 1 || pos->pceNum[bK] != 1)
+        return FenFail(0, errorAt, "each side needs exactly one king");
+
+    //Side to move
+    while (i < n && IsFenSpace(fen[i]))
+        i++;
+    if (i >= n || (fen[i] != 'w' && fen[i] != 'b') || (i + 1 < n && !IsFenSpace(fen[i + 1])))
+        return FenFail(i, errorAt, "the side to move must be w or b");
+    pos->side = (fen[i] == 'w')? WHITE : BLACK;
+    i++;
+
+    //Castling rights
+    while (i < n && IsFenSpace(fen[i]))
+        i++;
+    if (i >= n)
+        return FenFail(i, errorAt, "castling rights are missing");
+    if (fen[i] == '-') {
+        i++;
+    } else {
+        for (; i < n && !IsFenSpace(fen[i]); ++i) {
+            int right;
+            switch (fen[i]) {
+                case 'K': right = WKCA; break;
+                case 'Q': right = WQCA; break;
+                case 'k': right = BKCA; break;
+                case 'q': right = BQCA; break;
+                default: return FenFail(i, errorAt, "castling rights must be - or letters from KQkq");
+            }
+            if (pos->castlePerm & right)
+                return FenFail(i, errorAt, "a castling right is given twice");
+            pos->castlePerm |= right;
+        }
+    }
+    if (((pos->castlePerm & (WKCA | WQCA)) && pos->pieces[E1] != wK) ||
+        ((pos->castlePerm & (BKCA | BQCA)) && pos->pieces[E8] != bK) ||
+        ((pos->castlePerm & WKCA) && pos->pieces[H1] != wR) || ((pos->castlePerm & WQCA) && pos->pieces[A1] != wR) ||
+        ((pos->castlePerm & BKCA) && pos->pieces[H8] != bR) || ((pos->castlePerm & BQCA) && pos->pieces[A8] != bR))
+        return FenFail(i, errorAt, "a castling right's king or rook is not on its square");
+
+    //En passant square
+    while (i < n && IsFenSpace(fen[i]))
+        i++;
+    if (i >= n)
+        return FenFail(i, errorAt, "the en passant square is missing");
+    if (fen[i] == '-') {
+        i++;
+    } else {
+        int epRank = (pos->side == WHITE)? RANK_6 : RANK_3;
+        if (i + 1 >= n || fen[i] < 'a' || fen[i] > 'h' || fen[i + 1] - '1' != epRank)
+            return FenFail(i, errorAt, "the en passant square must be - or a square on the 6th rank (white to move) or 3rd (black to move)");
+        pos->enPas = FR2SQ(fen[i] - 'a', epRank);
+        int pawnSq = pos->enPas + ((pos->side == WHITE)? -10 : 10);
+        if (pos->pieces[pawnSq] != ((pos->side == WHITE)? bP : wP))
+            return FenFail(i, errorAt, "no pawn has just moved past the en passant square");
+        i += 2;
+    }
 
-        pos->enPas = FR2SQ(file,rank);
+    //Halfmove clock and fullmove number, if there are any
+    while (i < n && IsFenSpace(fen[i]))
+        i++;
+    if (i < n && fen[i] >= '0' && fen[i] <= '9') {
+        int clock = 0;
+        for (; i < n && fen[i] >= '0' && fen[i] <= '9'; ++i)
+            clock = (clock < 10000)? clock * 10 + (fen[i] - '0') : clock;
+        pos->fiftyMove = clock;
+
+        while (i < n && IsFenSpace(fen[i]))
+            i++;
+        int number = 0;
+        for (; i < n && fen[i] >= '0' && fen[i] <= '9'; ++i)
+            number = (number < 100000)? number * 10 + (fen[i] - '0') : number;
+        if (number > 0)
+            pos->moveNumber = number;
     }
 
-    pos->posKey = GeneratePosKey(pos);
+    if (pos->side == WHITE) pos->posKey ^= SideKey;
+    if (pos->enPas != NO_SQ) pos->posKey ^= PieceKeys[EMPTY][pos->enPas];
+    pos->posKey ^= CastleKeys[pos->castlePerm];
+
+    if (SqAttacked(pos->KingSq[pos->side ^ 1], pos->side, pos))
+        return FenFail(0, errorAt, "the side not to move is in check");
+
+    ASSERT(CheckBoard(pos));
+    return NULL;
+}
+
 
-    UpdateListsMaterial(pos);
+/*
+    Name:    ParseFen
+    Vars:    std::string_view fen - A FEN.
+             S_BOARD *pos         - Pointer to a position.
+    Purpose: Update the board based on the position defined by the FEN. Generate a position key.
+             The whole board is reset first, so any board can be passed. Errors are printed.
+    Returns: 0 if everything worked correctly, -1 otherwise
+*/
+int ParseFen(std::string_view fen, S_BOARD *pos) {
+    ResetBoard(pos);
 
+    size_t at;
+    const char *error = SetupFen(fen, pos, &at);
+    if (error != NULL) {
+        cout << "FEN error at character " << at + 1 << ": " << error << "\n";
+        return -1;
+    }
     return 0;
 }
 
@@ -271,11 +455,28 @@ void ResetBoard(S_BOARD *pos) {
         pos->material[i] = 0;
     }
 
-    for (i = 0; i < 3; ++i)
+    for (i = 0; i < 3; ++i) {
         pos->pawns[i] = 0ULL;
+        pos->occupied[i] = 0ULL;
+    }
 
-    for (i = 0; i < 13; ++i)
+    for (i = 0; i < 13; ++i) {
         pos->pceNum[i] = 0;
+        pos->pceBB[i] = 0ULL;
+    }
+
+    for (i = 0; i < REPTABLE_SIZE; ++i)
+        pos->repTable[i] = 0;
+
+    for (i = 0; i < 13; ++i)                //Move ordering tables are read by the move generator, so start them empty
+        for (int i2 = 0; i2 < BRD_SQ_NUM; ++i2)
+            pos->searchHistory[i][i2] = 0;
+
+    for (i = 0; i < MAXDEPTH; ++i)
+        pos->searchKillers[0][i] = pos->searchKillers[1][i] = NOMOVE;
+
+    pos->attackMapValid = 0;
+    pos->checkInfoValid = FALSE;
 
     pos->KingSq[WHITE] = pos->KingSq[BLACK] = NO_SQ;
 
@@ -285,6 +486,7 @@ void ResetBoard(S_BOARD *pos) {
     pos->fiftyMove  = 0;
     pos->ply        = 0;
     pos->hisPly     = 0;
+    pos->moveNumber = 1;
     pos->posKey     = 0ULL;
 
     //pos->PvTable->pTable = NULL;
@@ -319,6 +521,11 @@ void UpdateListsMaterial(S_BOARD *pos) {
             pos->pList[piece][pos->pceNum[piece]] = sq;
             pos->pceNum[piece]++;
 
+            //Update the piece and occupancy bitboards
+            SETBIT(pos->pceBB[piece], SQ64(sq));
+            SETBIT(pos->occupied[colour], SQ64(sq));
+            SETBIT(pos->occupied[BOTH], SQ64(sq));
+
             //Update the KingSq array so the current position of the kings is known
             if (piece == wK || piece == bK) pos->KingSq[colour] = sq;
 
@@ -0,0 +1,287 @@
+//compare.cpp
+
+#include "defs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//The timings of one benchmark in a result file. Lower is better.
+typedef struct {
+    string name;
+    vector<double> samples; //One per repetition
+    long signature;         //Node count the run produced, 0 if it has none. Runs that did different work can't be compared.
+} S_BENCHSERIES;
+
+
+/*
+    Name:    FindSeries
+    Vars:    vector<S_BENCHSERIES> &series - The benchmarks read so far, in the order they appeared.
+             const string &name            - A benchmark name.
+    Returns: The benchmark with that name, added if it is new.
+*/
+static S_BENCHSERIES *FindSeries(vector<S_BENCHSERIES> &series, const string &name) {
+    for (S_BENCHSERIES &s : series)
+        if (s.name == name)
+            return &s;
+    series.push_back({name, {}, 0});
+    return &series.back();
+}
+
+
+/*
+    Name:    JsonString
+    Vars:    const string &obj - Text of one JSON object.
+             const char *key   - A key whose value is a string.
+    Returns: The value, or "" if the key isn't there.
+*/
+static string JsonString(const string &obj, const char *key) {
+    size_t at = obj.find("\"" + string(key) + "\"");
+    if (at == string::npos)
+        return "";
+    size_t open = obj.find('"', obj.find(':', at) + 1);
+    size_t close = obj.find('"', open + 1);
+    return (open == string::npos || close == string::npos)? "" : obj.substr(open + 1, close - open - 1);
+}
+
+
+/*
+    Name:    JsonNumber
+    Vars:    const string &obj - Text of one JSON object.
+             const char *key   - A key whose value is a number.
+             double *value     - Set to the value.
+    Returns: TRUE if the key was found.
+*/
+static int JsonNumber(const string &obj, const char *key, double *value) {
+    size_t at = obj.find("\"" + string(key) + "\"");
+    if (at == string::npos)
+        return FALSE;
+    return sscanf(obj.c_str() + obj.find(':', at) + 1, "%lf", value) == 1;
+}
+
+
+/*
+    Name:    ReadJsonResults
+    Vars:    const string &text            - The file.
+             vector<S_BENCHSERIES> &series - Filled with the benchmarks.
+    Purpose: Read the "benchmarks" array of a microbench -json file, which keeps every repetition under "samples".
+             Google Benchmark files are read too: each repetition is its own entry with a "real_time", and the aggregate
+             entries it adds (mean, median, stddev) are skipped since the samples give them.
+*/
+static void ReadJsonResults(const string &text, vector<S_BENCHSERIES> &series) {
+    size_t pos = text.find("\"benchmarks\"");
+    if (pos == string::npos)
+        return;
+
+    while ((pos = text.find('{', pos)) != string::npos) {
+        size_t end = text.find('}', pos);
+        if (end == string::npos)
+            break;
+        string obj = text.substr(pos, end - pos + 1);
+        pos = end + 1;
+
+        string name = JsonString(obj, "name");
+        if (name.empty() || JsonString(obj, "run_type") == "aggregate")
+            continue;
+        S_BENCHSERIES *s = FindSeries(series, name);
+
+        size_t samples = obj.find("\"samples\"");
+        double value;
+        if (samples != string::npos) {
+            const char *p = obj.c_str() + obj.find('[', samples) + 1;
+            int used;
+            while (sscanf(p, " %lf%n", &value, &used) == 1) {
+                s->samples.push_back(value);
+                p += used;
+                while (*p == ',' || *p == ' ')
+                    ++p;
+            }
+        } else if (JsonNumber(obj, "real_time", &value)) {
+            s->samples.push_back(value);
+        }
+    }
+}
+
+
+/*
+    Name:    ReadTextResults
+    Vars:    const string &text            - The file.
+             vector<S_BENCHSERIES> &series - Filled with the benchmarks.
+    Purpose: Read the output of perft (PerftTest, PerftSuite) and bench runs. A file holding the output of several runs
+             gives one sample per run. The node counts are kept as signatures.
+*/
+static void ReadTextResults(const string &text, vector<S_BENCHSERIES> &series) {
+    long benchNodes = 0;
+    size_t start = 0;
+
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == string::npos)
+            end = text.size();
+        string line = text.substr(start, end - start);
+        start = end + 1;
+
+        long nodes;
+        int positions, failed, ms;
+        S_BENCHSERIES *s = NULL;
+        if (sscanf(line.c_str(), "Test Complete : %ld leaf nodes visited in %dms", &nodes, &ms) == 2) {
+            s = FindSeries(series, "perft");
+        } else if (sscanf(line.c_str(), "Perft suite complete: %d positions, %d failed in %dms", &positions, &failed, &ms) == 3) {
+            s = FindSeries(series, "perft suite");
+            nodes = positions;
+        } else if (sscanf(line.c_str(), "Nodes searched : %ld", &nodes) == 1) {
+            benchNodes = nodes;
+        } else if (sscanf(line.c_str(), "Total time (ms) : %d", &ms) == 1) {
+            s = FindSeries(series, "bench");
+            nodes = benchNodes;
+        }
+
+        if (s != NULL) {
+            s->samples.push_back(ms);
+            if (s->signature == 0)
+                s->signature = nodes;
+            else if (s->signature != nodes)
+                s->signature = -1;  //The runs in this one file disagree
+        }
+    }
+}
+
+
+/*
+    Name:    ReadResults
+    Vars:    const char *file              - A result file.
+             vector<S_BENCHSERIES> &series - Filled with the benchmarks.
+    Purpose: Read a result file, JSON if it starts with '{' and perft or bench output otherwise.
+    Returns: TRUE if the file could be read.
+*/
+static int ReadResults(const char *file, vector<S_BENCHSERIES> &series) {
+    FILE *f = fopen(file, "rb");
+    if (f == NULL) {
+        printf("Could not open %s\n", file);
+        return FALSE;
+    }
+    string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        text.append(buf, n);
+    fclose(f);
+
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first != string::npos && text[first] == '{')
+        ReadJsonResults(text, series);
+    else
+        ReadTextResults(text, series);
+    return TRUE;
+}
+
+
+/*
+    Name:    TQuantile
+    Vars:    double df - Degrees of freedom.
+    Returns: The two sided 95% critical value of Student's t distribution.
+*/
+static double TQuantile(double df) {
+    static const double t[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    int d = (int)df;
+    if (d < 1)
+        d = 1;
+    return (d <= 30)? t[d - 1] : 1.96 + 2.4 / d;
+}
+
+
+static double Median(vector<double> v) {
+    sort(v.begin(), v.end());
+    size_t n = v.size();
+    return (n % 2)? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static void MeanVar(const vector<double> &v, double *mean, double *var) {
+    *mean = 0;
+    for (double x : v)
+        *mean += x;
+    *mean /= v.size();
+    *var = 0;
+    for (double x : v)
+        *var += (x - *mean) * (x - *mean);
+    *var = (v.size() > 1)? *var / (v.size() - 1) : 0;
+}
+
+
+/*
+    Name:    CompareBenchmarks
+    Vars:    const char *baseFile - Results of the reference build.
+             const char *newFile  - Results of the build being checked.
+             double threshold     - Percent a benchmark must slow down by before it counts as a regression.
+    Purpose: Compare every benchmark found in both files. The change is the difference of the medians. When both sides
+             have repetitions, a 95% confidence interval of the change in the mean is found with Welch's t test, and a
+             benchmark is only called slower (or faster) when the whole interval is on that side of zero as well as the
+             median moving by more than the threshold, so run to run noise isn't reported as a regression.
+             Single runs can only be judged on the threshold.
+    Returns: The number of benchmarks that got significantly slower, or -1 if a file couldn't be read.
+*/
+int CompareBenchmarks(const char *baseFile, const char *newFile, double threshold) {
+    vector<S_BENCHSERIES> base, test;
+    if (!ReadResults(baseFile, base) || !ReadResults(newFile, test))
+        return -1;
+
+    int slower = 0, faster = 0, compared = 0;
+    printf("%-20s %5s %12s %12s %9s %20s  %s\n", "Benchmark", "Runs", "Base", "New", "Change", "95% interval", "Verdict");
+
+    for (const S_BENCHSERIES &b : base) {
+        const S_BENCHSERIES *t = NULL;
+        for (const S_BENCHSERIES &s : test)
+            if (s.name == b.name)
+                t = &s;
+        if (t == NULL || b.samples.empty() || t->samples.empty()) {
+            printf("%-20s only in %s\n", b.name.c_str(), baseFile);
+            continue;
+        }
+        if (b.signature != t->signature) {
+            printf("%-20s node counts differ (%ld vs %ld), the runs did different work\n", b.name.c_str(), b.signature, t->signature);
+            continue;
+        }
+
+        double baseMed = Median(b.samples), newMed = Median(t->samples);
+        double change = 100.0 * (newMed - baseMed) / baseMed;
+        int nb = (int)b.samples.size(), nt = (int)t->samples.size();
+        char interval[32] = "-";
+        int sure = TRUE;   //Without repetitions there is no interval to check
+
+        if (nb > 1 && nt > 1) {
+            double mb, vb, mt, vt;
+            MeanVar(b.samples, &mb, &vb);
+            MeanVar(t->samples, &mt, &vt);
+            double se2 = vb / nb + vt / nt;
+            double df = (se2 > 0)? se2 * se2 / ((vb / nb) * (vb / nb) / (nb - 1) + (vt / nt) * (vt / nt) / (nt - 1)) : 1e9;
+            double half = TQuantile(df) * sqrt(se2);
+            double lo = 100.0 * (mt - mb - half) / mb, hi = 100.0 * (mt - mb + half) / mb;
+            snprintf(interval, sizeof(interval), "[%+.1f%%, %+.1f%%]", lo, hi);
+            sure = (change > 0)? lo > 0 : hi < 0;
+        }
+
+        const char *verdict = "same";
+        if (sure && change > threshold) {
+            verdict = "SLOWER";
+            slower++;
+        } else if (sure && change < -threshold) {
+            verdict = "faster";
+            faster++;
+        }
+        compared++;
+        printf("%-20s %2d/%-2d %12.2f %12.2f %+8.2f%% %20s  %s\n", b.name.c_str(), nb, nt, baseMed, newMed, change, interval, verdict);
+    }
+    for (const S_BENCHSERIES &t : test)
+        if (find_if(base.begin(), base.end(), [&t](const S_BENCHSERIES &b) { return b.name == t.name; }) == base.end())
+            printf("%-20s only in %s\n", t.name.c_str(), newFile);
+
+    printf("\n%d compared, %d slower, %d faster (threshold %.1f%%)\n", compared, slower, faster, threshold);
+    return slower;
+}
@@ -0,0 +1,325 @@
+//datagen.cpp
+
+#include "defs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+extern char START_FEN[];
+
+#define DATAGEN_BLOCK    4096   //Records a worker hands to the writer at once
+#define DATAGEN_RING     16     //Blocks a worker can have waiting for the writer before it has to wait itself
+#define DATAGEN_MAXPLIES 400    //Games still going after this many plies are drawn
+
+//Full blocks passed from one worker to the writer. Only the worker moves tail and only the writer moves head, so
+//neither side ever takes a lock; they are on their own cache lines so the two threads don't fight over one line.
+typedef struct {
+    vector<S_PACKEDPOS> *slots[DATAGEN_RING];
+    alignas(64) atomic<unsigned> head;  //The next block the writer takes
+    alignas(64) atomic<unsigned> tail;  //The next slot the worker fills
+    atomic<int> finished;               //Set once the worker has handed over its last block
+} S_DATAQUEUE;
+
+//Everything the workers and the writer share
+typedef struct {
+    S_SEARCHINFO limits;    //Every move is searched with these
+    long target;            //Positions wanted
+    int randomPlies;        //Random moves played from the start position before the searches take over
+    U64 seed;
+    int resignScore;        //A game is adjudicated once the score stays this big for resignPlies plies in a row
+    int resignPlies;
+
+    atomic<long> recorded;  //Positions produced by all the workers
+    atomic<long> games;
+    atomic<long> results[3];//Black wins, draws and white wins
+    atomic<int> stop;
+    vector<S_DATAQUEUE> *queues;    //One per worker
+} S_DATAGEN;
+
+
+/*
+    Name:    DataRand
+    Vars:    U64 *s - The worker's generator state.
+    Purpose: xorshift64* generator. Each worker has its own so the threads don't share a state.
+    Returns: A pseudo random 64 bit number.
+*/
+static U64 DataRand(U64 *s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 0x2545F4914F6CDD1DULL;
+}
+
+
+/*
+    Name:    RandomOpening
+    Vars:    S_DATAGEN *gen - The generator.
+             S_BOARD *pos   - Set to the start position with the random moves played.
+             U64 *rng       - The worker's generator state.
+    Purpose: Start a game from a random position a few plies in, so the games don't all repeat the same lines.
+             Openings that end the game are thrown away and another one is tried.
+*/
+static void RandomOpening(S_DATAGEN *gen, S_BOARD *pos, U64 *rng) {
+    S_MOVELIST list[1];
+    int legal[MAXPOSITIONMOVES];
+
+    while (TRUE) {
+        ParseFen(START_FEN, pos);
+        int ply;
+        for (ply = 0; ply < gen->randomPlies; ++ply) {
+            GenerateAllMoves(pos, list);
+            int count = 0;
+            for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+                if (MakeMove(pos, list->moves[moveNum].move)) {
+                    TakeMove(pos);
+                    legal[count++] = list->moves[moveNum].move;
+                }
+            }
+            if (count == 0)
+                break;
+            MakeMove(pos, legal[DataRand(rng) % count]);
+        }
+
+        const char *reason;
+        if (ply == gen->randomPlies && GameOver(pos, &reason) == 2)
+            return;
+    }
+}
+
+
+/*
+    Name:    PlayDataGame
+    Vars:    S_DATAGEN *gen               - The generator.
+             S_BOARD *pos                 - The worker's board.
+             U64 *rng                     - The worker's generator state.
+             vector<S_PACKEDPOS> &records - Filled with the game's positions.
+    Purpose: Play a game against itself and keep the quiet positions: those not in check whose best move is not a
+             capture or promotion and whose score is not a mate or tablebase win. Each is stored with its score and best
+             move, and the game's result once it is known.
+*/
+static void PlayDataGame(S_DATAGEN *gen, S_BOARD *pos, U64 *rng, vector<S_PACKEDPOS> &records) {
+    records.clear();
+    RandomOpening(gen, pos, rng);
+
+    S_SEARCHINFO info = gen->limits;
+    info.keepHash = FALSE;  //Clears the pv table of the last game on the first search
+
+    int result = 0, plies = 0, winning = 0;
+    const char *reason;
+    while ((result = GameOver(pos, &reason)) == 2) {
+        if (plies >= DATAGEN_MAXPLIES) {
+            result = 0;
+            break;
+        }
+
+        SearchPosition(pos, &info);
+        info.keepHash = TRUE;
+
+        int move = info.bestMove;
+        if (move == NOMOVE || !MakeMove(pos, move)) {  //Can't happen with a legal move available, but don't loop on it
+            result = (pos->side == WHITE)? -1 : 1;
+            break;
+        }
+        TakeMove(pos);
+
+        int score = (pos->side == WHITE)? info.bestScore : -info.bestScore;
+        if (abs(score) >= gen->resignScore && (winning == 0 || (winning > 0) == (score > 0)))
+            winning += (score > 0)? 1 : -1;
+        else
+            winning = 0;
+        if (abs(winning) >= gen->resignPlies) {
+            result = (winning > 0)? 1 : -1;
+            break;
+        }
+
+        S_PACKEDPOS pp;
+        if (!InCheck(pos) && !CAPTURED(move) && !PROMOTED(move) && abs(score) < TBWIN - MAXDEPTH && PackPosition(pos, &pp)) {
+            pp.score = (short)score;
+            pp.move = PackMove(move);
+            records.push_back(pp);
+        }
+
+        MakeMove(pos, move);
+        plies++;
+    }
+
+    for (S_PACKEDPOS &pp : records)
+        pp.result = (signed char)(result + 1);
+    gen->results[result + 1]++;
+}
+
+
+/*
+    Name:    HandOff
+    Vars:    S_DATAQUEUE *q             - The worker's queue.
+             vector<S_PACKEDPOS> *block - A full block. The writer frees it.
+    Purpose: Pass a block to the writer, waiting only if the writer has fallen a whole ring behind.
+*/
+static void HandOff(S_DATAQUEUE *q, vector<S_PACKEDPOS> *block) {
+    unsigned tail = q->tail.load(memory_order_relaxed);
+    while (tail - q->head.load(memory_order_acquire) == DATAGEN_RING)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    q->slots[tail % DATAGEN_RING] = block;
+    q->tail.store(tail + 1, memory_order_release);
+}
+
+
+/*
+    Name:    DataGenWorker
+    Vars:    S_DATAGEN *gen - The generator.
+             int id         - Which worker. Picks its queue and seeds its generator.
+    Purpose: Play games until enough positions are recorded. Positions collect in a block of the worker's own and the
+             block goes to the writer when it is full, so the workers never wait on each other or on the disk.
+*/
+static void DataGenWorker(S_DATAGEN *gen, int id) {
+    S_BOARD *board = new S_BOARD;
+    board->PvTable->pTable = NULL;
+    InitPvTable(board->PvTable);
+
+    U64 rng = gen->seed ^ (0x9E3779B97F4A7C15ULL * (id + 1));
+    S_DATAQUEUE *q = &(*gen->queues)[id];
+    vector<S_PACKEDPOS> *block = new vector<S_PACKEDPOS>;
+    block->reserve(DATAGEN_BLOCK);
+    vector<S_PACKEDPOS> records;
+
+    while (!gen->stop) {
+        PlayDataGame(gen, board, &rng, records);
+        gen->games++;
+        for (const S_PACKEDPOS &pp : records) {
+            block->push_back(pp);
+            if (block->size() == DATAGEN_BLOCK) {
+                HandOff(q, block);
+                block = new vector<S_PACKEDPOS>;
+                block->reserve(DATAGEN_BLOCK);
+            }
+        }
+        if ((gen->recorded += (long)records.size()) >= gen->target)
+            gen->stop = TRUE;
+    }
+
+    if (block->empty())
+        delete block;
+    else
+        HandOff(q, block);
+    q->finished = TRUE;
+
+    free(board->PvTable->pTable);
+    delete board;
+    ProfileMerge();
+}
+
+
+/*
+    Name:    DataGenWriter
+    Vars:    S_DATAGEN *gen - The generator.
+             FILE *out      - The packed file.
+    Purpose: The only thread that touches the file. Takes the full blocks of every worker, writes them until the
+             target is reached, and reports progress.
+    Returns: The number of positions written.
+*/
+static long DataGenWriter(S_DATAGEN *gen, FILE *out) {
+    long written = 0;
+    int start = GetTimeMs(), lastReport = start;
+
+    while (TRUE) {
+        int idle = TRUE, done = TRUE;
+        for (S_DATAQUEUE &q : *gen->queues) {
+            int finished = q.finished;  //Read before tail, so a finished worker's last block is already visible
+            unsigned head = q.head.load(memory_order_relaxed);
+            unsigned tail = q.tail.load(memory_order_acquire);
+            for (; head != tail; ++head) {
+                vector<S_PACKEDPOS> *block = q.slots[head % DATAGEN_RING];
+                long n = min((long)block->size(), gen->target - written);
+                fwrite(block->data(), sizeof(S_PACKEDPOS), n, out);
+                written += n;
+                delete block;
+                q.head.store(head + 1, memory_order_release);
+                idle = FALSE;
+            }
+            if (!finished)
+                done = FALSE;
+        }
+        if (done && idle)
+            break;
+        if (idle)
+            this_thread::sleep_for(chrono::milliseconds(1));
+
+        int now = GetTimeMs();
+        if (now - lastReport >= 10000) {
+            lastReport = now;
+            printf("%ld positions from %ld games, %ld written, %.0f positions/s\n",
+                   gen->recorded.load(), gen->games.load(), written, gen->recorded * 1000.0 / (now - start));
+            fflush(stdout);
+        }
+    }
+    return written;
+}
+
+
+/*
+    Name:    GenerateData
+    Vars:    const char *outFile  - The packed file to write.
+             S_SEARCHINFO *limits - The search limits of every move, normally a small node count.
+             long positions       - How many positions to write.
+             int threads          - Games played at once. The writer has a thread of its own.
+             int randomPlies      - Random moves that start each game.
+             U64 seed             - Seed of the random openings. The same seed gives the same openings.
+    Purpose: Generate training data by self-play, for tuning or training an evaluation. Every record holds the
+             position, the search score and best move, and the game's result. Games are adjudicated once the score
+             stays above 1000 for 8 plies in a row.
+    Returns: The number of positions written, or -1 if the file couldn't be created.
+*/
+long GenerateData(const char *outFile, S_SEARCHINFO *limits, long positions, int threads, int randomPlies, U64 seed) {
+    FILE *out = CreatePackedFile(outFile);
+    if (out == NULL)
+        return -1;
+
+    if (threads < 1)
+        threads = 1;
+    vector<S_DATAQUEUE> queues(threads);
+    for (S_DATAQUEUE &q : queues) {
+        q.head = q.tail = 0;
+        q.finished = FALSE;
+    }
+
+    S_DATAGEN gen;
+    gen.limits = *limits;
+    gen.limits.quiet = TRUE;
+    gen.limits.multiPV = 1;
+    gen.target = positions;
+    gen.randomPlies = randomPlies;
+    gen.seed = (seed != 0)? seed : 1;
+    gen.resignScore = 1000;
+    gen.resignPlies = 8;
+    gen.recorded = 0;
+    gen.games = 0;
+    for (int i = 0; i < 3; ++i)
+        gen.results[i] = 0;
+    gen.stop = FALSE;
+    gen.queues = &queues;
+
+    printf("Generating %ld positions on %d threads, %d random plies, seed %llu\n", positions, threads, randomPlies, seed);
+    int start = GetTimeMs();
+    vector<thread> workers;
+    for (int i = 0; i < threads; ++i)
+        workers.emplace_back(DataGenWorker, &gen, i);
+    long written = DataGenWriter(&gen, out);
+    for (thread &t : workers)
+        t.join();
+    fclose(out);
+
+    int ms = GetTimeMs() - start;
+    printf("Wrote %ld positions from %ld games (white %ld, draw %ld, black %ld) to %s in %dms, %.0f positions/s\n",
+           written, gen.games.load(), gen.results[2].load(), gen.results[1].load(), gen.results[0].load(), outFile, ms,
+           written * 1000.0 / ((ms > 0)? ms : 1));
+    ProfileReport("datagen");
+    return written;
+}
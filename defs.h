@@ -3,7 +3,21 @@
 #ifndef DEFS_H
 #define DEFS_H
 
+#include <array>
+#include <cstdio>
+#include <string_view>
+
+#ifdef INSTRUMENT_CYCLES
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#ifndef NDEBUG   //Optimized builds such as the microbenchmarks define NDEBUG to drop the checks
 #define DEBUG
+#endif
 #ifndef DEBUG
 #define ASSERT(n)
 #else
@@ -22,6 +36,14 @@ exit(1); }
 #define PLAY_SQ_NUM 64          //Defines playable board size
 #define MAXGAMEMOVES 2048       //Used for storing previous piece positions. It's rare for a game to go over 150 moves so this should be more than enough.
 #define MAXPOSITIONMOVES 256    //The max number of moves calculated for any given position. The current known max is 218 so 256 is more than enough and easy to represent in binary.
+#define MAXFENLEN 100           //Room for the longest FEN BoardToFen writes and its '\0'
+#define REPTABLE_SIZE 4096      //Buckets in the repetition table. Must be a power of 2.
+#define MAXDEPTH 64             //The deepest the search can go in plies
+#define MAXMULTIPV 16           //The most root lines a MultiPV search reports
+
+#define INFINITE 30000          //Larger than any score the search can return
+#define ISMATE (INFINITE - MAXDEPTH) //Scores above this are mates. A mate in n plies scores INFINITE - n.
+#define TBWIN (ISMATE - MAXDEPTH)    //A tablebase win n plies from the root scores TBWIN - n, below every mate
 
 //FENs describe the position in a simple text notation that is easy to parse.
 //The 8 rows are given with black as lowercase and white as upper. 
@@ -43,6 +65,8 @@ enum {RANK_1, RANK_2, RANK_3, RANK_4, RANK_5,
 enum {WHITE, BLACK, BOTH};                    //Defining players
 enum {FALSE, TRUE};                           //Explicitly declaring 0 to be FALSE and 1 to be TRUE
 enum {WKCA=1, WQCA=2, BKCA=4, BQCA=8};        //Castling, K is short castle, Q is long. Ex. 1001 shows that white can castle King side and black Queen side
+enum {DIR_N, DIR_NE, DIR_E, DIR_SE,           //Ray directions on the 64 square bitboard. N is towards rank 8, E is towards file H
+      DIR_S, DIR_SW, DIR_W, DIR_NW};
 enum {                                        //Defines playable board tiles. Values 0-20 and 92-119 are out of bounds values
     A1 = 21, B1, C1, D1, E1, F1, G1, H1,
     A2 = 31, B2, C2, D2, E2, F2, G2, H2,
@@ -84,6 +108,75 @@ typedef struct {
     int numEntries;
 } S_PVTABLE;
 
+//One root line of a search: its score and principal variation
+typedef struct {
+    int score;
+    int count;              //Moves in the line
+    int moves[MAXDEPTH];
+} S_PVLINE;
+
+//The result of one completed iteration of iterative deepening
+typedef struct {
+    int move;       //Best move
+    int score;
+    int time;       //ms since the search started
+    long nodes;     //Nodes searched so far
+} S_ITERATION;
+
+//Tracks the limits and results of a search
+typedef struct {
+    int starttime;  //When the search started in ms
+    int stoptime;   //When the search must stop in ms, if timeset
+    int depth;      //The deepest iteration to search
+    int timeset;    //TRUE if the search is limited by stoptime
+    int stopped;    //Set to TRUE once time runs out. The search unwinds without trusting its scores.
+    int quiet;      //TRUE to suppress the per-iteration output
+    int moveTime;   //Milliseconds the search may take. Sets stoptime when the search starts. 0 for no limit.
+    long nodeLimit; //Stop once this many nodes are searched. 0 for no limit.
+    int keepHash;   //TRUE to keep the pv table from the previous search, ex. between consecutive positions of a game
+    int useBook;    //TRUE to play from the open Polyglot book, if the position is in it, instead of searching
+    int tbProbeDepth;   //Remaining depth a node needs before search probes the tablebases
+    int tbProbeLimit;   //Most pieces (kings included) a position can have to be probed. The loaded tables cap it too.
+
+    long nodes;     //Nodes visited, including quiescence
+    int  bestMove;  //The best move of the last completed iteration
+    int  bestScore; //Its score
+
+    //MultiPV. Each iteration searches the root multiPV times, excluding the moves of the lines already found.
+    int multiPV;                //Lines wanted. 1 for a normal search.
+    int pvCount;                //Lines found by the last completed iteration, best first
+    S_PVLINE lines[MAXMULTIPV];
+    int excluded[MAXMULTIPV];   //Root moves the current root search skips
+    int numExcluded;
+
+    int iterations;             //Completed iterations of the last search
+    S_ITERATION iter[MAXDEPTH]; //Best move of each, used to see when the search settled on a move
+
+    //Selectivity switches. All are on by default.
+    int useNullMove;
+    int useLMR;
+    int useFutility;
+    int useRFP;
+    int useCheckExt;
+    int usePVS;         //Zero window scouts for every move after the first
+    int useAspiration;  //Narrow root window around the previous iteration's score
+
+    //Search statistics, reset at the start of every search
+    long fh;            //Beta cutoffs
+    long fhf;           //Beta cutoffs on the first move searched. fhf/fh measures move ordering.
+    long nullTries;     //Null move searches
+    long nullCutoffs;   //Null move searches that failed high
+    long lmrReduced;    //Moves searched at reduced depth
+    long lmrResearched; //Reduced moves that beat alpha and were searched again at full depth
+    long futilityPruned;//Quiet moves skipped by futility pruning
+    long rfpPruned;     //Nodes cut by reverse futility pruning
+    long checkExtended; //Nodes extended because the side to move was in check
+    long pvsResearched; //Zero window scouts that landed inside the window and were searched again with the full window
+    long aspFailLow;    //Root searches that failed low or high on the aspiration window and were widened
+    long aspFailHigh;
+    long tbHits;        //Tablebase probes that found the position
+} S_SEARCHINFO;
+
 //S_UNDO defines the structure for undoing moves
 typedef struct {
     int move;       //The most recent move to undo
@@ -91,18 +184,24 @@ typedef struct {
     int enPas;      //En passant square before the move the undo
     int fiftyMove;  //50 move rule status before the move to undo
     U64 posKey;     //The position key the move was played at
+    U64 checkers;   //Check and pin info of the position the move was played from, restored by TakeMove
+    U64 pinned;
+    U64 discoverers;
 } S_UNDO;
 
 //S_BOARD defines the structure for the playing board
 typedef struct {
     int pieces[BRD_SQ_NUM];
     U64 pawns[3];   //3 arrays of pawns for white, black, and both. 64 bit int represents the board (1 means a pawn is on that square)
+    U64 pceBB[13];  //A bitboard for each piece type
+    U64 occupied[3];//Every piece of white, black, and both
     int KingSq[2];  //Holds black and white king locations
     int side;       //Keeps track of whose turn it is
     int enPas;      //Keeps track of possible en passant square if there is one (otherwise it's set to NO_SQ)
     int fiftyMove;  //Watches for the 50 move rule (if 50 turns are completed without capture, the game is drawn)
     int ply;        //How many half moves have been made into current search (1 side moving a piece == 1 ply)
     int hisPly;     //History of how many moves have been made in total. Important for checking repitition.
+    int moveNumber; //The fullmove number of the position the board was set up from, for writing FENs
     int castlePerm; //Castling permissions
     U64 posKey;     //Unix key generated for each position
     int pceNum[13]; //Number of pieces still on the board. Ex. Num of white knights would be value of pceNum at pos 2 as defined by earlier enum
@@ -111,11 +210,55 @@ typedef struct {
     int minPce[2];  //Bishops and knights
     int material[2];
     S_UNDO history[MAXGAMEMOVES]; //Stores move history for the purpose of undoing moves
+    unsigned short repTable[REPTABLE_SIZE]; //How many keys in history fall into each bucket. A 0 bucket means the position has not been seen.
     int pList[13][10];  //piece list: 13 piece types with a max of 10 each in extreme cases
 
     S_PVTABLE PvTable[1];
+    int PvArray[MAXDEPTH];  //The principal variation found by the search
+
+    int searchHistory[13][BRD_SQ_NUM]; //Quiet moves that caused beta cutoffs, by piece and square. Used for move ordering.
+    int searchKillers[2][MAXDEPTH];    //The last two quiet moves that caused a beta cutoff at each ply
+
+    //Caches computed on demand from const positions. Cleared whenever the pieces change.
+    mutable U64 attackMap[2];   //Every square attacked by white and black
+    mutable int attackMapValid; //Bit (1 << side) is set when attackMap[side] is up to date
+    mutable U64 checkers;       //Enemy pieces giving check to the side to move
+    mutable U64 pinned;         //Pieces of the side to move that are pinned to their own king
+    mutable U64 discoverers;    //Pieces of the side to move that would give a discovered check by moving off the line
+    mutable int checkInfoValid; //TRUE when checkers, pinned and discoverers are up to date
 } S_BOARD;
 
+//Hot functions counted by the instrumentation build, see profile.cpp
+enum {PROF_GENMOVES, PROF_GENCAPS, PROF_MAKEMOVE, PROF_TAKEMOVE, PROF_SQATTACKED, PROF_CHECKBOARD, PROF_EVAL, PROF_NUM};
+
+//One thread's counters. Aligned to a cache line so no two threads ever write to the same line.
+typedef struct alignas(64) {
+    U64 calls[PROF_NUM];
+    U64 cycles[PROF_NUM];   //Only counted with INSTRUMENT_CYCLES. Inclusive of the calls a function makes itself.
+} S_PROFILE;
+
+//A position packed into 32 bytes for large data sets, see packed.cpp
+typedef struct {
+    U64 occupied;               //Every piece of both sides
+    unsigned char pieces[16];   //The piece on each set bit of occupied, from a1 up, as nibbles: low nibble first
+    unsigned char flags;        //Bit 0 the side to move, bits 1 to 4 the castling permissions
+    unsigned char enPas;        //En passant square on the 64 square board, 64 if there is none
+    unsigned char fiftyMove;
+    signed char result;         //For white, in half points: 0 loss, 1 draw, 2 win, -1 unknown
+    short score;                //Search score from white's point of view, 0 if none was recorded
+    unsigned short move;        //Best move: from | to << 6 | promoted piece kind (1 knight to 4 queen) << 12. 0 if none.
+} S_PACKEDPOS;
+
+//A memory mapped packed file, read in place
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    const S_PACKEDPOS *records;
+    long count;
+    long next;                  //The record ReadPacked decodes next
+    void *file, *mapping;       //Windows handles
+} S_PACKEDFILE;
+
 
 
             /*  GAME MOVES  */
@@ -150,6 +293,8 @@ typedef struct {
 #define SQ120(sq64) (Sq64ToSq120[(sq64)])
 #define SQ64(sq120) (Sq120ToSq64[(sq120)])
 
+#define REPINDEX(key) ((key) & (REPTABLE_SIZE - 1)) //Bucket of the repetition table a key falls into
+
 #define CNT(b) CountBits(b)
 #define POP(b) PopBit(b)
 
@@ -161,18 +306,27 @@ typedef struct {
 #define IsKn(p) (PieceKnight[(p)])
 #define IsRQ(p) (PieceRookQueen[(p)])
 
+//PROFILE(n) at the top of a function counts its calls under PROF_ n. Build with 'make INSTRUMENT=1' to compile the
+//counters in, or 'make INSTRUMENT=cycles' to also time every call with the CPU's cycle counter. Otherwise it is empty.
+#ifdef INSTRUMENT
+#define PROFILE(n) S_PROFILESCOPE profileScope(n)
+#else
+#define PROFILE(n)
+#endif
+
 
             /*  GLOBALS  */
 
-extern int Sq120ToSq64[BRD_SQ_NUM]; //Convert 120 board to 64
-extern int Sq64ToSq120[64];         //Convert 64 board to 120
+//Lookup tables and hash keys are generated at compile time in init.cpp
+extern const std::array<int, BRD_SQ_NUM> Sq120ToSq64;   //Convert 120 board to 64
+extern const std::array<int, PLAY_SQ_NUM> Sq64ToSq120;  //Convert 64 board to 120
 
-extern U64 ClearMask[64];           //Used for clearing bits on the bitboard
-extern U64 SetMask[64];             //Used for setting bits on the bitboard
+extern const std::array<U64, PLAY_SQ_NUM> ClearMask;    //Used for clearing bits on the bitboard
+extern const std::array<U64, PLAY_SQ_NUM> SetMask;      //Used for setting bits on the bitboard
 
-extern U64 CastleKeys[16];
-extern U64 PieceKeys[13][120];
-extern U64 SideKey;
+extern const std::array<U64, 16> CastleKeys;
+extern const std::array<std::array<U64, BRD_SQ_NUM>, 13> PieceKeys;
+extern const U64 SideKey;
 
 extern char FileChar[];             //Indexed by corresponding integer to print piece, side, rank, and file
 extern char PceChar[];
@@ -186,8 +340,20 @@ extern int PieceMin[13];
 extern int PiecePawn[13];
 extern int PieceVal[13];
 
-extern int FilesBrd[BRD_SQ_NUM];    //Given a piece, what file and rank is it on?
-extern int RanksBrd[BRD_SQ_NUM];
+extern const std::array<int, BRD_SQ_NUM> FilesBrd;  //Given a piece, what file and rank is it on?
+extern const std::array<int, BRD_SQ_NUM> RanksBrd;
+
+extern const std::array<U64, PLAY_SQ_NUM> KnightAttacks;                //Squares attacked from a square, indexed by 64 based square
+extern const std::array<U64, PLAY_SQ_NUM> KingAttacks;
+extern const std::array<std::array<U64, PLAY_SQ_NUM>, 2> PawnAttacks;   //Indexed by the colour of the pawn
+extern const std::array<std::array<U64, PLAY_SQ_NUM>, 8> Rays;          //Indexed by the DIR_ enum
+extern const std::array<std::array<U64, PLAY_SQ_NUM>, PLAY_SQ_NUM> Between; //Squares strictly between two aligned squares
+extern const std::array<std::array<U64, PLAY_SQ_NUM>, PLAY_SQ_NUM> Line;    //The whole line through two aligned squares
+
+extern const std::array<U64, 8> FileBBMask;                              //Every square on a file
+extern const std::array<U64, PLAY_SQ_NUM> IsolatedMask;                  //The files either side of a square
+extern const std::array<std::array<U64, PLAY_SQ_NUM>, 2> PassedMask;     //Squares that must be free of enemy pawns for a pawn of a colour to be passed
+extern const std::array<int, PLAY_SQ_NUM> Mirror64;                      //Flips a square to the other side of the board
 
 extern int PieceBishopQueen[13];    //These arrays answer the question, is the piece a knight, king, rook/queen, or a bishop/queen
 extern int PieceKing[13];           //They are used by attack.cpp
@@ -195,12 +361,42 @@ extern int PieceKnight[13];
 extern int PieceRookQueen[13];
 extern int PieceSlides[13];
 
+#ifdef INSTRUMENT
+extern thread_local S_PROFILE Profile;  //The counters of the running thread
+
+//Counts a call when created and, with INSTRUMENT_CYCLES, adds the cycles that pass until it goes out of scope
+struct S_PROFILESCOPE {
+    int id;
+#ifdef INSTRUMENT_CYCLES
+    U64 start;
+    S_PROFILESCOPE(int n) : id(n), start(__rdtsc()) { Profile.calls[n]++; }
+    ~S_PROFILESCOPE() { Profile.cycles[id] += __rdtsc() - start; }
+#else
+    S_PROFILESCOPE(int n) : id(n) { Profile.calls[n]++; }
+#endif
+};
+#endif
+
 
             /*  FUNCTIONS  */
 
+//analyze.cpp
+extern int AnalyzePgn(const char *path, S_SEARCHINFO *limits, int threads, int blunderMargin);
+
 //attack.cpp
+extern U64 AttackersTo(const int sq, const U64 occ, const S_BOARD *pos);
+extern U64 AttackMap(const S_BOARD *pos, const int side);
+extern U64 BishopAttacks(const int sq64, const U64 occ);
+extern U64 Checkers(const S_BOARD *pos);
+extern U64 DiscoveredCheckCandidates(const S_BOARD *pos);
+extern int InCheck(const S_BOARD *pos);
+extern U64 PinnedPieces(const S_BOARD *pos);
+extern U64 RookAttacks(const int sq64, const U64 occ);
 extern int SqAttacked(const int sq, const int side, const S_BOARD *pos);
 
+//bench.cpp
+extern long Bench(int depth);
+
 //bitboards.cpp
 extern int  CountBits(U64 b);
 extern int  PopBit(U64 *bb);
@@ -208,41 +404,132 @@ extern void PrintBitBoard(U64 bb);
 
 //board.cpp
 extern int  CheckBoard(const S_BOARD *pos);
-extern int  ParseFen(char *fen, S_BOARD *pos);
+extern int  ParseFen(std::string_view fen, S_BOARD *pos);
 extern void PrintBoard(const S_BOARD *pos);
 extern void ResetBoard(S_BOARD *pos);
+extern const char *SetupFen(std::string_view fen, S_BOARD *pos, size_t *errorAt);
+extern int  SetupPiece(S_BOARD *pos, const int sq, const int piece);
 extern void UpdateListsMaterial(S_BOARD *pos);
 
+//compare.cpp
+extern int CompareBenchmarks(const char *baseFile, const char *newFile, double threshold);
+
+//datagen.cpp
+extern long GenerateData(const char *outFile, S_SEARCHINFO *limits, long positions, int threads, int randomPlies, U64 seed);
+
+//endgame.cpp
+extern int  EvaluateEndgame(const S_BOARD *pos, int *score);
+extern void InitEndgames();
+extern int  ProbeKPK(int strong, int stm, int sk, int wk, int sp);
+
+//epd.cpp
+extern int EpdSuite(const char *file, S_SEARCHINFO *limits, int threads);
+
+//evaluate.cpp
+extern int EvalPosition(const S_BOARD *pos);
+
 //hashkeys.cpp
-extern U64 GeneratePosKey(const S_BOARD *pos);
+extern U64  GeneratePosKey(const S_BOARD *pos);
+extern void HashStats(int depth, const char *file);
+extern int  VerifyPosKey(const S_BOARD *pos);
+
+extern int  HashVerifyInterval;
+extern long HashVerifyChecks;
+extern long HashVerifyErrors;
 
 //init.cpp
 extern void AllInit();
 
 //io.cpp
-extern int  ParseMove(char *ptrChar, S_BOARD *pos);
+extern char *BoardToFen(const S_BOARD *pos, char *fen);
+extern char *MoveToSan(const int move, S_BOARD *pos, char *san);
+extern char *MoveToSanList(const int move, S_BOARD *pos, const S_MOVELIST *list, char *san);
+extern char *MoveToUci(const int move, char *buf);
+extern int  ParseMove(const char *ptrChar, S_BOARD *pos);
+extern int  ParseSan(const char *san, S_BOARD *pos);
 extern void PrintMoveList(const S_MOVELIST *list);
 extern char *PrMove(const int move);
 extern char *PrSq(const int sq);
+extern char *SqToStr(const int sq, char *buf);
+extern int  VerifyParse(const char *file);
 
 //makemove.cpp
 extern int  MakeMove(S_BOARD *pos, int move);
+extern void MakeNullMove(S_BOARD *pos);
 extern void TakeMove(S_BOARD *pos);
+extern void TakeNullMove(S_BOARD *pos);
+
+//match.cpp
+extern int GameOver(S_BOARD *pos, const char **reason);
+extern int HasLegalMove(S_BOARD *pos);
+extern int PlayMatch(const char *optsA, const char *optsB, S_SEARCHINFO *limits, const char *openingFile, const char *pgnFile,
+                     int games, int threads, double elo0, double elo1, double alpha, double beta);
 
 //misc.cpp
 extern int GetTimeMs();
 
 //movegen.cpp
+extern int  DecodeMove (const S_BOARD *pos, const int from, const int to, const int promoted);
+extern void GenerateAllCaps (const S_BOARD *pos, S_MOVELIST *list);
 extern void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list);
+extern int  MoveExists (S_BOARD *pos, const int move);
+
+//packed.cpp
+extern void  ClosePackedFile(S_PACKEDFILE *pf);
+extern FILE *CreatePackedFile(const char *file);
+extern int   OpenPackedFile(const char *file, S_PACKEDFILE *pf);
+extern long  PackFile(const char *in, const char *out);
+extern unsigned short PackMove(const int move);
+extern int   PackPosition(const S_BOARD *pos, S_PACKEDPOS *pp);
+extern int   ReadPacked(S_PACKEDFILE *pf, S_BOARD *pos, const S_PACKEDPOS **rec);
+extern long  ReadPackedFile(const char *file);
+extern int   UnpackPosition(const S_PACKEDPOS *pp, S_BOARD *pos);
 
 //perf.cpp
 extern void PerftTest(int depth, S_BOARD *pos);
+extern int  PerftSuite(int depth, const char *file);
+
+//polybook.cpp
+extern void ClosePolyBook();
+extern int  GetBookMove(S_BOARD *pos);
+extern int  OpenPolyBook(const char *file);
+extern U64  PolyKeyFromBoard(const S_BOARD *pos);
+
+//profile.cpp
+extern void ProfileMerge();
+extern void ProfileReport(const char *title);
 
 //pvtable.cpp
+extern void ClearPvTable(S_PVTABLE *t);
+extern int  GetPvLine(const int depth, S_BOARD *pos);
 extern void InitPvTable(S_PVTABLE *t);
+extern int  ProbePvTable(const S_BOARD *pos);
+extern void StorePvMove(const S_BOARD *pos, const int move);
 
 //search.cpp
-extern void SearchPosition(S_BOARD *pos);
+extern void InitSearchInfo(S_SEARCHINFO *info);
+extern int  IsRepetition(const S_BOARD *pos);
+extern void SearchPosition(S_BOARD *pos, S_SEARCHINFO *info);
+
+//syzygy.cpp
+extern int  SyzygyInit(const char *path);
+extern void SyzygyFree();
+extern int  SyzygyProbeRoot(S_BOARD *pos, int *move, int *wdl, int *dtz);
+extern int  SyzygyProbeWdl(S_BOARD *pos, int *wdl);
+
+extern int TBLargest;
+
+//tbprobe.cpp
+extern int  TBInit(const char *path);
+extern void TBFree();
+extern int  TBProbeDtz(S_BOARD *pos, int *success);
+extern int  TBProbeWdl(S_BOARD *pos, int *success);
+extern int  VerifyTablebases(const char *path, int step);
+extern long WriteTestTables(const char *dir);
+
+//tune.cpp
+extern int    ReadResult(const char *line);
+extern double TuneEval(const char *file, int epochs, double rate, int threads, const char *outFile);
 
 //validate.cpp
 extern int FileRankValid(const int fr);
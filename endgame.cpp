@@ -0,0 +1,342 @@
+//endgame.cpp
+
+#include "defs.h"
+
+#include <cstdlib>
+#include <cstring>
+
+//Scores of endgames known to be won. Above any material balance the normal evaluation reaches, below TBWIN and mates.
+const int KNOWNWIN = 10000;
+
+
+/*
+    This section is the king and pawn versus king bitbase. Positions are normalised so the pawn is white and on files a-d.
+    That leaves the side to move, both kings and 24 pawn squares: 2 * 64 * 64 * 24 positions, one bit each.
+*/
+#define KPK_SIZE (2 * 64 * 64 * 24)
+
+enum {KPK_INVALID = 0, KPK_UNKNOWN = 1, KPK_DRAW = 2, KPK_WIN = 4};  //Bits, so the results of several moves can be ORed
+
+static unsigned int KPKBitbase[KPK_SIZE / 32];  //Bit set when the position is a win for white
+
+/*
+    Name:    KPKIndex
+    Vars:    int stm - Side to move.
+             int wk  - White king square, 64 based.
+             int bk  - Black king square, 64 based.
+             int wp  - White pawn square, 64 based, on files a-d and ranks 2-7.
+    Purpose: Index a normalised position.
+    Returns: The index into the bitbase.
+*/
+static inline int KPKIndex(int stm, int wk, int bk, int wp) {
+    return wk | (bk << 6) | (stm << 12) | ((wp & 7) << 13) | ((6 - (wp >> 3)) << 15);
+}
+
+static inline int Distance64(int a, int b) {
+    int df = abs((a & 7) - (b & 7));
+    int dr = abs((a >> 3) - (b >> 3));
+    return (df > dr)? df : dr;
+}
+
+/*
+    Name:    KPKInitial
+    Vars:    int stm, wk, bk, wp - The position, as for KPKIndex.
+    Purpose: Classify the positions whose result needs no search: illegal ones, a pawn promoting safely and
+             black stalemated or able to take the pawn.
+    Returns: KPK_INVALID, KPK_WIN, KPK_DRAW or KPK_UNKNOWN.
+*/
+static int KPKInitial(int stm, int wk, int bk, int wp) {
+    if (Distance64(wk, bk) <= 1 || wk == wp || bk == wp)
+        return KPK_INVALID;
+    if (stm == WHITE && (PawnAttacks[WHITE][wp] & SetMask[bk]))  //Black in check with white to move
+        return KPK_INVALID;
+
+    //White promotes and black can't take the new queen
+    if (stm == WHITE && (wp >> 3) == RANK_7 && wk != wp + 8 && bk != wp + 8
+        && (Distance64(bk, wp + 8) > 1 || Distance64(wk, wp + 8) == 1))
+        return KPK_WIN;
+
+    if (stm == BLACK) {
+        U64 covered = KingAttacks[wk] | PawnAttacks[WHITE][wp];
+        if (!(KingAttacks[bk] & ~covered))  //Stalemate. Check is impossible with black to move, the pawn just moved.
+            return KPK_DRAW;
+        if ((KingAttacks[bk] & SetMask[wp]) && !(KingAttacks[wk] & SetMask[wp]))  //Black takes the pawn
+            return KPK_DRAW;
+    }
+
+    return KPK_UNKNOWN;
+}
+
+/*
+    Name:    KPKClassify
+    Vars:    unsigned char *db   - The results so far, by index.
+             int stm, wk, bk, wp - The position, as for KPKIndex.
+    Purpose: Classify a position from the results of its moves. White wins if any move wins, black draws if any move draws.
+             A side whose every move loses, loses. Otherwise the result is still unknown.
+    Returns: The result.
+*/
+static int KPKClassify(const unsigned char *db, int stm, int wk, int bk, int wp) {
+    int good = (stm == WHITE)? KPK_WIN : KPK_DRAW;
+    int bad  = (stm == WHITE)? KPK_DRAW : KPK_WIN;
+    int r = KPK_INVALID;
+    U64 b = KingAttacks[(stm == WHITE)? wk : bk];
+
+    while (b) {
+        int to = POP(&b);
+        r |= (stm == WHITE)? db[KPKIndex(BLACK, to, bk, wp)] : db[KPKIndex(WHITE, wk, to, wp)];
+    }
+
+    if (stm == WHITE && (wp >> 3) < RANK_7) {
+        int push = wp + 8;
+        if (push != wk && push != bk) {
+            r |= db[KPKIndex(BLACK, wk, bk, push)];
+            if ((wp >> 3) == RANK_2 && push + 8 != wk && push + 8 != bk)
+                r |= db[KPKIndex(BLACK, wk, bk, push + 8)];
+        }
+    }
+
+    return (r & good)? good : (r & KPK_UNKNOWN)? KPK_UNKNOWN : bad;
+}
+
+/*
+    Name:    InitKPK
+    Purpose: Build the bitbase by retrograde analysis: classify the positions decided on the board, then keep
+             classifying the rest from their successors until nothing changes. What is still unknown is a draw.
+*/
+static void InitKPK() {
+    static unsigned char db[KPK_SIZE];
+
+    for (int idx = 0; idx < KPK_SIZE; ++idx) {
+        int wk = idx & 63, bk = (idx >> 6) & 63, stm = (idx >> 12) & 1;
+        int wp = ((6 - (idx >> 15)) << 3) | ((idx >> 13) & 3);
+        db[idx] = (unsigned char)KPKInitial(stm, wk, bk, wp);
+    }
+
+    int changed = TRUE;
+    while (changed) {
+        changed = FALSE;
+        for (int idx = 0; idx < KPK_SIZE; ++idx) {
+            if (db[idx] != KPK_UNKNOWN)
+                continue;
+            int wk = idx & 63, bk = (idx >> 6) & 63, stm = (idx >> 12) & 1;
+            int wp = ((6 - (idx >> 15)) << 3) | ((idx >> 13) & 3);
+            int r = KPKClassify(db, stm, wk, bk, wp);
+            if (r != KPK_UNKNOWN) {
+                db[idx] = (unsigned char)r;
+                changed = TRUE;
+            }
+        }
+    }
+
+    memset(KPKBitbase, 0, sizeof(KPKBitbase));
+    for (int idx = 0; idx < KPK_SIZE; ++idx)
+        if (db[idx] == KPK_WIN)
+            KPKBitbase[idx >> 5] |= 1u << (idx & 31);
+}
+
+/*
+    Name:    ProbeKPK
+    Vars:    int strong - The side with the pawn.
+             int stm    - The side to move.
+             int sk     - The strong king's square, 120 based.
+             int wk     - The weak king's square, 120 based.
+             int sp     - The pawn's square, 120 based.
+    Purpose: Look a king and pawn versus king position up in the bitbase, turning it into white's pawn on files a-d first.
+    Returns: TRUE if the side with the pawn wins.
+*/
+int ProbeKPK(int strong, int stm, int sk, int wk, int sp) {
+    int s = SQ64(sk), w = SQ64(wk), p = SQ64(sp);
+
+    if (strong == BLACK) {  //Flip the board so the pawn is white
+        s ^= 56; w ^= 56; p ^= 56;
+        stm ^= 1;
+    }
+    if ((p & 7) > FILE_D) {  //Mirror so the pawn is on files a-d
+        s ^= 7; w ^= 7; p ^= 7;
+    }
+
+    int idx = KPKIndex(stm, s, w, p);
+    return (KPKBitbase[idx >> 5] >> (idx & 31)) & 1;
+}
+
+
+/*
+    This section is the specialized evaluators. Each scores an endgame from the point of view of its strong side.
+*/
+typedef int (*EndgameFn)(const S_BOARD *pos, int strong);
+
+//An evaluator and the material it applies to
+typedef struct {
+    U64 signature;
+    EndgameFn eval;
+    int strong;
+} S_ENDGAME;
+
+#define MAXENDGAMES 32
+static S_ENDGAME Endgames[MAXENDGAMES];
+static int NumEndgames = 0;
+
+//Drive the losing king to the edge, and bring the winning king next to it
+static inline int PushToEdge(int sq120) {
+    int f = FilesBrd[sq120], r = RanksBrd[sq120];
+    int fe = (f < 7 - f)? f : 7 - f;
+    int re = (r < 7 - r)? r : 7 - r;
+    return 20 * (3 - fe) + 20 * (3 - re);
+}
+
+static inline int PushClose(int a120, int b120) {
+    return 70 - 10 * Distance64(SQ64(a120), SQ64(b120));
+}
+
+/*
+    Name:    MaterialSignature
+    Vars:    int *pceNum - Piece counts indexed by piece.
+    Purpose: Pack the counts of every piece but the kings, 4 bits each, into one number that identifies the material.
+    Returns: The signature.
+*/
+static U64 MaterialSignature(const int *pceNum) {
+    U64 sig = 0;
+    for (int pce = wP; pce <= bQ; ++pce) {
+        if (pce == wK)
+            continue;
+        sig |= (U64)(pceNum[pce] & 15) << (4 * pce);
+    }
+    return sig;
+}
+
+/*
+    Name:    EvalKXK
+    Purpose: Lone king against mating material (ex. KQK, KRK, KBBK). Win by forcing the king to the edge.
+*/
+static int EvalKXK(const S_BOARD *pos, int strong) {
+    int weak = strong ^ 1;
+    int sk = pos->KingSq[strong], wk = pos->KingSq[weak];
+    return KNOWNWIN + pos->material[strong] - PieceVal[wK] + PushToEdge(wk) + PushClose(sk, wk);
+}
+
+/*
+    Name:    EvalKBBK
+    Purpose: Two bishops against king. Bishops on the same colour can't force mate, so that is a draw; otherwise
+             it is scored as KXK.
+*/
+static int EvalKBBK(const S_BOARD *pos, int strong) {
+    const U64 dark = 0xAA55AA55AA55AA55ULL;  //a1 is dark
+    U64 bishops = pos->pceBB[(strong == WHITE)? wB : bB];
+    if (!(bishops & dark) || !(bishops & ~dark))
+        return 0;
+    return EvalKXK(pos, strong);
+}
+
+/*
+    Name:    EvalKBNK
+    Purpose: King, bishop and knight against king. Mate is only possible in a corner of the bishop's colour,
+             so the losing king is driven towards the nearer of those.
+*/
+static int EvalKBNK(const S_BOARD *pos, int strong) {
+    int weak = strong ^ 1;
+    int sk = pos->KingSq[strong], wk = SQ64(pos->KingSq[weak]);
+    int bishop = SQ64(pos->pList[(strong == WHITE)? wB : bB][0]);
+
+    int dark = (((bishop & 7) + (bishop >> 3)) & 1) == 0;  //a1 is dark
+    int c1 = (dark)? SQ64(A1) : SQ64(H1);
+    int c2 = (dark)? SQ64(H8) : SQ64(A8);
+    int corner = Distance64(wk, c1);
+    if (Distance64(wk, c2) < corner)
+        corner = Distance64(wk, c2);
+
+    return KNOWNWIN + PieceVal[wB] + PieceVal[wN] + 40 * (7 - corner) + PushClose(sk, pos->KingSq[weak]);
+}
+
+/*
+    Name:    EvalKPK
+    Purpose: King and pawn against king, scored exactly from the bitbase. Won positions still reward advancing the pawn.
+*/
+static int EvalKPK(const S_BOARD *pos, int strong) {
+    int pawn = pos->pList[(strong == WHITE)? wP : bP][0];
+    if (!ProbeKPK(strong, pos->side, pos->KingSq[strong], pos->KingSq[strong ^ 1], pawn))
+        return 0;
+
+    int rank = (strong == WHITE)? RanksBrd[pawn] : RANK_8 - RanksBrd[pawn];
+    return KNOWNWIN + PieceVal[wP] + 20 * rank;
+}
+
+/*
+    Name:    EvalDraw
+    Purpose: Material that can't force mate (KK, KNK, KBK, KNNK).
+*/
+static int EvalDraw(const S_BOARD *pos, int strong) {
+    (void)pos; (void)strong;
+    return 0;
+}
+
+/*
+    Name:    AddEndgame
+    Vars:    const char *code - The material, strong side first, ex. "KBNK". Each side starts with its K.
+             EndgameFn eval   - The evaluator.
+    Purpose: Register an evaluator for the material with either colour as the strong side.
+*/
+static void AddEndgame(const char *code, EndgameFn eval) {
+    const char *pieces = "PNBRQK";
+
+    for (int strong = WHITE; strong <= BLACK; ++strong) {
+        int counts[13] = {0};
+        int side = strong ^ 1;  //The first K switches to the strong side
+
+        for (const char *c = code; *c; ++c) {
+            int type = (int)(strchr(pieces, *c) - pieces);  //0 for a pawn .. 5 for a king
+            if (*c == 'K')
+                side ^= 1;
+            counts[((side == WHITE)? wP : bP) + type]++;
+        }
+
+        Endgames[NumEndgames].signature = MaterialSignature(counts);
+        Endgames[NumEndgames].eval = eval;
+        Endgames[NumEndgames].strong = strong;
+        NumEndgames++;
+    }
+}
+
+/*
+    Name:    InitEndgames
+    Purpose: Build the KPK bitbase and register the specialized evaluators.
+*/
+void InitEndgames() {
+    InitKPK();
+
+    NumEndgames = 0;
+    AddEndgame("KPK",  EvalKPK);
+    AddEndgame("KBNK", EvalKBNK);
+    AddEndgame("KQK",  EvalKXK);
+    AddEndgame("KRK",  EvalKXK);
+    AddEndgame("KBBK", EvalKBBK);
+    AddEndgame("KQQK", EvalKXK);
+    AddEndgame("KQRK", EvalKXK);
+    AddEndgame("KRRK", EvalKXK);
+    AddEndgame("KK",   EvalDraw);
+    AddEndgame("KNK",  EvalDraw);
+    AddEndgame("KBK",  EvalDraw);
+    AddEndgame("KNNK", EvalDraw);
+}
+
+/*
+    Name:    EvaluateEndgame
+    Vars:    S_BOARD *pos - Pointer to a position.
+             int *score   - Set to the score from the point of view of the side to move.
+    Purpose: Score the position with a specialized evaluator if its material has one. Only positions with at most
+             five pieces are looked up, so the middlegame never pays for it.
+    Returns: TRUE if an evaluator scored the position.
+*/
+int EvaluateEndgame(const S_BOARD *pos, int *score) {
+    if (CNT(pos->occupied[BOTH]) > 5)
+        return FALSE;
+
+    U64 sig = MaterialSignature(pos->pceNum);
+    for (int i = 0; i < NumEndgames; ++i) {
+        if (Endgames[i].signature != sig)
+            continue;
+        int s = Endgames[i].eval(pos, Endgames[i].strong);
+        *score = (pos->side == Endgames[i].strong)? s : -s;
+        return TRUE;
+    }
+    return FALSE;
+}
@@ -0,0 +1,280 @@
+//epd.cpp
+
+#include "defs.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define MAXEPDMOVES 8   //The most moves a bm or am opcode can list
+
+//A test position: the first four FEN fields and its bm (best move) and am (avoid move) opcodes
+typedef struct {
+    int line;               //Line number in the file
+    string fen;
+    string id;
+    string bmText, amText;  //The opcodes as written, for the report
+    int bm[MAXEPDMOVES];
+    int numBm;
+    int am[MAXEPDMOVES];
+    int numAm;
+} S_EPDPOS;
+
+//How the search did on a position
+typedef struct {
+    int move;       //The move played
+    int solved;
+    int solveTime;  //ms until the search settled on a correct move for good. -1 if unsolved.
+    int depth;      //Iterations completed
+    int time;
+    long nodes;
+} S_EPDRESULT;
+
+
+/*
+    Name:    ParseEpdMoves
+    Vars:    const string &text - The moves of an opcode in SAN. Ex. "Qxg7+ Rf8"
+             S_BOARD *pos       - The test position.
+             int *moves         - Filled with the moves.
+    Purpose: Convert the moves of a bm or am opcode. SAN is standard, but coordinate moves (e2e4) are accepted too.
+    Returns: The number of moves, or -1 if any could not be read.
+*/
+static int ParseEpdMoves(const string &text, S_BOARD *pos, int *moves) {
+    int count = 0;
+    size_t i = 0;
+
+    while (i < text.size()) {
+        while (i < text.size() && text[i] == ' ')
+            ++i;
+        size_t start = i;
+        while (i < text.size() && text[i] != ' ')
+            ++i;
+        if (i == start)
+            break;
+
+        char token[16];
+        snprintf(token, sizeof(token), "%s", text.substr(start, i - start).c_str());
+
+        int move = ParseSan(token, pos);
+        if (move == NOMOVE && strlen(token) >= 4)
+            move = ParseMove(token, pos);
+        if (move == NOMOVE || count == MAXEPDMOVES)
+            return -1;
+        moves[count++] = move;
+    }
+    return count;
+}
+
+
+/*
+    Name:    ParseEpd
+    Vars:    const char *line - An EPD line. Ex. 2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - bm Qg6; id "WAC.001";
+             S_BOARD *pos     - Set to the position.
+             S_EPDPOS *epd    - Filled with the position and its opcodes.
+    Purpose: Read an EPD line. The four FEN fields go through ParseFen; the opcodes after them are split on ';'.
+             Opcodes other than bm, am and id are ignored.
+    Returns: TRUE if the line held a position with at least one bm or am move.
+*/
+static int ParseEpd(const char *line, S_BOARD *pos, S_EPDPOS *epd) {
+    //The opcodes start after the fourth space separated field
+    const char *ops = line;
+    for (int field = 0; field < 4 && ops != NULL; ++field) {
+        ops = strchr(ops, ' ');
+        if (ops != NULL)
+            while (*ops == ' ')
+                ++ops;
+    }
+    if (ops == NULL)
+        return FALSE;
+
+    epd->fen = string(line, ops - line);
+    if (ParseFen(epd->fen, pos) != 0)
+        return FALSE;
+
+    epd->numBm = epd->numAm = 0;
+    string rest(ops);
+    size_t start = 0;
+    while (start < rest.size()) {
+        size_t end = rest.find(';', start);
+        if (end == string::npos)
+            end = rest.size();
+        string op = rest.substr(start, end - start);
+        start = end + 1;
+
+        size_t b = op.find_first_not_of(" \t\r\n");
+        if (b == string::npos)
+            continue;
+        op = op.substr(b, op.find_last_not_of(" \t\r\n") - b + 1);
+
+        size_t space = op.find(' ');
+        string name = op.substr(0, space);
+        string operand = (space == string::npos)? "" : op.substr(space + 1);
+
+        if (name == "bm") {
+            epd->bmText = operand;
+            epd->numBm = ParseEpdMoves(operand, pos, epd->bm);
+        } else if (name == "am") {
+            epd->amText = operand;
+            epd->numAm = ParseEpdMoves(operand, pos, epd->am);
+        } else if (name == "id") {
+            if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"')
+                operand = operand.substr(1, operand.size() - 2);
+            epd->id = operand;
+        }
+    }
+
+    if (epd->numBm < 0 || epd->numAm < 0) {
+        cout << "Line " << epd->line << ": cannot read the moves of " << (epd->numBm < 0? "bm " + epd->bmText : "am " + epd->amText) << "\n";
+        return FALSE;
+    }
+    return epd->numBm + epd->numAm > 0;
+}
+
+
+/*
+    Name:    IsCorrect
+    Vars:    S_EPDPOS *epd - A test position.
+             int move      - A move the search chose.
+    Purpose: A move is correct if it is one of the bm moves (when there are any) and none of the am moves.
+    Returns: TRUE if the move solves the position.
+*/
+static int IsCorrect(const S_EPDPOS *epd, const int move) {
+    for (int i = 0; i < epd->numAm; ++i)
+        if (epd->am[i] == move)
+            return FALSE;
+    if (epd->numBm == 0)
+        return move != NOMOVE;
+    for (int i = 0; i < epd->numBm; ++i)
+        if (epd->bm[i] == move)
+            return TRUE;
+    return FALSE;
+}
+
+
+/*
+    Name:    EpdWorker
+    Vars:    vector<S_EPDPOS> *suite       - The test positions.
+             vector<S_EPDRESULT> *results  - Filled in at the index of each position.
+             atomic<size_t> *next          - The next position no worker has taken yet.
+             S_SEARCHINFO *limits          - The search budget of every position.
+    Purpose: Search positions until none are left. Each worker has its own board and pv table.
+*/
+static void EpdWorker(vector<S_EPDPOS> *suite, vector<S_EPDRESULT> *results, atomic<size_t> *next, S_SEARCHINFO *limits) {
+    S_BOARD board[1];
+    board->PvTable->pTable = NULL;
+    InitPvTable(board->PvTable);
+
+    S_SEARCHINFO info[1];
+    *info = *limits;
+    info->quiet = TRUE;
+    info->multiPV = 1;
+    info->keepHash = FALSE;
+
+    for (size_t i = (*next)++; i < suite->size(); i = (*next)++) {
+        S_EPDPOS *epd = &(*suite)[i];
+        S_EPDRESULT *res = &(*results)[i];
+
+        ParseFen(epd->fen, board);
+        SearchPosition(board, info);
+
+        res->move = info->bestMove;
+        res->solved = IsCorrect(epd, info->bestMove);
+        res->depth = info->iterations;
+        res->time = GetTimeMs() - info->starttime;
+        res->nodes = info->nodes;
+
+        //Time to solution is when the search found a correct move and never changed its mind afterwards
+        res->solveTime = -1;
+        for (int it = info->iterations - 1; it >= 0 && IsCorrect(epd, info->iter[it].move); --it)
+            res->solveTime = info->iter[it].time;
+    }
+
+    free(board->PvTable->pTable);
+    ProfileMerge();
+}
+
+
+/*
+    Name:    EpdSuite
+    Vars:    const char *file     - An EPD file with bm and/or am opcodes. Ex. Win At Chess.
+             S_SEARCHINFO *limits - The search budget of every position: depth, nodeLimit and/or moveTime.
+             int threads          - Worker threads the positions are shared between.
+    Purpose: Tactical benchmark. Search every position and report whether it was solved, the time to solution and the speed,
+             then the totals: solved count, nodes per second and positions solved per CPU second (summed over the workers),
+             so the strength bought by every engine change can be weighed against its cost.
+    Returns: The number of positions solved, or -1 if the file can't be read.
+*/
+int EpdSuite(const char *file, S_SEARCHINFO *limits, int threads) {
+    FILE *f = fopen(file, "r");
+    if (f == NULL) {
+        cout << "Could not open " << file << endl;
+        return -1;
+    }
+
+    vector<S_EPDPOS> suite;
+    S_BOARD board[1];
+    char line[1024];
+    int lineNum = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineNum++;
+        if (line[0] == '\n' || line[0] == '\r' || line[0] == '#')
+            continue;
+
+        S_EPDPOS epd;
+        epd.line = lineNum;
+        if (ParseEpd(line, board, &epd))
+            suite.push_back(epd);
+    }
+    fclose(f);
+
+    if (threads < 1)
+        threads = 1;
+
+    int start = GetTimeMs();
+    vector<S_EPDRESULT> results(suite.size());
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (int i = 0; i < threads; ++i)
+        workers.emplace_back(EpdWorker, &suite, &results, &next, limits);
+    for (thread &t : workers)
+        t.join();
+    int wall = GetTimeMs() - start;
+
+    int solved = 0;
+    long nodes = 0;
+    long cpuTime = 0;   //Search time summed over the workers
+    long solveTime = 0;
+    for (size_t i = 0; i < suite.size(); ++i) {
+        S_EPDPOS *epd = &suite[i];
+        S_EPDRESULT *res = &results[i];
+
+        printf("%-12s %-8s found %-6s", (epd->id.empty())? to_string(epd->line).c_str() : epd->id.c_str(),
+               (res->solved)? "solved" : "FAILED", PrMove(res->move));
+        if (epd->numBm) printf(" bm %s", epd->bmText.c_str());
+        if (epd->numAm) printf(" am %s", epd->amText.c_str());
+        if (res->solved) printf(" in %dms", res->solveTime);
+        printf("  depth %d nodes %ld time %dms\n", res->depth, res->nodes, res->time);
+
+        solved += res->solved;
+        nodes += res->nodes;
+        cpuTime += res->time;
+        if (res->solved)
+            solveTime += res->solveTime;
+    }
+
+    printf("\nSolved %d of %d positions with %d thread%s in %dms\n", solved, (int)suite.size(), threads, (threads == 1)? "" : "s", wall);
+    printf("Nodes %ld   NPS %.0f   Average time to solution %.0fms   Solved per CPU second %.3f\n",
+           nodes, (cpuTime)? 1000.0 * nodes / cpuTime : 0.0,
+           (solved)? (double)solveTime / solved : 0.0,
+           (cpuTime)? 1000.0 * solved / cpuTime : 0.0);
+    ProfileReport("epd");
+
+    return solved;
+}
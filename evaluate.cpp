@@ -0,0 +1,188 @@
+//evaluate.cpp
+
+#include "defs.h"
+
+#include <cstdio>
+#include <iostream>
+
+//Piece-square tables. They are written from white's point of view with a1 as the first entry, so the board reads upside down.
+//Black pieces look their square up through Mirror64.
+int PawnTable[64] = {
+     0,   0,   0,   0,   0,   0,   0,   0,
+    10,  10,   0, -10, -10,   0,  10,  10,
+     5,   0,   0,   5,   5,   0,   0,   5,
+     0,   0,  10,  20,  20,  10,   0,   0,
+     5,   5,   5,  10,  10,   5,   5,   5,
+    10,  10,  10,  20,  20,  10,  10,  10,
+    20,  20,  20,  30,  30,  20,  20,  20,
+     0,   0,   0,   0,   0,   0,   0,   0
+};
+
+int KnightTable[64] = {
+     0, -10,   0,   0,   0,   0, -10,   0,
+     0,   0,   0,   5,   5,   0,   0,   0,
+     0,   0,  10,  10,  10,  10,   0,   0,
+     0,   0,  10,  20,  20,  10,   5,   0,
+     5,  10,  15,  20,  20,  15,  10,   5,
+     5,  10,  10,  20,  20,  10,  10,   5,
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   0,   0,   0,   0,   0,   0,   0
+};
+
+int BishopTable[64] = {
+     0,   0, -10,   0,   0, -10,   0,   0,
+     0,   0,   0,  10,  10,   0,   0,   0,
+     0,   0,  10,  15,  15,  10,   0,   0,
+     0,  10,  15,  20,  20,  15,  10,   0,
+     0,  10,  15,  20,  20,  15,  10,   0,
+     0,   0,  10,  15,  15,  10,   0,   0,
+     0,   0,   0,  10,  10,   0,   0,   0,
+     0,   0,   0,   0,   0,   0,   0,   0
+};
+
+int RookTable[64] = {
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   0,   5,  10,  10,   5,   0,   0,
+     0,   0,   5,  10,  10,   5,   0,   0,
+    25,  25,  25,  25,  25,  25,  25,  25,
+     0,   0,   5,  10,  10,   5,   0,   0
+};
+
+int KingE[64] = {   //King table for the endgame. The king should come to the centre.
+   -50, -10,   0,   0,   0,   0, -10, -50,
+   -10,   0,  10,  10,  10,  10,   0, -10,
+     0,  10,  20,  20,  20,  20,  10,   0,
+     0,  10,  20,  40,  40,  20,  10,   0,
+     0,  10,  20,  40,  40,  20,  10,   0,
+     0,  10,  20,  20,  20,  20,  10,   0,
+   -10,   0,  10,  10,  10,  10,   0, -10,
+   -50, -10,   0,   0,   0,   0, -10, -50
+};
+
+int KingO[64] = {   //King table for the opening and middlegame. The king should stay castled.
+     0,   5,   5, -10, -10,   0,  10,   5,
+   -30, -30, -30, -30, -30, -30, -30, -30,
+   -50, -50, -50, -50, -50, -50, -50, -50,
+   -70, -70, -70, -70, -70, -70, -70, -70,
+   -70, -70, -70, -70, -70, -70, -70, -70,
+   -70, -70, -70, -70, -70, -70, -70, -70,
+   -70, -70, -70, -70, -70, -70, -70, -70,
+   -70, -70, -70, -70, -70, -70, -70, -70
+};
+
+int PawnIsolated      = -10;
+int PawnPassed[8]     = {0, 5, 10, 20, 35, 60, 100, 200};  //Bonus by rank, from the pawn's own side
+int RookOpenFile      = 10;
+int RookSemiOpenFile  = 5;
+int QueenOpenFile     = 5;
+int QueenSemiOpenFile = 3;
+int BishopPair        = 30;
+
+//Below this much non-pawn material (including the king) a side's king uses the endgame table
+const int ENDGAME_MAT = 1 * 500 + 2 * 320 + 2 * 100 + 32767;
+
+
+/*
+    Name:    EvalPosition
+    Vars:    S_BOARD *pos - Pointer to a position.
+    Purpose: Statically score a position from material, piece placement, pawn structure and open files.
+    Returns: The score in centipawns from the point of view of the side to move.
+*/
+int EvalPosition(const S_BOARD *pos) {
+    PROFILE(PROF_EVAL);
+    ASSERT(CheckBoard(pos));
+
+    //Endgames with a known result are scored by their own evaluator
+    int egScore;
+    if (EvaluateEndgame(pos, &egScore))
+        return egScore;
+
+    int pce, pceNum, sq, sq64;
+    int score = pos->material[WHITE] - pos->material[BLACK];
+
+    pce = wP;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
+        sq64 = SQ64(pos->pList[pce][pceNum]);
+        score += PawnTable[sq64];
+
+        if ((IsolatedMask[sq64] & pos->pawns[WHITE]) == 0)
+            score += PawnIsolated;
+
+        if ((PassedMask[WHITE][sq64] & pos->pawns[BLACK]) == 0)
+            score += PawnPassed[sq64 / 8];
+    }
+
+    pce = bP;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
+        sq64 = SQ64(pos->pList[pce][pceNum]);
+        score -= PawnTable[Mirror64[sq64]];
+
+        if ((IsolatedMask[sq64] & pos->pawns[BLACK]) == 0)
+            score -= PawnIsolated;
+
+        if ((PassedMask[BLACK][sq64] & pos->pawns[WHITE]) == 0)
+            score -= PawnPassed[7 - sq64 / 8];
+    }
+
+    pce = wN;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum)
+        score += KnightTable[SQ64(pos->pList[pce][pceNum])];
+
+    pce = bN;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum)
+        score -= KnightTable[Mirror64[SQ64(pos->pList[pce][pceNum])]];
+
+    pce = wB;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum)
+        score += BishopTable[SQ64(pos->pList[pce][pceNum])];
+
+    pce = bB;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum)
+        score -= BishopTable[Mirror64[SQ64(pos->pList[pce][pceNum])]];
+
+    //Rooks and queens like files without pawns (open) or without their own pawns (semi-open)
+    pce = wR;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
+        sq = pos->pList[pce][pceNum];
+        score += RookTable[SQ64(sq)];
+        if (!(pos->pawns[BOTH] & FileBBMask[FilesBrd[sq]]))       score += RookOpenFile;
+        else if (!(pos->pawns[WHITE] & FileBBMask[FilesBrd[sq]])) score += RookSemiOpenFile;
+    }
+
+    pce = bR;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
+        sq = pos->pList[pce][pceNum];
+        score -= RookTable[Mirror64[SQ64(sq)]];
+        if (!(pos->pawns[BOTH] & FileBBMask[FilesBrd[sq]]))       score -= RookOpenFile;
+        else if (!(pos->pawns[BLACK] & FileBBMask[FilesBrd[sq]])) score -= RookSemiOpenFile;
+    }
+
+    pce = wQ;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
+        sq = pos->pList[pce][pceNum];
+        if (!(pos->pawns[BOTH] & FileBBMask[FilesBrd[sq]]))       score += QueenOpenFile;
+        else if (!(pos->pawns[WHITE] & FileBBMask[FilesBrd[sq]])) score += QueenSemiOpenFile;
+    }
+
+    pce = bQ;
+    for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
+        sq = pos->pList[pce][pceNum];
+        if (!(pos->pawns[BOTH] & FileBBMask[FilesBrd[sq]]))       score -= QueenOpenFile;
+        else if (!(pos->pawns[BLACK] & FileBBMask[FilesBrd[sq]])) score -= QueenSemiOpenFile;
+    }
+
+    //Each king uses the endgame table once the other side has little material left to attack it with
+    sq64 = SQ64(pos->KingSq[WHITE]);
+    score += (pos->material[BLACK] <= ENDGAME_MAT)? KingE[sq64] : KingO[sq64];
+
+    sq64 = Mirror64[SQ64(pos->KingSq[BLACK])];
+    score -= (pos->material[WHITE] <= ENDGAME_MAT)? KingE[sq64] : KingO[sq64];
+
+    if (pos->pceNum[wB] >= 2) score += BishopPair;
+    if (pos->pceNum[bB] >= 2) score -= BishopPair;
+
+    return (pos->side == WHITE)? score : -score;
+}
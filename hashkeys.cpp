@@ -2,26 +2,30 @@
 
 #include "defs.h"
 
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 /*
     Name:    GeneratePosKey
     Vars:    S_BOARD *pos - A pointer to the position in which a key should be generated.
-    Purpose: Create a unique key for a given position.
+    Purpose: Create a unique key for a given position from scratch. The piece lists must already be up to date.
     Returns: A 64 bit key.
 */
 U64 GeneratePosKey(const S_BOARD *pos) {
-    int sq = 0;
+    int pce = EMPTY, pceNum = 0, sq = 0;
     U64 finalKey = 0;   //Final key to be returned
-    int piece = EMPTY;
-
-    //Generate a unique key based on the pieces on the board
-    for (sq = 0; sq < BRD_SQ_NUM; ++sq) {
-        piece = pos->pieces[sq];                //Extract the piece from a square on the given board
-        if (piece != NO_SQ && piece != EMPTY && piece != OFFBOARD) { //If the square is on the playing board and has a piece on it
-            ASSERT(piece >= wP && piece <= bK); //Assert that the piece is valid (its value is between a white pawn and black king)
-            finalKey ^= PieceKeys[piece][sq];   //XOR the final key with the new key for the piece and update the final key
+
+    //Generate a unique key based on the pieces on the board. Only the piece lists are walked, so empty and offboard squares cost nothing.
+    for (pce = wP; pce <= bK; ++pce) {
+        for (pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
+            sq = pos->pList[pce][pceNum];
+            ASSERT(SqOnBoard(sq));                  //Assert that the listed square is on the playing board
+            finalKey ^= PieceKeys[pce][sq];         //XOR the final key with the new key for the piece and update the final key
         }
     }
 
@@ -38,4 +42,175 @@ U64 GeneratePosKey(const S_BOARD *pos) {
     finalKey ^= CastleKeys[pos->castlePerm]; //XOR the castle permission value to the key
 
     return finalKey;
-}
\ No newline at end of file
+}
+
+int  HashVerifyInterval = 0;  //Recompute the key on every Nth call to VerifyPosKey. 0 turns verification off.
+long HashVerifyChecks   = 0;  //How many keys have been recomputed
+long HashVerifyErrors   = 0;  //How many recomputed keys did not match the incremental key
+
+/*
+    Name:    VerifyPosKey
+    Vars:    S_BOARD *pos - Pointer to a position.
+    Purpose: Sample the incrementally maintained key against a full recomputation. Unlike the ASSERT in CheckBoard
+             this runs in release builds, so incremental hashing can be checked at a low, fixed cost.
+             On a mismatch the moves that led to the position are printed so the bad update can be replayed.
+    Returns: FALSE if a sampled key was wrong, TRUE otherwise.
+*/
+int VerifyPosKey(const S_BOARD *pos) {
+    static int calls = 0;
+
+    if (HashVerifyInterval <= 0 || ++calls < HashVerifyInterval)
+        return TRUE;
+    calls = 0;
+
+    HashVerifyChecks++;
+    U64 key = GeneratePosKey(pos);
+    if (key == pos->posKey)
+        return TRUE;
+
+    HashVerifyErrors++;
+    printf("Hash mismatch: incremental %llX, recomputed %llX\nMoves:", pos->posKey, key);
+    for (int i = 0; i < pos->hisPly; ++i)
+        printf(" %s", PrMove(pos->history[i].move));
+    printf("\n");
+    PrintBoard(pos);
+
+    return FALSE;
+}
+
+//The full position a key was generated from. Used to tell a real collision (different positions, same key) apart from a transposition.
+typedef struct {
+    unsigned char pieces[PLAY_SQ_NUM];
+    unsigned char side;
+    unsigned char castlePerm;
+    unsigned char enPas;
+} S_HASHPOS;
+
+//Counters gathered while walking the test positions
+typedef struct {
+    std::unordered_map<U64, S_HASHPOS> seen;  //Every distinct key and the position it belongs to
+    long nodes;                               //Positions visited, including transpositions
+    long collisions;                          //Keys shared by two different positions
+} S_HASHSTATS;
+
+/*
+    Name:    HashPosition
+    Vars:    S_BOARD *pos - Pointer to a position.
+             S_HASHPOS *hp - The structure to fill.
+    Purpose: Copy everything the position key is meant to describe into hp.
+*/
+static void HashPosition(const S_BOARD *pos, S_HASHPOS *hp) {
+    for (int sq64 = 0; sq64 < PLAY_SQ_NUM; ++sq64)
+        hp->pieces[sq64] = (unsigned char)pos->pieces[SQ120(sq64)];
+    hp->side = (unsigned char)pos->side;
+    hp->castlePerm = (unsigned char)pos->castlePerm;
+    hp->enPas = (unsigned char)pos->enPas;
+}
+
+/*
+    Name:    HashWalk
+    Vars:    int depth          - The number of plies left to walk.
+             S_BOARD *pos       - Pointer to a position.
+             S_HASHSTATS *stats - The counters to update.
+    Purpose: Visit every position reachable within depth plies (like Perft) and record its key.
+*/
+static void HashWalk(int depth, S_BOARD *pos, S_HASHSTATS *stats) {
+    S_HASHPOS hp;
+    HashPosition(pos, &hp);
+    stats->nodes++;
+
+    auto found = stats->seen.find(pos->posKey);
+    if (found == stats->seen.end())
+        stats->seen.emplace(pos->posKey, hp);
+    else if (memcmp(&found->second, &hp, sizeof(S_HASHPOS)) != 0)
+        stats->collisions++;
+
+    if (depth == 0)
+        return;
+
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+
+    for (int MoveNum = 0; MoveNum < list->count; ++MoveNum) {
+        if (!MakeMove(pos, list->moves[MoveNum].move))
+            continue;
+        HashWalk(depth-1, pos, stats);
+        TakeMove(pos);
+    }
+}
+
+/*
+    Name:    HashStats
+    Vars:    int depth        - How many plies to walk from each position.
+             const char *file - A perft suite file with one FEN at the start of each line.
+    Purpose: Diagnostic mode that measures the quality of the hash keys.
+             Reports full 64 bit collisions, 32 bit partial collisions (against the birthday bound),
+             the bias of each key bit and the spread of keys over a table the size of the key set.
+*/
+void HashStats(int depth, const char *file) {
+    FILE *f = fopen(file, "r");
+    if (f == NULL) {
+        printf("Could not open %s\n", file);
+        return;
+    }
+
+    S_HASHSTATS stats{};  //Value-initialized, so the counters start at 0
+    S_BOARD board[1];
+    char line[1024];
+    int fens = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (line[0] == '\n' || ParseFen(line, board) != 0)
+            continue;
+        HashWalk(depth, board, &stats);
+        fens++;
+    }
+    fclose(f);
+
+    double unique = (double)stats.seen.size();
+    printf("Walked %d positions to depth %d: %ld nodes, %.0f unique keys\n", fens, depth, stats.nodes, unique);
+    printf("64 bit collisions: %ld\n", stats.collisions);
+
+    //Keys that agree in their low 32 bits. A table storing only part of the key would confuse these.
+    std::unordered_map<unsigned int, int> low;
+    long partial = 0;
+    int bitCount[64] = {0};
+    for (auto &entry : stats.seen) {
+        if (low[(unsigned int)entry.first]++ > 0)
+            partial++;
+        for (int bit = 0; bit < 64; ++bit)
+            if (entry.first & (1ULL << bit))
+                bitCount[bit]++;
+    }
+    printf("32 bit partial collisions: %ld (expected about %.1f)\n", partial, unique * unique / 2.0 / 4294967296.0);
+
+    //Each key bit should be set in half the keys
+    double worstBias = 0.0;
+    int worstBit = 0;
+    for (int bit = 0; bit < 64; ++bit) {
+        double bias = fabs(bitCount[bit] / unique - 0.5);
+        if (bias > worstBias) {
+            worstBias = bias;
+            worstBit = bit;
+        }
+    }
+    printf("Worst bit bias: bit %d set in %.4f of keys\n", worstBit, bitCount[worstBit] / unique);
+
+    //Index a table the same way the pv table does (key % entries) and compare the load against a uniform spread
+    int buckets = 1;
+    while (buckets < unique)
+        buckets <<= 1;
+    std::vector<int> load(buckets, 0);
+    for (auto &entry : stats.seen)
+        load[entry.first % buckets]++;
+
+    double expected = unique / buckets, chiSq = 0.0;
+    int used = 0, maxLoad = 0;
+    for (int i = 0; i < buckets; ++i) {
+        chiSq += (load[i] - expected) * (load[i] - expected) / expected;
+        if (load[i] > 0) used++;
+        if (load[i] > maxLoad) maxLoad = load[i];
+    }
+    printf("Buckets: %d, used %d (expected about %.0f), max load %d\n", buckets, used, buckets * (1.0 - exp(-expected)), maxLoad);
+    printf("Chi-square: %.1f over %d degrees of freedom\n", chiSq, buckets - 1);
+}
@@ -8,120 +8,330 @@
 
 using namespace std;
 
-//Generate a random 64 bit number
-//rand() generates a 15 bit num so we generate multiple numbers and add them to a 64 bit number
-#define RAND_64 ( (U64)rand() | \
-                  (U64)rand() << 15 | \
-                  (U64)rand() << 30 | \
-                  (U64)rand() << 45 | \
-                  ((U64)rand() & 0xf) << 60 )
+//All lookup tables in this file are built by constexpr functions, so the compiler emits them as finished read-only data.
+//Nothing is computed at startup and every build (on every platform) produces the same tables and hash keys.
 
-int Sq120ToSq64[BRD_SQ_NUM]; //120 int bitboard
-int Sq64ToSq120[64];         //64 int bitboard
+//Seed for the hash key stream. Override with -DZOBRIST_SEED=<value> to build an engine with a different (but still reproducible) key set.
+#ifndef ZOBRIST_SEED
+#define ZOBRIST_SEED 0x7A3C1E5F29B84D61ULL
+#endif
 
-U64 SetMask[64];
-U64 ClearMask[64];
+/*
+    Name:    Rand64
+    Vars:    U64 *state - The generator state. Any value, including 0, is a valid seed.
+    Purpose: splitmix64 generator used to produce the hash keys at compile time.
+             Every output bit depends on every state bit, unlike rand() which only gives 15 bits per call.
+    Returns: The next 64 bit number in the sequence.
+*/
+static constexpr U64 Rand64(U64 *state) {
+    U64 z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
 
-U64 PieceKeys[13][120];
-U64 SideKey;
-U64 CastleKeys[16];
+//Bundles every hash key so that they are generated from a single, ordered sequence of random numbers
+typedef struct {
+    array<array<U64, BRD_SQ_NUM>, 13> pieceKeys;
+    U64 sideKey;
+    array<U64, 16> castleKeys;
+} S_HASHKEYS;
 
-int FilesBrd[BRD_SQ_NUM];
-int RanksBrd[BRD_SQ_NUM];
+/*
+    Name:    InitFilesBrd
+    Purpose: Build the filesbrd array. Squares that are not on the playing board hold OFFBOARD.
+*/
+static constexpr array<int, BRD_SQ_NUM> InitFilesBrd() {
+    array<int, BRD_SQ_NUM> files = {};
+    int i = 0;
+
+    for (i = 0; i < BRD_SQ_NUM; ++i)
+        files[i] = OFFBOARD;
+
+    for (int rank = RANK_1; rank <= RANK_8; ++rank)
+        for (int file = FILE_A; file <= FILE_H; ++file)
+            files[FR2SQ(file,rank)] = file;
+
+    return files;
+}
 
 /*
-    Name:    InitFilesRanksBrd
-    Purpose: Setup the filesbrd and ranksbrd arrays with value OFFBOARD
+    Name:    InitRanksBrd
+    Purpose: Build the ranksbrd array. Squares that are not on the playing board hold OFFBOARD.
 */
-void InitFilesRanksBrd() {
+static constexpr array<int, BRD_SQ_NUM> InitRanksBrd() {
+    array<int, BRD_SQ_NUM> ranks = {};
     int i = 0;
-    int file  = FILE_A;
-    int rank  = RANK_1;
-    int sq    = A1;
-    int sq64  = 0;
-
-    for (i = 0; i < BRD_SQ_NUM; ++i) {
-        FilesBrd[i] = OFFBOARD;
-        RanksBrd[i] = OFFBOARD;
-    }
 
-    for (rank = RANK_1; rank <= RANK_8; ++rank) {
-        for (file = FILE_A; file <= FILE_H; ++file) {
-            sq = FR2SQ(file,rank);
-            FilesBrd[sq] = file;
-            RanksBrd[sq] = rank;
-        }
-    }
+    for (i = 0; i < BRD_SQ_NUM; ++i)
+        ranks[i] = OFFBOARD;
+
+    for (int rank = RANK_1; rank <= RANK_8; ++rank)
+        for (int file = FILE_A; file <= FILE_H; ++file)
+            ranks[FR2SQ(file,rank)] = rank;
+
+    return ranks;
 }
 
 /*
     Name:    InitHashKeys
-    Purpose: Setup the piecekeys and castlekeys arrays with random 64 bit integers
+    Purpose: Build the piecekeys, sidekey and castlekeys with random 64 bit integers from a fixed seed
 */
-void InitHashKeys() {
+static constexpr S_HASHKEYS InitHashKeys() {
+    S_HASHKEYS keys = {};
+    U64 state = ZOBRIST_SEED;
     int i=0, i2=0;
-    for (i = 0; i < 13; ++i) 
-        for (i2 = 0; i2 < 120; ++i2)
-            PieceKeys[i][i2] = RAND_64;
 
-    SideKey = RAND_64;
+    for (i = 0; i < 13; ++i)
+        for (i2 = 0; i2 < BRD_SQ_NUM; ++i2)
+            keys.pieceKeys[i][i2] = Rand64(&state);
+
+    keys.sideKey = Rand64(&state);
     for (i = 0; i < 16; ++i)
-        CastleKeys[i] = RAND_64;
+        keys.castleKeys[i] = Rand64(&state);
+
+    return keys;
 }
 
 /*
-    Name:    InitBitMasks
-    Purpose: Setup the setmask and clearmask arrays
+    Name:    InitSetMask
+    Purpose: Build the setmask array. Each entry has a single bit set for its square.
 */
-void InitBitMasks() {
-    int i = 0;
-    for (i = 0; i < PLAY_SQ_NUM; ++i) {
-        SetMask[i] = 0ULL;
-        ClearMask[i] = 0ULL;
-    }
+static constexpr array<U64, PLAY_SQ_NUM> InitSetMask() {
+    array<U64, PLAY_SQ_NUM> mask = {};
+    for (int i = 0; i < PLAY_SQ_NUM; ++i)
+        mask[i] = (1ULL << i);
+    return mask;
+}
 
-    for (i = 0; i < PLAY_SQ_NUM; ++i) {
-        SetMask[i] |= (1ULL << i);
-        ClearMask[i] = ~SetMask[i];  //bitwise compliment 
-    }
+/*
+    Name:    InitClearMask
+    Purpose: Build the clearmask array. Each entry is the bitwise compliment of the setmask entry.
+*/
+static constexpr array<U64, PLAY_SQ_NUM> InitClearMask() {
+    array<U64, PLAY_SQ_NUM> mask = {};
+    for (int i = 0; i < PLAY_SQ_NUM; ++i)
+        mask[i] = ~(1ULL << i);
+    return mask;
 }
 
 /*
     Name:    InitSq120To64
-    Purpose: Convert the indexes of a 120 int board to a traditional 64 int board
+    Purpose: Convert the indexes of a 120 int board to a traditional 64 int board. Offboard squares hold 65.
 */
-void InitSq120To64() {
+static constexpr array<int, BRD_SQ_NUM> InitSq120To64() {
+    array<int, BRD_SQ_NUM> sq120To64 = {};
     int i = 0;
-    int file  = FILE_A;
-    int rank  = RANK_1;
-    int sq    = A1;
-    int sq64  = 0;
+    int sq64 = 0;
+
+    for (i = 0; i < BRD_SQ_NUM; ++i)
+        sq120To64[i] = 65;
+
+    for (int rank = RANK_1; rank <= RANK_8; ++rank)
+        for (int file = FILE_A; file <= FILE_H; ++file)
+            sq120To64[FR2SQ(file,rank)] = sq64++;
+
+    return sq120To64;
+}
+
+/*
+    Name:    InitSq64To120
+    Purpose: Convert the indexes of a traditional 64 int board to a 120 int board
+*/
+static constexpr array<int, PLAY_SQ_NUM> InitSq64To120() {
+    array<int, PLAY_SQ_NUM> sq64To120 = {};
+    int sq64 = 0;
+
+    for (int rank = RANK_1; rank <= RANK_8; ++rank)
+        for (int file = FILE_A; file <= FILE_H; ++file)
+            sq64To120[sq64++] = FR2SQ(file,rank);
 
-    for (i = 0; i < BRD_SQ_NUM; ++i) {
-        Sq120ToSq64[i] = 65;
+    return sq64To120;
+}
+
+/*
+    Name:    InitStepAttacks
+    Vars:    const int dir[8][2] - File and rank steps a piece can make. Ex. {1, 2} is one file right and two ranks up.
+             int numDir          - The number of steps in dir.
+    Purpose: Build an attack table for a piece that moves a single step in each direction (knights and kings).
+*/
+static constexpr array<U64, PLAY_SQ_NUM> InitStepAttacks(const int dir[8][2], int numDir) {
+    array<U64, PLAY_SQ_NUM> attacks = {};
+
+    for (int sq64 = 0; sq64 < PLAY_SQ_NUM; ++sq64) {
+        for (int i = 0; i < numDir; ++i) {
+            int file = sq64 % 8 + dir[i][0];
+            int rank = sq64 / 8 + dir[i][1];
+            if (file >= FILE_A && file <= FILE_H && rank >= RANK_1 && rank <= RANK_8)
+                attacks[sq64] |= (1ULL << (rank * 8 + file));
+        }
     }
+    return attacks;
+}
+
+constexpr int KnightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+constexpr int KingSteps[8][2]   = {{0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}};
+constexpr int WhitePawnSteps[2][2] = {{-1, 1}, {1, 1}};
+constexpr int BlackPawnSteps[2][2] = {{-1, -1}, {1, -1}};
 
-    for (i = 0; i < 64; ++i) {
-        Sq64ToSq120[i] = 120;
+/*
+    Name:    InitRays
+    Purpose: Build a ray for every square in each of the 8 directions, ordered as the DIR_ enum. The ray does not include the square itself.
+*/
+static constexpr array<array<U64, PLAY_SQ_NUM>, 8> InitRays() {
+    array<array<U64, PLAY_SQ_NUM>, 8> rays = {};
+
+    for (int dir = 0; dir < 8; ++dir) {
+        for (int sq64 = 0; sq64 < PLAY_SQ_NUM; ++sq64) {
+            int file = sq64 % 8 + KingSteps[dir][0];
+            int rank = sq64 / 8 + KingSteps[dir][1];
+            while (file >= FILE_A && file <= FILE_H && rank >= RANK_1 && rank <= RANK_8) {
+                rays[dir][sq64] |= (1ULL << (rank * 8 + file));
+                file += KingSteps[dir][0];
+                rank += KingSteps[dir][1];
+            }
+        }
+    }
+    return rays;
+}
+
+/*
+    Name:    InitBetween
+    Purpose: Build the squares strictly between every pair of squares that share a rank, file or diagonal. Unaligned pairs hold 0.
+*/
+static constexpr array<array<U64, PLAY_SQ_NUM>, PLAY_SQ_NUM> InitBetween(const array<array<U64, PLAY_SQ_NUM>, 8> &rays) {
+    array<array<U64, PLAY_SQ_NUM>, PLAY_SQ_NUM> between = {};
+
+    for (int sq1 = 0; sq1 < PLAY_SQ_NUM; ++sq1)
+        for (int dir = 0; dir < 8; ++dir)
+            for (int sq2 = 0; sq2 < PLAY_SQ_NUM; ++sq2)
+                if (rays[dir][sq1] & (1ULL << sq2))
+                    between[sq1][sq2] = rays[dir][sq1] & rays[(dir + 4) % 8][sq2];  //dir + 4 is the opposite direction
+
+    return between;
+}
+
+/*
+    Name:    InitLine
+    Purpose: Build the full edge to edge line through every pair of aligned squares. Unaligned pairs hold 0.
+*/
+static constexpr array<array<U64, PLAY_SQ_NUM>, PLAY_SQ_NUM> InitLine(const array<array<U64, PLAY_SQ_NUM>, 8> &rays) {
+    array<array<U64, PLAY_SQ_NUM>, PLAY_SQ_NUM> line = {};
+
+    for (int sq1 = 0; sq1 < PLAY_SQ_NUM; ++sq1)
+        for (int dir = 0; dir < 8; ++dir)
+            for (int sq2 = 0; sq2 < PLAY_SQ_NUM; ++sq2)
+                if (rays[dir][sq1] & (1ULL << sq2))
+                    line[sq1][sq2] = rays[dir][sq1] | rays[(dir + 4) % 8][sq1] | (1ULL << sq1);
+
+    return line;
+}
+
+/*
+    Name:    InitFileBBMask
+    Purpose: Build a bitboard of every square on each file.
+*/
+static constexpr array<U64, 8> InitFileBBMask() {
+    array<U64, 8> mask = {};
+    for (int file = FILE_A; file <= FILE_H; ++file)
+        mask[file] = 0x0101010101010101ULL << file;
+    return mask;
+}
+
+/*
+    Name:    InitIsolatedMask
+    Purpose: Build, for each square, the files either side of it. A pawn with no friendly pawns on them is isolated.
+*/
+static constexpr array<U64, PLAY_SQ_NUM> InitIsolatedMask(const array<U64, 8> &files) {
+    array<U64, PLAY_SQ_NUM> mask = {};
+    for (int sq64 = 0; sq64 < PLAY_SQ_NUM; ++sq64) {
+        int file = sq64 % 8;
+        if (file > FILE_A) mask[sq64] |= files[file - 1];
+        if (file < FILE_H) mask[sq64] |= files[file + 1];
     }
+    return mask;
+}
 
-    for (rank = RANK_1; rank <= RANK_8; ++rank) {
-        for (file = FILE_A; file <= FILE_H; ++file) {
-            sq = FR2SQ(file,rank);
-            Sq64ToSq120[sq64] = sq;
-            Sq120ToSq64[sq] = sq64;
-            sq64++;
+/*
+    Name:    InitPassedMask
+    Purpose: Build, for each colour and square, the squares ahead of a pawn on its own and the adjacent files.
+             A pawn is passed if no enemy pawn stands on any of them.
+*/
+static constexpr array<array<U64, PLAY_SQ_NUM>, 2> InitPassedMask(const array<array<U64, PLAY_SQ_NUM>, 8> &rays) {
+    array<array<U64, PLAY_SQ_NUM>, 2> mask = {};
+    for (int sq64 = 0; sq64 < PLAY_SQ_NUM; ++sq64) {
+        int file = sq64 % 8;
+        mask[WHITE][sq64] = rays[DIR_N][sq64];
+        mask[BLACK][sq64] = rays[DIR_S][sq64];
+        if (file > FILE_A) {
+            mask[WHITE][sq64] |= rays[DIR_N][sq64 - 1];
+            mask[BLACK][sq64] |= rays[DIR_S][sq64 - 1];
+        }
+        if (file < FILE_H) {
+            mask[WHITE][sq64] |= rays[DIR_N][sq64 + 1];
+            mask[BLACK][sq64] |= rays[DIR_S][sq64 + 1];
         }
     }
+    return mask;
+}
+
+/*
+    Name:    InitMirror64
+    Purpose: Build the table that flips a square vertically, ex. a1 <-> a8. Lets black read white's piece-square tables.
+*/
+static constexpr array<int, PLAY_SQ_NUM> InitMirror64() {
+    array<int, PLAY_SQ_NUM> mirror = {};
+    for (int sq64 = 0; sq64 < PLAY_SQ_NUM; ++sq64)
+        mirror[sq64] = sq64 ^ 56;
+    return mirror;
 }
 
+static constexpr S_HASHKEYS HashKeys = InitHashKeys();
+
+constexpr array<int, BRD_SQ_NUM> Sq120ToSq64 = InitSq120To64(); //120 int bitboard
+constexpr array<int, PLAY_SQ_NUM> Sq64ToSq120 = InitSq64To120(); //64 int bitboard
+
+constexpr array<U64, PLAY_SQ_NUM> SetMask   = InitSetMask();
+constexpr array<U64, PLAY_SQ_NUM> ClearMask = InitClearMask();
+
+constexpr array<array<U64, BRD_SQ_NUM>, 13> PieceKeys = HashKeys.pieceKeys;
+constexpr U64 SideKey = HashKeys.sideKey;
+constexpr array<U64, 16> CastleKeys = HashKeys.castleKeys;
+
+constexpr array<int, BRD_SQ_NUM> FilesBrd = InitFilesBrd();
+constexpr array<int, BRD_SQ_NUM> RanksBrd = InitRanksBrd();
+
+constexpr array<U64, PLAY_SQ_NUM> KnightAttacks = InitStepAttacks(KnightSteps, 8);
+constexpr array<U64, PLAY_SQ_NUM> KingAttacks   = InitStepAttacks(KingSteps, 8);
+constexpr array<array<U64, PLAY_SQ_NUM>, 2> PawnAttacks = {InitStepAttacks(WhitePawnSteps, 2), InitStepAttacks(BlackPawnSteps, 2)};
+constexpr array<array<U64, PLAY_SQ_NUM>, 8> Rays = InitRays();
+constexpr array<array<U64, PLAY_SQ_NUM>, PLAY_SQ_NUM> Between = InitBetween(Rays);
+constexpr array<array<U64, PLAY_SQ_NUM>, PLAY_SQ_NUM> Line = InitLine(Rays);
+
+constexpr array<U64, 8> FileBBMask = InitFileBBMask();
+constexpr array<U64, PLAY_SQ_NUM> IsolatedMask = InitIsolatedMask(FileBBMask);
+constexpr array<array<U64, PLAY_SQ_NUM>, 2> PassedMask = InitPassedMask(Rays);
+constexpr array<int, PLAY_SQ_NUM> Mirror64 = InitMirror64();
+
+//Sanity checks on the generated tables. These fail the build instead of failing at runtime.
+static_assert(Sq120ToSq64[A1] == 0 && Sq120ToSq64[H8] == 63, "Sq120ToSq64 corner squares are wrong");
+static_assert(Sq64ToSq120[0] == A1 && Sq64ToSq120[63] == H8, "Sq64ToSq120 corner squares are wrong");
+static_assert(FilesBrd[E4] == FILE_E && RanksBrd[E4] == RANK_4, "FilesBrd/RanksBrd are wrong");
+static_assert(FilesBrd[0] == OFFBOARD && RanksBrd[NO_SQ] == OFFBOARD, "Offboard squares must hold OFFBOARD");
+static_assert((SetMask[63] & ClearMask[63]) == 0ULL, "SetMask and ClearMask must be complements");
+static_assert(KnightAttacks[0] == ((1ULL << 10) | (1ULL << 17)), "A knight on a1 attacks b3 and c2");
+static_assert(PawnAttacks[WHITE][8] == (1ULL << 17) && PawnAttacks[BLACK][8] == (1ULL << 1), "A pawn on a2 attacks b3 (white) or b1 (black)");
+static_assert(Rays[DIR_N][0] == 0x0101010101010100ULL && Rays[DIR_NE][0] == 0x8040201008040200ULL, "Rays from a1 are wrong");
+static_assert(Between[0][63] == 0x0040201008040200ULL && Between[0][10] == 0ULL, "Between a1 and h8 is b2 to g7, a1 and c2 are not aligned");
+static_assert(Line[9][18] == 0x8040201008040201ULL, "The line through b2 and c3 is the a1-h8 diagonal");
+static_assert(PassedMask[WHITE][SQ64(E4)] == 0x3838383800000000ULL, "A white pawn on e4 needs d5-f8 free of black pawns");
+static_assert(Mirror64[SQ64(A1)] == SQ64(A8) && Mirror64[SQ64(E2)] == SQ64(E7), "Mirror64 is wrong");
+
 /*
     Name:    AllInit
-    Purpose: Initialize all functions
+    Purpose: Initialize anything that must be built at runtime. The lookup tables and hash keys are now built at compile time.
+             The KPK bitbase is built here because its retrograde analysis is too much work for the compiler.
 */
 void AllInit() {
-    InitSq120To64();
-    InitBitMasks();
-    InitHashKeys();
-    InitFilesRanksBrd();
-}
\ No newline at end of file
+    InitEndgames();
+}
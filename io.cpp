@@ -4,20 +4,41 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cctype>
 #include <iostream>
 
 using namespace std;
 
 
+/*
+    Name:    LegalMove
+    Vars:    S_BOARD *pos - A pointer to the board. It is left as it was.
+             int from     - The square the piece moves from.
+             int to       - The square it moves to.
+             int promoted - The promotion piece as the side to move's piece, or EMPTY.
+    Purpose: The shared path of ParseMove and ParseSan. The move is built straight from its squares by DecodeMove and
+             tried with MakeMove, so only the one move is looked at instead of every move in the position.
+    Returns: The move, or NOMOVE if it isn't legal.
+*/
+static int LegalMove(S_BOARD *pos, const int from, const int to, const int promoted) {
+    int move = DecodeMove(pos, from, to, promoted);
+    if (move == NOMOVE || !MakeMove(pos, move))
+        return NOMOVE;
+    TakeMove(pos);
+    return move;
+}
+
+
 /*
     Name:    ParseMove
-    Vars:    char *ptrChar - A pointer to the last entered move in the form a1b2.
-             S_BOARD *pos  - A pointer to the board.
-    Purpose: Given a move from one square to another, find that move in the list of possible moves.
+    Vars:    const char *ptrChar - A pointer to the last entered move in the form a1b2, with a promotion piece (a7a8q) if it promotes.
+             S_BOARD *pos        - A pointer to the board.
+    Purpose: Given a move from one square to another, build that move for the position and check it can be played.
     Returns: The move as an integer to be used by MakeMove. 
              NOMOVE if the move cannot happen.
 */
-int ParseMove(char *ptrChar, S_BOARD *pos) {
+int ParseMove(const char *ptrChar, S_BOARD *pos) {
 
     //Move must be in the form a1b2 -- lowercase letters from a-h and numbers from 1-8
     if (ptrChar[0] > 'h' || ptrChar[0] < 'a' ||
@@ -31,31 +52,235 @@ int ParseMove(char *ptrChar, S_BOARD *pos) {
 
     ASSERT(SqOnBoard(from) && SqOnBoard(to));
 
-    //Store every move from the position so we can loop through and find the one with the same 'from' and 'to' square
+    //The promotion letter only counts for a pawn reaching the last rank, anything after other moves is ignored
+    int promoted = EMPTY;
+    if (PiecePawn[pos->pieces[from]] && (RanksBrd[to] == RANK_8 || RanksBrd[to] == RANK_1)) {
+        int offset = (pos->side == WHITE)? 0 : bP - wP;
+        switch (ptrChar[4]) {
+            case 'q': promoted = wQ + offset; break;
+            case 'r': promoted = wR + offset; break;
+            case 'b': promoted = wB + offset; break;
+            case 'n': promoted = wN + offset; break;
+            default:  return NOMOVE;
+        }
+    }
+
+    int move = LegalMove(pos, from, to, promoted);
+    ASSERT(move == NOMOVE || MoveExists(pos, move));
+    return move;
+}
+
+
+/*
+    Name:    ParseSan
+    Vars:    const char *san - A move in standard algebraic notation, as used by PGN. Ex. Nbd7, exd5, e8=Q+, O-O-O
+             S_BOARD *pos    - A pointer to the board.
+    Purpose: Find the move a SAN string describes. The piece, destination, promotion and any disambiguating file or rank
+             must match exactly one legal move. Check, mate and annotation marks (+#!?) are ignored.
+             The from squares are found backwards from the destination: the squares a piece of that kind attacks from
+             there that hold one, or the few squares a pawn can come from. Each goes through LegalMove, so the moves of
+             the position are never generated.
+    Returns: The move as an integer to be used by MakeMove.
+             NOMOVE if no legal move, or more than one, matches.
+*/
+int ParseSan(const char *san, S_BOARD *pos) {
+    char str[16];
+    int len = 0;
+
+    //Copy the move without its check and annotation marks
+    for (int i = 0; san[i] != '\0' && !isspace((unsigned char)san[i]); ++i) {
+        if (strchr("+#!?", san[i]) != NULL)
+            continue;
+        if (len == (int)sizeof(str) - 1)
+            return NOMOVE;
+        str[len++] = san[i];
+    }
+    str[len] = '\0';
+    if (len < 2)
+        return NOMOVE;
+
+    int offset = (pos->side == WHITE)? 0 : bP - wP;  //Turns a white piece into the side to move's piece
+    int kingFrom = (pos->side == WHITE)? E1 : E8;
+
+    if (strcmp(str, "O-O") == 0 || strcmp(str, "0-0") == 0)
+        return (pos->pieces[kingFrom] == wK + offset)? LegalMove(pos, kingFrom, kingFrom + 2, EMPTY) : NOMOVE;
+    if (strcmp(str, "O-O-O") == 0 || strcmp(str, "0-0-0") == 0)
+        return (pos->pieces[kingFrom] == wK + offset)? LegalMove(pos, kingFrom, kingFrom - 2, EMPTY) : NOMOVE;
+
+    int piece = wP;         //The moving piece as a white piece
+    int promoted = EMPTY;   //The promotion piece as a white piece
+    int fromFile = FILE_NONE;
+    int fromRank = RANK_NONE;
+    const char *pieces = "PNBRQK";  //Indexed from wP
+    int start = 0;
+
+    if (strchr(pieces, str[0]) != NULL) {
+        piece = wP + (int)(strchr(pieces, str[0]) - pieces);
+        start = 1;
+    }
+
+    //A promotion is the last character, with or without an '='
+    if (strchr("NBRQ", str[len - 1]) != NULL) {
+        promoted = wP + (int)(strchr(pieces, str[len - 1]) - pieces);
+        len--;
+        if (len > 0 && str[len - 1] == '=')
+            len--;
+    }
+
+    //The destination is the last square
+    if (len - start < 2 || str[len - 2] < 'a' || str[len - 2] > 'h' || str[len - 1] < '1' || str[len - 1] > '8')
+        return NOMOVE;
+    int to = FR2SQ(str[len - 2] - 'a', str[len - 1] - '1');
+
+    //Whatever is left between the piece and the destination disambiguates the from square
+    for (int i = start; i < len - 2; ++i) {
+        if (str[i] >= 'a' && str[i] <= 'h')      fromFile = str[i] - 'a';
+        else if (str[i] >= '1' && str[i] <= '8') fromRank = str[i] - '1';
+        else if (str[i] != 'x' && str[i] != ':') return NOMOVE;
+    }
+
+    piece += offset;
+    if (promoted != EMPTY)
+        promoted += offset;
+
+    //The squares the piece could have come from. Pieces move the same way both ways; a pawn comes from behind.
+    U64 candidates = 0ULL;
+    int to64 = SQ64(to);
+    if (PiecePawn[piece]) {
+        int dir = (pos->side == WHITE)? 10 : -10;
+        int behind[4] = {to - dir, to - 2 * dir, to - dir - 1, to - dir + 1};
+        for (int sq : behind)
+            if (sq >= 0 && sq < BRD_SQ_NUM && FilesBrd[sq] != OFFBOARD)
+                candidates |= SetMask[SQ64(sq)];
+    } else if (IsKn(piece))
+        candidates = KnightAttacks[to64];
+    else if (IsKi(piece))
+        candidates = KingAttacks[to64];
+    else {
+        if (IsBQ(piece))
+            candidates |= BishopAttacks(to64, pos->occupied[BOTH]);
+        if (IsRQ(piece))
+            candidates |= RookAttacks(to64, pos->occupied[BOTH]);
+    }
+    candidates &= pos->pceBB[piece];
+
+    int found = NOMOVE;
+    while (candidates) {
+        int from = SQ120(POP(&candidates));
+        if (fromFile != FILE_NONE && FilesBrd[from] != fromFile)
+            continue;
+        if (fromRank != RANK_NONE && RanksBrd[from] != fromRank)
+            continue;
+
+        int move = LegalMove(pos, from, to, promoted);
+        if (move == NOMOVE)
+            continue;
+        if (found != NOMOVE)  //Ambiguous
+            return NOMOVE;
+        found = move;
+    }
+
+    return found;
+}
+
+
+/*
+    Name:    MoveToSan
+    Vars:    int move     - A legal move in the position.
+             S_BOARD *pos - A pointer to the board. It is left as it was.
+             char *san    - Filled with the move in standard algebraic notation. Needs room for 8 characters and the '\0'.
+    Purpose: Write a move the way PGN records it. Generates the moves of the position for MoveToSanList; a caller that
+             has them already should call that instead.
+    Returns: san.
+*/
+char *MoveToSan(const int move, S_BOARD *pos, char *san) {
     S_MOVELIST list[1];
     GenerateAllMoves(pos, list);
+    return MoveToSanList(move, pos, list, san);
+}
 
-    int MoveNum = 0;
-    int Move    = 0;
-    int PromPce = EMPTY;
-
-    //Loop through moves to find the one where the 'from' and 'to' squares match. Also, match the promotion piece if there was one.
-    for (MoveNum = 0; MoveNum < list->count; ++MoveNum) {
-        Move = list->moves[MoveNum].move;
-        if (FROMSQ(Move) == from && TOSQ(Move) == to) {
-            PromPce = PROMOTED(Move);
-            if (PromPce != EMPTY) {
-                if      (IsRQ(PromPce) && !IsBQ(PromPce) && ptrChar[4] == 'r') return Move;
-                else if (IsBQ(PromPce) && !IsRQ(PromPce) && ptrChar[4] == 'b') return Move;
-                else if (IsBQ(PromPce) &&  IsRQ(PromPce) && ptrChar[4] == 'q') return Move;
-                else if (IsKn(PromPce) && ptrChar[4] == 'n')                   return Move;
-                continue;
+
+/*
+    Name:    MoveToSanList
+    Vars:    int move               - A legal move in the position.
+             S_BOARD *pos           - A pointer to the board. It is left as it was.
+             const S_MOVELIST *list - The moves GenerateAllMoves gives for the position.
+             char *san              - Filled with the move in standard algebraic notation. Needs room for 8 characters and the '\0'.
+    Purpose: Write a move the way PGN records it: piece letter, the file and/or rank of the from square when another
+             piece of the same kind could also move there, 'x' for captures, '=' and the piece for promotions, and '+' or '#'.
+             The other pieces are looked for in the given list, so a list the caller has is not generated again.
+             Only the caller's buffers are written, so any number of threads can format moves at once.
+    Returns: san.
+*/
+char *MoveToSanList(const int move, S_BOARD *pos, const S_MOVELIST *list, char *san) {
+    int from = FROMSQ(move);
+    int to = TOSQ(move);
+    int piece = pos->pieces[from];
+    int len = 0;
+
+    if (move & MFLAGCA) {
+        const char *castle = (FilesBrd[to] == FILE_G)? "O-O" : "O-O-O";
+        len = (int)strlen(castle);
+        memcpy(san, castle, len);
+    } else {
+        int capture = CAPTURED(move) || (move & MFLAGEP);
+
+        if (PiecePawn[piece]) {
+            if (capture)
+                san[len++] = 'a' + FilesBrd[from];
+        } else {
+            san[len++] = toupper(PceChar[piece]);
+
+            //Look for other pieces of the same kind that can legally reach the same square
+            int sameFile = FALSE, sameRank = FALSE, ambiguous = FALSE;
+            for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+                int other = list->moves[moveNum].move;
+                if (other == move || TOSQ(other) != to || pos->pieces[FROMSQ(other)] != piece)
+                    continue;
+                if (!MakeMove(pos, other))
+                    continue;
+                TakeMove(pos);
+                ambiguous = TRUE;
+                sameFile |= (FilesBrd[FROMSQ(other)] == FilesBrd[from]);
+                sameRank |= (RanksBrd[FROMSQ(other)] == RanksBrd[from]);
             }
-            return Move;
+            //The file is preferred, then the rank, and both only when neither tells the pieces apart
+            if (ambiguous && (!sameFile || sameRank))
+                san[len++] = 'a' + FilesBrd[from];
+            if (ambiguous && sameFile)
+                san[len++] = '1' + RanksBrd[from];
+        }
+
+        if (capture)
+            san[len++] = 'x';
+        san[len++] = 'a' + FilesBrd[to];
+        san[len++] = '1' + RanksBrd[to];
+
+        if (PROMOTED(move) != EMPTY) {
+            san[len++] = '=';
+            san[len++] = toupper(PceChar[PROMOTED(move)]);
         }
     }
 
-    return NOMOVE;  //If the function reaches the end without finding a matching move, the move entered cannot be made.
+    //Check or mate
+    if (MakeMove(pos, move)) {
+        if (InCheck(pos)) {
+            int mate = TRUE;
+            S_MOVELIST replies[1];
+            GenerateAllMoves(pos, replies);
+            for (int moveNum = 0; moveNum < replies->count && mate; ++moveNum) {
+                if (MakeMove(pos, replies->moves[moveNum].move)) {
+                    TakeMove(pos);
+                    mate = FALSE;
+                }
+            }
+            san[len++] = (mate)? '#' : '+';
+        }
+        TakeMove(pos);
+    }
+
+    san[len] = '\0';
+    return san;
 }
 
 
@@ -81,54 +306,261 @@ void PrintMoveList(const S_MOVELIST *list) {
 
 
 /*
-    Name:    PrMove
-    Vars:    int move - The move to be printed
-    Purpose: Given a move, print it using algebraic notation.
-    Returns: A char array of the square from, square to, and promotion piece if it exists.
+    Name:    MoveToUci
+    Vars:    int move  - A move.
+             char *buf - Filled with the move in long algebraic notation, as UCI writes it. Needs room for 6 characters.
+    Purpose: Write a move as its from and to squares and the promotion piece, if any. Ex. e2e4, a7a8q. NOMOVE is
+             written as 0000, the UCI null move. Only the caller's buffer is written, so it is safe from any thread.
+    Returns: buf.
 */
-char *PrMove(const int move) {
-    static char MvStr[6];   //a7a8q Square from, square to, promotion piece
+char *MoveToUci(const int move, char *buf) {
+    if (move == NOMOVE) {
+        memcpy(buf, "0000", 5);
+        return buf;
+    }
 
-    int ff = FilesBrd[FROMSQ(move)]; //File from
-    int rf = RanksBrd[FROMSQ(move)]; //Rank from
-    int ft = FilesBrd[TOSQ(move)];   //File to
-    int rt = RanksBrd[TOSQ(move)];   //Rank to
+    int from = FROMSQ(move), to = TOSQ(move);
     int promoted = PROMOTED(move);   //4 bits representing promotion piece, 0000 if no promotion
 
-    //If there was a promotion, determine what new piece is on the board
+    buf[0] = 'a' + FilesBrd[from];
+    buf[1] = '1' + RanksBrd[from];
+    buf[2] = 'a' + FilesBrd[to];
+    buf[3] = '1' + RanksBrd[to];
     if (promoted) {
-        char promChar = 'q';    //Promotion piece is queen by default since that is most common
-        if (IsRQ(promoted) && !IsBQ(promoted))  //If piece is a rook/queen but not a bishop/queen it must be a rook
-            promChar = 'r';
+        buf[4] = IsKn(promoted)? 'n' : IsRQ(promoted)? (IsBQ(promoted)? 'q' : 'r') : 'b';
+        buf[5] = '\0';
+    } else {
+        buf[4] = '\0';
+    }
+    return buf;
+}
+
+
+/*
+    Name:    SqToStr
+    Vars:    int sq    - A square.
+             char *buf - Filled with the name of the square. Needs room for 3 characters.
+    Returns: buf.
+*/
+char *SqToStr(const int sq, char *buf) {
+    buf[0] = 'a' + FilesBrd[sq];
+    buf[1] = '1' + RanksBrd[sq];
+    buf[2] = '\0';
+    return buf;
+}
+
+
+/*
+    Name:    BoardToFen
+    Vars:    const S_BOARD *pos - Pointer to a position.
+             char *fen          - Filled with the FEN of the position. Needs room for MAXFENLEN characters.
+    Purpose: Write a position as a FEN, the inverse of ParseFen. The fullmove number counts on from the one the board
+             was set up with. Only the caller's buffer is written, so it is safe from any thread.
+    Returns: fen.
+*/
+char *BoardToFen(const S_BOARD *pos, char *fen) {
+    int len = 0;
+
+    for (int rank = RANK_8; rank >= RANK_1; --rank) {
+        int empty = 0;
+        for (int file = FILE_A; file <= FILE_H; ++file) {
+            int piece = pos->pieces[FR2SQ(file, rank)];
+            if (piece == EMPTY) {
+                empty++;
+                continue;
+            }
+            if (empty) {
+                fen[len++] = '0' + empty;
+                empty = 0;
+            }
+            fen[len++] = PceChar[piece];
+        }
+        if (empty)
+            fen[len++] = '0' + empty;
+        fen[len++] = (rank == RANK_1)? ' ' : '/';
+    }
 
-        else if (!IsRQ(promoted) && IsBQ(promoted))
-            promChar = 'b';
+    fen[len++] = (pos->side == WHITE)? 'w' : 'b';
+    fen[len++] = ' ';
 
-        else if (IsKn(promoted)) 
-            promChar = 'n';
-        
-        sprintf(MvStr, "%c%c%c%c%c", ('a'+ff), ('1'+rf), ('a'+ft), ('1'+rt), promChar);
+    if (pos->castlePerm == 0)
+        fen[len++] = '-';
+    if (pos->castlePerm & WKCA) fen[len++] = 'K';
+    if (pos->castlePerm & WQCA) fen[len++] = 'Q';
+    if (pos->castlePerm & BKCA) fen[len++] = 'k';
+    if (pos->castlePerm & BQCA) fen[len++] = 'q';
+    fen[len++] = ' ';
+
+    if (pos->enPas == NO_SQ) {
+        fen[len++] = '-';
+    } else {
+        SqToStr(pos->enPas, fen + len);
+        len += 2;
     }
-    else
-        sprintf(MvStr, "%c%c%c%c", ('a'+ff), ('1'+rf), ('a'+ft), ('1'+rt));
 
-    return MvStr;
+    //The side the board was set up with is the side to move now if an even number of moves have been made since
+    int setupSide = (pos->hisPly % 2 == 0)? pos->side : pos->side ^ 1;
+    int moveNumber = pos->moveNumber + (pos->hisPly + ((setupSide == BLACK)? 1 : 0)) / 2;
+    snprintf(fen + len, MAXFENLEN - len, " %d %d", pos->fiftyMove, moveNumber);
+    return fen;
+}
+
+
+/*
+    Name:    PrMove
+    Vars:    int move - The move to be printed
+    Purpose: Given a move, print it using algebraic notation. A convenience for printing: the buffer is the calling
+             thread's own and is reused by the next call, so code that keeps the text should use MoveToUci.
+    Returns: A char array of the square from, square to, and promotion piece if it exists.
+*/
+char *PrMove(const int move) {
+    static thread_local char MvStr[6];   //a7a8q Square from, square to, promotion piece. One buffer per thread so analysis workers can print moves.
+    return MoveToUci(move, MvStr);
 }
 
 
 /*
     Name:    PrSq
     Vars:    int sq - The square to be printed.
-    Purpose: Stores the file & rank of a square as a c_string for printing.
+    Purpose: Stores the file & rank of a square as a c_string for printing. Like PrMove, the buffer is reused by the
+             next call on the same thread; SqToStr writes into the caller's.
     Returns: A char array storing the name of the file & rank.
 */
 char *PrSq(const int sq) {
-    static char SqStr[3];   //Array is static because it is used outside this function. 'Static' prevents it from being deleted at function end.
+    static thread_local char SqStr[3];
+    return SqToStr(sq, SqStr);
+}
 
-    int file = FilesBrd[sq]; //Get the file and rank from the given square
-    int rank = RanksBrd[sq];
 
-    sprintf(SqStr, "%c%c", ('a'+file), ('1'+rank)); //Convert file & rank to a c_string and store it in SqStr
+/*
+    Name:    VerifyPosition
+    Vars:    S_BOARD *pos - The position to check. It is left as it was.
+             long *checks - Counts the checks made.
+    Purpose: Check the position's FEN and every way of naming a move round trip:
+             - BoardToFen, parsed again, gives the same position and the same FEN.
+             - DecodeMove builds every generated move from its squares and promotion piece, and any other combination it
+               accepts is one MakeMove rejects.
+             - Every legal move comes back from ParseMove of its MoveToUci text and from ParseSan of its MoveToSan text,
+               and ParseMove refuses the pseudo-legal moves that leave the king in check.
+    Returns: The number of mismatches, each printed.
+*/
+static int VerifyPosition(S_BOARD *pos, long *checks) {
+    int errors = 0;
+    char fen[MAXFENLEN], again[MAXFENLEN];
 
-    return SqStr;
-}
\ No newline at end of file
+    S_BOARD copy[1];
+    BoardToFen(pos, fen);
+    (*checks)++;
+    if (ParseFen(fen, copy) != 0 || strcmp(BoardToFen(copy, again), fen) != 0 || copy->posKey != pos->posKey) {
+        cout << "FEN " << fen << " does not round trip" << endl;
+        errors++;
+    }
+
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+
+    //Every from, to and promotion piece against the generated list
+    for (int from64 = 0; from64 < 64; ++from64) {
+        for (int to64 = 0; to64 < 64; ++to64) {
+            int from = SQ120(from64), to = SQ120(to64);
+            for (int promoted = EMPTY; promoted <= bK; ++promoted) {
+                int generated = NOMOVE;
+                for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+                    int move = list->moves[moveNum].move;
+                    if (FROMSQ(move) == from && TOSQ(move) == to && PROMOTED(move) == promoted)
+                        generated = move;
+                }
+                int decoded = DecodeMove(pos, from, to, promoted);
+                (*checks)++;
+                if (decoded == generated)
+                    continue;
+                if (generated == NOMOVE) {
+                    if (!MakeMove(pos, decoded))
+                        continue;  //A move the generator proves illegal without playing it
+                    TakeMove(pos);
+                }
+                cout << "FEN " << fen << ": DecodeMove " << PrSq(from) << PrSq(to) << " promoted " << promoted
+                     << " gives " << PrMove(decoded) << " (" << decoded << "), generated " << PrMove(generated)
+                     << " (" << generated << ")" << endl;
+                errors++;
+            }
+        }
+    }
+
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        int move = list->moves[moveNum].move;
+        char uci[6], san[16];
+        MoveToUci(move, uci);
+        int legal = MakeMove(pos, move);
+        if (legal)
+            TakeMove(pos);
+
+        (*checks)++;
+        if (ParseMove(uci, pos) != ((legal)? move : NOMOVE)) {
+            cout << "FEN " << fen << ": ParseMove " << uci << ((legal)? " does not give the move" : " accepts an illegal move") << endl;
+            errors++;
+        }
+        if (!legal)
+            continue;
+        MoveToSan(move, pos, san);
+        (*checks)++;
+        if (ParseSan(san, pos) != move) {
+            cout << "FEN " << fen << ": ParseSan " << san << " does not give " << uci << endl;
+            errors++;
+        }
+    }
+    return errors;
+}
+
+
+/*
+    Name:    VerifyParse
+    Vars:    const char *file - A file of FENs, one per line. Anything after the FEN (Ex. perft counts) is ignored.
+    Purpose: Check that FENs and moves survive being written and read back, for each position in the file and each
+             position one move from it. Each suite line's FEN must also come back from BoardToFen as it was written.
+    Returns: The number of mismatches, or -1 if the file can't be read.
+*/
+int VerifyParse(const char *file) {
+    FILE *f = fopen(file, "r");
+    if (f == NULL) {
+        cout << "Could not open " << file << endl;
+        return -1;
+    }
+
+    S_BOARD board[1];
+    char line[1024], fen[MAXFENLEN];
+    int positions = 0, errors = 0;
+    long checks = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (line[0] == '\n' || ParseFen(line, board) != 0)
+            continue;
+        positions++;
+
+        //The FEN as written, without the trailing fields and spaces
+        size_t len = strcspn(line, ";\r\n");
+        while (len > 0 && line[len - 1] == ' ')
+            len--;
+        line[len] = '\0';
+        checks++;
+        if (strcmp(BoardToFen(board, fen), line) != 0) {
+            cout << "FEN " << line << " is written back as " << fen << endl;
+            errors++;
+        }
+
+        errors += VerifyPosition(board, &checks);
+        S_MOVELIST list[1];
+        GenerateAllMoves(board, list);
+        for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+            if (!MakeMove(board, list->moves[moveNum].move))
+                continue;
+            positions++;
+            errors += VerifyPosition(board, &checks);
+            TakeMove(board);
+        }
+    }
+    fclose(f);
+
+    cout << "Parse verification: " << positions << " positions, " << checks << " checks, " << errors << " mismatches" << endl;
+    return errors;
+}
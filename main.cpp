@@ -2,7 +2,11 @@
 
 #include "defs.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <thread>
 
 using namespace std;
 
@@ -22,11 +26,197 @@ char PERFFEN[] = {"n1n5/PPPk4/8/8/8/8/4Kppp/5N1N w - - 0 1"};
     Name:    main
     Purpose: Driver function
 */
-int main () {
+int main (int argc, char *argv[]) {
     AllInit();
 
+    //Diagnostic modes given on the command line run without the interactive board
+    if (argc > 1 && strcmp(argv[1], "hashstats") == 0) {  //a hashstats [depth] [file]
+        HashStats((argc > 2)? atoi(argv[2]) : 3, (argc > 3)? argv[3] : "perfsuite.txt");
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {  //a bench [depth]
+        Bench((argc > 2)? atoi(argv[2]) : 7);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "search") == 0) {  //a search [depth] [-nonull] [-nolmr] [-nofutility] [-norfp] [-noext] [-nopvs] [-noasp] [-multipv n] [-book <file.bin>] [-syzygy <path>] [-tbdepth n] [-tbpieces n] [-fen "<fen>"]
+        S_BOARD board[1];
+        S_SEARCHINFO info[1];
+        char *fen = START_FEN;
+        const char *book = NULL;
+
+        InitSearchInfo(info);
+        if (argc > 2)
+            info->depth = atoi(argv[2]);
+        for (int i = 3; i < argc; ++i) {
+            if      (strcmp(argv[i], "-nonull") == 0)     info->useNullMove = FALSE;
+            else if (strcmp(argv[i], "-nolmr") == 0)      info->useLMR = FALSE;
+            else if (strcmp(argv[i], "-nofutility") == 0) info->useFutility = FALSE;
+            else if (strcmp(argv[i], "-norfp") == 0)      info->useRFP = FALSE;
+            else if (strcmp(argv[i], "-noext") == 0)      info->useCheckExt = FALSE;
+            else if (strcmp(argv[i], "-nopvs") == 0)      info->usePVS = FALSE;
+            else if (strcmp(argv[i], "-noasp") == 0)      info->useAspiration = FALSE;
+            else if (strcmp(argv[i], "-multipv") == 0 && i + 1 < argc) info->multiPV = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-book") == 0 && i + 1 < argc)    book = argv[++i];
+            else if (strcmp(argv[i], "-syzygy") == 0 && i + 1 < argc)   SyzygyInit(argv[++i]);
+            else if (strcmp(argv[i], "-tbdepth") == 0 && i + 1 < argc)  info->tbProbeDepth = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-tbpieces") == 0 && i + 1 < argc) info->tbProbeLimit = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-fen") == 0 && i + 1 < argc) fen = argv[++i];
+        }
+
+        board->PvTable->pTable = NULL;
+        InitPvTable(board->PvTable);
+        if (ParseFen(fen, board) != 0)
+            return 1;
+        if (book != NULL)
+            info->useBook = OpenPolyBook(book);
+        PrintBoard(board);
+        SearchPosition(board, info);
+        ClosePolyBook();
+        SyzygyFree();
+        return 0;
+    }
+    if (argc > 2 && strcmp(argv[1], "analyze") == 0) {  //a analyze <pgn file|dir> [-depth n] [-nodes n] [-time ms] [-threads n] [-blunder cp]
+        S_SEARCHINFO info[1];
+        int threads = std::thread::hardware_concurrency();
+        int blunderMargin = 200;
+
+        InitSearchInfo(info);
+        info->depth = MAXDEPTH - 1;
+        info->nodeLimit = 100000;
+        for (int i = 3; i + 1 < argc; ++i) {
+            if      (strcmp(argv[i], "-depth") == 0)   { info->depth = atoi(argv[++i]); info->nodeLimit = 0; }
+            else if (strcmp(argv[i], "-nodes") == 0)   info->nodeLimit = atol(argv[++i]);
+            else if (strcmp(argv[i], "-time") == 0)    { info->moveTime = atoi(argv[++i]); info->nodeLimit = 0; }
+            else if (strcmp(argv[i], "-threads") == 0) threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-blunder") == 0) blunderMargin = atoi(argv[++i]);
+        }
+
+        AnalyzePgn(argv[2], info, threads, blunderMargin);
+        return 0;
+    }
+    if (argc > 3 && strcmp(argv[1], "compare") == 0) {  //a compare <base results> <new results> [threshold %]
+        int slower = CompareBenchmarks(argv[2], argv[3], (argc > 4)? atof(argv[4]) : 2.0);
+        return (slower == 0)? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "epd") == 0) {  //a epd <file> [-depth n] [-nodes n] [-time ms] [-threads n]
+        S_SEARCHINFO info[1];
+        int threads = 1;
+
+        InitSearchInfo(info);
+        info->depth = MAXDEPTH - 1;
+        info->nodeLimit = 500000;
+        for (int i = 3; i + 1 < argc; ++i) {
+            if      (strcmp(argv[i], "-depth") == 0)   { info->depth = atoi(argv[++i]); info->nodeLimit = 0; }
+            else if (strcmp(argv[i], "-nodes") == 0)   info->nodeLimit = atol(argv[++i]);
+            else if (strcmp(argv[i], "-time") == 0)    { info->moveTime = atoi(argv[++i]); info->nodeLimit = 0; }
+            else if (strcmp(argv[i], "-threads") == 0) threads = atoi(argv[++i]);
+        }
+
+        return (EpdSuite(argv[2], info, threads) >= 0)? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "match") == 0) {  //a match [-a "<options>"] [-b "<options>"] [-games n] [-threads n] [-nodes n] [-time ms] [-depth n] [-openings file] [-pgn file] [-elo0 x] [-elo1 x] [-alpha x] [-beta x]
+        S_SEARCHINFO info[1];
+        const char *optsA = "", *optsB = "";
+        const char *openings = NULL;
+        const char *pgn = "match.pgn";
+        int games = 1000;
+        int threads = std::thread::hardware_concurrency();
+        double elo0 = 0, elo1 = 5, alpha = 0.05, beta = 0.05;
+
+        InitSearchInfo(info);
+        info->depth = MAXDEPTH - 1;
+        info->nodeLimit = 20000;
+        for (int i = 2; i + 1 < argc; ++i) {
+            if      (strcmp(argv[i], "-a") == 0)        optsA = argv[++i];
+            else if (strcmp(argv[i], "-b") == 0)        optsB = argv[++i];
+            else if (strcmp(argv[i], "-games") == 0)    games = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-threads") == 0)  threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-nodes") == 0)    info->nodeLimit = atol(argv[++i]);
+            else if (strcmp(argv[i], "-time") == 0)     { info->moveTime = atoi(argv[++i]); info->nodeLimit = 0; }
+            else if (strcmp(argv[i], "-depth") == 0)    { info->depth = atoi(argv[++i]); info->nodeLimit = 0; }
+            else if (strcmp(argv[i], "-openings") == 0) openings = argv[++i];
+            else if (strcmp(argv[i], "-pgn") == 0)      pgn = argv[++i];
+            else if (strcmp(argv[i], "-elo0") == 0)     elo0 = atof(argv[++i]);
+            else if (strcmp(argv[i], "-elo1") == 0)     elo1 = atof(argv[++i]);
+            else if (strcmp(argv[i], "-alpha") == 0)    alpha = atof(argv[++i]);
+            else if (strcmp(argv[i], "-beta") == 0)     beta = atof(argv[++i]);
+        }
+
+        PlayMatch(optsA, optsB, info, openings, pgn, games, threads, elo0, elo1, alpha, beta);
+        return 0;
+    }
+    if (argc > 2 && strcmp(argv[1], "tune") == 0) {  //a tune <positions file> [-epochs n] [-rate r] [-threads n] [-out file]
+        int epochs = 200;
+        double rate = 1.0;
+        int threads = std::thread::hardware_concurrency();
+        const char *out = NULL;
+
+        for (int i = 3; i + 1 < argc; ++i) {
+            if      (strcmp(argv[i], "-epochs") == 0)  epochs = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-rate") == 0)    rate = atof(argv[++i]);
+            else if (strcmp(argv[i], "-threads") == 0) threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-out") == 0)     out = argv[++i];
+        }
+
+        return (TuneEval(argv[2], epochs, rate, threads, out) >= 0)? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "datagen") == 0) {  //a datagen <packed file> [-positions n] [-threads n] [-nodes n] [-depth n] [-random n] [-seed n]
+        S_SEARCHINFO info[1];
+        long positions = 1000000;
+        int threads = std::thread::hardware_concurrency();
+        int randomPlies = 8;
+        U64 seed = (U64)time(NULL);
+
+        InitSearchInfo(info);
+        info->depth = MAXDEPTH - 1;
+        info->nodeLimit = 5000;
+        for (int i = 3; i + 1 < argc; ++i) {
+            if      (strcmp(argv[i], "-positions") == 0) positions = atol(argv[++i]);
+            else if (strcmp(argv[i], "-threads") == 0)   threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-nodes") == 0)     info->nodeLimit = atol(argv[++i]);
+            else if (strcmp(argv[i], "-depth") == 0)     { info->depth = atoi(argv[++i]); info->nodeLimit = 0; }
+            else if (strcmp(argv[i], "-random") == 0)    randomPlies = atoi(argv[++i]);
+            else if (strcmp(argv[i], "-seed") == 0)      seed = strtoull(argv[++i], NULL, 10);
+        }
+
+        return (GenerateData(argv[2], info, positions, threads, randomPlies, seed) >= 0)? 0 : 1;
+    }
+    if (argc > 3 && strcmp(argv[1], "pack") == 0) {  //a pack <FEN or EPD file> <packed file>
+        return (PackFile(argv[2], argv[3]) >= 0)? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "readpacked") == 0) {  //a readpacked <packed file>
+        return (ReadPackedFile(argv[2]) >= 0)? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "verifyhash") == 0) {  //a verifyhash [interval] [depth] [file]
+        HashVerifyInterval = (argc > 2)? atoi(argv[2]) : 64;
+        PerftSuite((argc > 3)? atoi(argv[3]) : 3, (argc > 4)? argv[4] : "perfsuite.txt");
+        cout << "Hash verification: " << HashVerifyChecks << " keys checked, " << HashVerifyErrors << " mismatches" << endl;
+        return (HashVerifyErrors == 0)? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "verifyparse") == 0) {  //a verifyparse [file]
+        return (VerifyParse((argc > 2)? argv[2] : "perfsuite.txt") == 0)? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "verifytb") == 0) {  //a verifytb <syzygy path> [step]
+        return (VerifyTablebases(argv[2], (argc > 3 && atoi(argv[3]) > 1)? atoi(argv[3]) : 1) == 0)? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "writetb") == 0) {  //a writetb <dir>
+        return (WriteTestTables(argv[2]) == 0)? 0 : 1;
+    }
+
     S_BOARD board[1];
     S_MOVELIST list[1];
+    S_SEARCHINFO info[1];
+
+    board->PvTable->pTable = NULL;
+    InitPvTable(board->PvTable);
+    InitSearchInfo(info);
+
+    //Play from book.bin when there is one next to the program
+    FILE *book = fopen("book.bin", "rb");
+    if (book != NULL) {
+        fclose(book);
+        info->useBook = OpenPolyBook("book.bin");
+    }
 
     ParseFen(START_FEN, board);
     //PerftTest(3, board);
@@ -46,6 +236,8 @@ int main () {
             continue;
         } else if (input[0] == 'p') {
             PerftTest(4, board);
+        } else if (input[0] == 's') {
+            SearchPosition(board, info);
         } else {
             Move = ParseMove(input, board);
             if (Move != NOMOVE) 
@@ -56,5 +248,6 @@ int main () {
     }
 
 
+    ClosePolyBook();
     return 0;
 } 
\ No newline at end of file
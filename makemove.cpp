@@ -48,6 +48,12 @@ static void AddPiece(const int sq, S_BOARD *pos, const int pce) {
     pos->pieces[sq] = pce;
     pos->material[col] += PieceVal[pce];
 
+    SETBIT(pos->pceBB[pce],     SQ64(sq));  //Add the piece to its bitboard and the occupancy bitboards
+    SETBIT(pos->occupied[col],  SQ64(sq));
+    SETBIT(pos->occupied[BOTH], SQ64(sq));
+    pos->attackMapValid = 0;
+    pos->checkInfoValid = FALSE;
+
     if (PieceBig[pce]) {
         pos->bigPce[col]++;                   //Increase bigPce count and eith majPce or minPce
         (PieceMaj[pce])? pos->majPce[col]++
@@ -83,6 +89,12 @@ static void ClearPiece(const int sq, S_BOARD *pos) {
     pos->pieces[sq] = EMPTY;  //Clear the square
     pos->material[col] -= PieceVal[pce]; //Remove the piece value from the material count
 
+    CLRBIT(pos->pceBB[pce],     SQ64(sq));  //Remove the piece from its bitboard and the occupancy bitboards
+    CLRBIT(pos->occupied[col],  SQ64(sq));
+    CLRBIT(pos->occupied[BOTH], SQ64(sq));
+    pos->attackMapValid = 0;
+    pos->checkInfoValid = FALSE;
+
     if (PieceBig[pce]) {      //Decrement the bigPce count and either the maj or min counts
         pos->bigPce[col]--;
         (PieceMaj[pce])? pos->majPce[col]-- 
@@ -126,6 +138,13 @@ static void MovePiece(const int from, const int to, S_BOARD *pos) {
     HASH_PCE(pce, to);            //Hash in the 'to' square to the key
     pos->pieces[to] = pce;        //Fill the 'to' square
 
+    U64 fromTo = SetMask[SQ64(from)] | SetMask[SQ64(to)];  //Toggling both squares moves the piece on its bitboards
+    pos->pceBB[pce]     ^= fromTo;
+    pos->occupied[col]  ^= fromTo;
+    pos->occupied[BOTH] ^= fromTo;
+    pos->attackMapValid = 0;
+    pos->checkInfoValid = FALSE;
+
     if (!PieceBig[pce]) {         //If the piece is a pawn, clear the old square and add the new one to the bitboard
         CLRBIT(pos->pawns[col],  SQ64(from));
         CLRBIT(pos->pawns[BOTH], SQ64(from));
@@ -160,6 +179,7 @@ static void MovePiece(const int from, const int to, S_BOARD *pos) {
     Purpose: Set the board up for the move to be made by resetting enpassant squares, clearing captured pieces, saving history, rehashing the key, and finally calling MovePiece
 */
 int MakeMove(S_BOARD *pos, int move) {
+    PROFILE(PROF_MAKEMOVE);
     ASSERT(CheckBoard(pos));
 
     int from = FROMSQ(move);
@@ -172,6 +192,19 @@ int MakeMove(S_BOARD *pos, int move) {
     ASSERT(PieceValid(pos->pieces[from]));
 
     pos->history[pos->hisPly].posKey = pos->posKey;  //Save the current key in history so the move can be undone
+    pos->repTable[REPINDEX(pos->posKey)]++;          //and count it in the repetition table
+
+    //Save the check and pin info so TakeMove can restore it instead of recomputing it for the next move from this position
+    U64 pinned = PinnedPieces(pos);
+    pos->history[pos->hisPly].checkers = pos->checkers;
+    pos->history[pos->hisPly].pinned = pinned;
+    pos->history[pos->hisPly].discoverers = pos->discoverers;
+
+    //If the side to move is not in check, a move that is not by the king, not en passant, and not a pinned piece leaving its pin line
+    //cannot expose the king. Those moves skip the attack test after the move is made.
+    int kingSq64 = SQ64(pos->KingSq[side]);
+    int knownLegal = !pos->checkers && !(move & MFLAGEP) && from != pos->KingSq[side]
+                  && (!(pinned & SetMask[SQ64(from)]) || (Line[kingSq64][SQ64(from)] & SetMask[SQ64(to)]));
 
     if (move & MFLAGEP) {         //If the move is enpassant
         (side == WHITE)? ClearPiece(to-10, pos) : ClearPiece(to+10, pos);
@@ -252,7 +285,7 @@ int MakeMove(S_BOARD *pos, int move) {
     ASSERT(CheckBoard(pos));       //Double check that the board is still ok
 
     //If the king is attacked by the new side to move, the last move was illegal so undo it and return false. I.e. a king in check must move
-    if (SqAttacked(pos->KingSq[side], pos->side, pos)) {
+    if (!knownLegal && SqAttacked(pos->KingSq[side], pos->side, pos)) {
         TakeMove(pos);
         return FALSE;
     }
@@ -261,17 +294,90 @@ int MakeMove(S_BOARD *pos, int move) {
 }
 
 
+/*
+    Name:    MakeNullMove
+    Vars:    S_BOARD *pos - Pointer to a position.
+    Purpose: Pass the turn to the other side without moving a piece. Used by null move pruning in the search.
+             The side to move must not be in check.
+*/
+void MakeNullMove(S_BOARD *pos) {
+    ASSERT(CheckBoard(pos));
+    ASSERT(!SqAttacked(pos->KingSq[pos->side], pos->side^1, pos));
+
+    //Save the state of the board in history, the same way MakeMove does
+    pos->history[pos->hisPly].posKey = pos->posKey;
+    pos->repTable[REPINDEX(pos->posKey)]++;
+    pos->history[pos->hisPly].move = NOMOVE;
+    pos->history[pos->hisPly].fiftyMove = pos->fiftyMove;
+    pos->history[pos->hisPly].enPas = pos->enPas;
+    pos->history[pos->hisPly].castlePerm = pos->castlePerm;
+    pos->history[pos->hisPly].checkers = Checkers(pos);
+    pos->history[pos->hisPly].pinned = pos->pinned;
+    pos->history[pos->hisPly].discoverers = pos->discoverers;
+
+    //The en passant square is lost by passing
+    if (pos->enPas != NO_SQ) HASH_EP;
+    pos->enPas = NO_SQ;
+
+    pos->hisPly++;
+    pos->ply++;
+
+    //Switch sides. The pieces have not moved so the attack maps are still good, but checks and pins are relative to the side to move.
+    pos->side ^= 1;
+    HASH_SIDE;
+    pos->checkInfoValid = FALSE;
+
+    ASSERT(CheckBoard(pos));
+}
+
+
+/*
+    Name:    TakeNullMove
+    Vars:    S_BOARD *pos - Pointer to a position.
+    Purpose: Undo a null move made by MakeNullMove.
+*/
+void TakeNullMove(S_BOARD *pos) {
+    ASSERT(CheckBoard(pos));
+
+    pos->hisPly--;
+    pos->ply--;
+
+    pos->repTable[REPINDEX(pos->history[pos->hisPly].posKey)]--;
+
+    if (pos->enPas != NO_SQ) HASH_EP;
+
+    pos->castlePerm = pos->history[pos->hisPly].castlePerm;
+    pos->fiftyMove = pos->history[pos->hisPly].fiftyMove;
+    pos->enPas = pos->history[pos->hisPly].enPas;
+
+    if (pos->enPas != NO_SQ) HASH_EP;
+
+    pos->side ^= 1;
+    HASH_SIDE;
+
+    pos->checkers = pos->history[pos->hisPly].checkers;
+    pos->pinned = pos->history[pos->hisPly].pinned;
+    pos->discoverers = pos->history[pos->hisPly].discoverers;
+    pos->checkInfoValid = TRUE;
+
+    ASSERT(CheckBoard(pos));
+}
+
+
 /*
     Name:    TakeMove
     Vars:    S_BOARD *pos - Pointer to a position.
     Purpose: Undo a move. This may occur if the move was illegal or while reviewing a game.
 */
 void TakeMove(S_BOARD *pos) {
+    PROFILE(PROF_TAKEMOVE);
     ASSERT(CheckBoard(pos));
 
     pos->hisPly--;  //Decrement move numbers
     pos->ply--;
 
+    pos->repTable[REPINDEX(pos->history[pos->hisPly].posKey)]--;  //The key leaves history so remove it from the repetition table
+
     int move = pos->history[pos->hisPly].move;  //Reload the last move
     int from = FROMSQ(move);
     int to = TOSQ(move);
@@ -328,5 +434,11 @@ void TakeMove(S_BOARD *pos) {
         AddPiece(from, pos, ((PieceCol[PROMOTED(move)] == WHITE)? wP : bP));
     }
 
+    //Restore the check and pin info saved by MakeMove
+    pos->checkers = pos->history[pos->hisPly].checkers;
+    pos->pinned = pos->history[pos->hisPly].pinned;
+    pos->discoverers = pos->history[pos->hisPly].discoverers;
+    pos->checkInfoValid = TRUE;
+
     ASSERT(CheckBoard(pos));
 }
\ No newline at end of file
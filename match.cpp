@@ -0,0 +1,513 @@
+//match.cpp
+
+#include "defs.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+extern char START_FEN[];
+
+#define MATCH_MAXPLIES 400  //Games still going after this many plies are drawn
+
+//Played twice by default, once with each engine as white. Balanced main lines, so the games aren't all the same.
+static const char *DefaultOpenings[] = {
+    "e2e4 e7e5 g1f3 b8c6 f1b5 a7a6",    //Ruy Lopez
+    "e2e4 e7e5 g1f3 b8c6 f1c4 f8c5",    //Italian
+    "e2e4 e7e5 f2f4 e5f4 g1f3 g7g5",    //King's Gambit
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4",    //Open Sicilian
+    "e2e4 c7c5 b1c3 b8c6 g2g3 g7g6",    //Closed Sicilian
+    "e2e4 e7e6 d2d4 d7d5 b1c3 g8f6",    //French
+    "e2e4 c7c6 d2d4 d7d5 e4e5 c8f5",    //Caro-Kann
+    "e2e4 d7d5 e4d5 d8d5 b1c3 d5a5",    //Scandinavian
+    "e2e4 g8f6 e4e5 f6d5 d2d4 d7d6",    //Alekhine
+    "d2d4 d7d5 c2c4 e7e6 b1c3 g8f6",    //Queen's Gambit Declined
+    "d2d4 d7d5 c2c4 c7c6 g1f3 g8f6",    //Slav
+    "d2d4 g8f6 c2c4 g7g6 b1c3 f8g7",    //King's Indian
+    "d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",    //Nimzo-Indian
+    "d2d4 f7f5 g2g3 g8f6 f1g2 g7g6",    //Dutch
+    "c2c4 e7e5 b1c3 g8f6 g2g3 d7d5",    //English
+    "g1f3 d7d5 g2g3 g8f6 f1g2 e7e6",    //Reti
+};
+
+//A starting position: a FEN and the moves played from it before the engines take over
+typedef struct {
+    string fen;
+    vector<string> moves;   //Coordinate moves. Ex. e2e4
+} S_OPENING;
+
+//A finished game
+typedef struct {
+    int result;             //From white's point of view: 1 win, 0 draw, -1 loss
+    int whiteEngine;        //0 if engine A had white
+    string reason;
+    string fen;             //Start position if it isn't the normal one
+    vector<string> san;     //Every move, opening included
+} S_GAMERECORD;
+
+//Everything the workers share
+typedef struct {
+    vector<S_OPENING> openings;
+    S_SEARCHINFO engines[2];    //The two configurations, A and B
+    string names[2];
+    int maxGames;
+    double elo0, elo1;          //SPRT hypotheses: A is elo0 stronger than B against elo1 stronger
+    double alpha, beta;         //Error rates
+    int resignScore, resignMoves;   //Adjudicate a win when both engines agree on a score this big for this many moves each
+    int drawScore, drawMoves;       //Adjudicate a draw when both see a score this small for this many moves each, after move 40
+
+    atomic<int> next;
+    atomic<int> stop;
+    mutex lock;                 //Guards everything below, the PGN file and the output
+    int wins, draws, losses;    //Engine A's results
+    int played;
+    FILE *pgn;
+} S_MATCH;
+
+
+/*
+    Name:    ApplyEngineOption
+    Vars:    S_SEARCHINFO *info - A configuration.
+             const vector<string> &opts - Its options. Ex. "-nonull", "-nodes", "5000"
+             size_t *i          - The option to read. Moved past any value it takes.
+    Purpose: Set one option of an engine configuration. The switches are those of the search mode, plus the limits.
+    Returns: TRUE if the option was known.
+*/
+static int ApplyEngineOption(S_SEARCHINFO *info, const vector<string> &opts, size_t *i) {
+    const string &o = opts[*i];
+    int hasValue = (*i + 1 < opts.size());
+
+    if      (o == "-nonull")     info->useNullMove = FALSE;
+    else if (o == "-nolmr")      info->useLMR = FALSE;
+    else if (o == "-nofutility") info->useFutility = FALSE;
+    else if (o == "-norfp")      info->useRFP = FALSE;
+    else if (o == "-noext")      info->useCheckExt = FALSE;
+    else if (o == "-nopvs")      info->usePVS = FALSE;
+    else if (o == "-noasp")      info->useAspiration = FALSE;
+    else if (o == "-nodes" && hasValue) info->nodeLimit = atol(opts[++*i].c_str());
+    else if (o == "-time" && hasValue)  info->moveTime = atoi(opts[++*i].c_str());
+    else if (o == "-depth" && hasValue) info->depth = atoi(opts[++*i].c_str());
+    else return FALSE;
+    return TRUE;
+}
+
+
+/*
+    Name:    LoadOpenings
+    Vars:    const char *file       - A file with a FEN or EPD position per line, or NULL for the built in openings.
+             vector<S_OPENING> &out - Filled with the openings.
+    Returns: TRUE if any were found.
+*/
+static int LoadOpenings(const char *file, vector<S_OPENING> &out) {
+    if (file == NULL) {
+        for (const char *line : DefaultOpenings) {
+            S_OPENING op;
+            op.fen = START_FEN;
+            char moves[128];
+            snprintf(moves, sizeof(moves), "%s", line);
+            for (char *m = strtok(moves, " "); m != NULL; m = strtok(NULL, " "))
+                op.moves.push_back(m);
+            out.push_back(op);
+        }
+        return TRUE;
+    }
+
+    FILE *f = fopen(file, "r");
+    if (f == NULL) {
+        printf("Could not open %s\n", file);
+        return FALSE;
+    }
+
+    //Only the four position fields are kept. The clocks, or EPD opcodes, that follow are dropped.
+    char line[1024];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char fields[4][96];
+        if (line[0] == '#' || sscanf(line, "%95s %95s %95s %95s", fields[0], fields[1], fields[2], fields[3]) != 4)
+            continue;
+        S_OPENING op;
+        op.fen = string(fields[0]) + " " + fields[1] + " " + fields[2] + " " + fields[3] + " 0 1";
+        out.push_back(op);
+    }
+    fclose(f);
+    return !out.empty();
+}
+
+
+/*
+    Name:    HasLegalMove
+    Vars:    S_BOARD *pos - A pointer to the board.
+    Returns: TRUE if the side to move has a legal move.
+*/
+int HasLegalMove(S_BOARD *pos) {
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        if (MakeMove(pos, list->moves[moveNum].move)) {
+            TakeMove(pos);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+/*
+    Name:    GameOver
+    Vars:    S_BOARD *pos        - The game's board.
+             const char **reason - Set to why the game ended.
+    Purpose: Apply the rules: mate, stalemate, the 50 move rule, threefold repetition and bare kings or a lone minor piece.
+    Returns: 1 or -1 for a white or black win, 0 for a draw, or 2 if the game goes on.
+*/
+int GameOver(S_BOARD *pos, const char **reason) {
+    if (!HasLegalMove(pos)) {
+        if (InCheck(pos)) {
+            *reason = (pos->side == WHITE)? "black mates" : "white mates";
+            return (pos->side == WHITE)? -1 : 1;
+        }
+        *reason = "stalemate";
+        return 0;
+    }
+    if (pos->fiftyMove >= 100) {
+        *reason = "50 move rule";
+        return 0;
+    }
+
+    int seen = 0;
+    for (int i = pos->hisPly - pos->fiftyMove; i < pos->hisPly; ++i)
+        if (i >= 0 && pos->history[i].posKey == pos->posKey)
+            seen++;
+    if (seen >= 2) {
+        *reason = "3-fold repetition";
+        return 0;
+    }
+
+    //KvK, KNvK and KBvK. majPce counts the kings too, so the rooks and queens are counted directly.
+    int heavy = pos->pceNum[wP] + pos->pceNum[bP] + pos->pceNum[wR] + pos->pceNum[bR] + pos->pceNum[wQ] + pos->pceNum[bQ];
+    if (heavy == 0 && pos->minPce[WHITE] + pos->minPce[BLACK] <= 1) {
+        *reason = "insufficient material";
+        return 0;
+    }
+    return 2;
+}
+
+
+/*
+    Name:    PlayGame
+    Vars:    S_MATCH *match     - The match.
+             int gameNum        - Which game. Each opening is played by a pair of games with the colours reversed.
+             S_BOARD *pos       - The worker's board.
+             S_PVTABLE *tables  - The worker's pv tables, one per engine, so neither sees the other's analysis.
+             S_GAMERECORD *rec  - Filled with the game.
+*/
+static void PlayGame(S_MATCH *match, int gameNum, S_BOARD *pos, S_PVTABLE *tables, S_GAMERECORD *rec) {
+    const S_OPENING &op = match->openings[(gameNum / 2) % match->openings.size()];
+    rec->whiteEngine = gameNum % 2;
+    rec->fen = (op.fen == START_FEN)? "" : op.fen;
+    rec->san.clear();
+
+    char san[16];
+    ParseFen(op.fen, pos);
+    for (const string &m : op.moves) {
+        int move = ParseMove(m.c_str(), pos);
+        if (move == NOMOVE || !MakeMove(pos, move))
+            break;
+        TakeMove(pos);
+        rec->san.push_back(MoveToSan(move, pos, san));
+        MakeMove(pos, move);
+    }
+
+    S_SEARCHINFO info[2] = {match->engines[0], match->engines[1]};
+    for (int e = 0; e < 2; ++e) {
+        ClearPvTable(&tables[e]);
+        info[e].keepHash = TRUE;
+    }
+
+    vector<int> scores;     //Each move's score, from white's point of view
+    int plies = 0;
+    while (TRUE) {
+        const char *reason;
+        int result = GameOver(pos, &reason);
+        if (result != 2) {
+            rec->result = result;
+            rec->reason = reason;
+            return;
+        }
+        if (plies >= MATCH_MAXPLIES) {
+            rec->result = 0;
+            rec->reason = "game too long";
+            return;
+        }
+
+        //Adjudicate once both engines have agreed for long enough
+        int n = (int)scores.size();
+        if (match->resignMoves > 0 && n >= 2 * match->resignMoves) {
+            int white = TRUE, black = TRUE;
+            for (int i = n - 2 * match->resignMoves; i < n; ++i) {
+                white &= (scores[i] >= match->resignScore);
+                black &= (scores[i] <= -match->resignScore);
+            }
+            if (white || black) {
+                rec->result = (white)? 1 : -1;
+                rec->reason = (white)? "white wins by adjudication" : "black wins by adjudication";
+                return;
+            }
+        }
+        if (match->drawMoves > 0 && pos->hisPly >= 80 && n >= 2 * match->drawMoves) {
+            int draw = TRUE;
+            for (int i = n - 2 * match->drawMoves; i < n; ++i)
+                draw &= (abs(scores[i]) <= match->drawScore);
+            if (draw) {
+                rec->result = 0;
+                rec->reason = "draw by adjudication";
+                return;
+            }
+        }
+
+        int engine = (pos->side == WHITE)? rec->whiteEngine : 1 - rec->whiteEngine;
+        pos->PvTable[0] = tables[engine];
+        SearchPosition(pos, &info[engine]);
+
+        int move = info[engine].bestMove;
+        if (move == NOMOVE || !MakeMove(pos, move)) {  //Can't happen with a legal move available, but don't loop on it
+            rec->result = (pos->side == WHITE)? -1 : 1;
+            rec->reason = "no move returned";
+            return;
+        }
+        TakeMove(pos);
+        rec->san.push_back(MoveToSan(move, pos, san));
+        scores.push_back((pos->side == WHITE)? info[engine].bestScore : -info[engine].bestScore);
+        MakeMove(pos, move);
+        plies++;
+    }
+}
+
+
+/*
+    Name:    WritePgn
+    Vars:    S_MATCH *match          - The match. Its lock must be held.
+             int gameNum             - Which game.
+             const S_GAMERECORD *rec - The game.
+*/
+static void WritePgn(S_MATCH *match, int gameNum, const S_GAMERECORD *rec) {
+    FILE *f = match->pgn;
+    const char *result = (rec->result > 0)? "1-0" : (rec->result < 0)? "0-1" : "1/2-1/2";
+
+    char date[16];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+
+    fprintf(f, "[Event \"%s\"]\n[Site \"local\"]\n[Date \"%s\"]\n[Round \"%d\"]\n", NAME, date, gameNum + 1);
+    fprintf(f, "[White \"%s\"]\n[Black \"%s\"]\n[Result \"%s\"]\n",
+            match->names[rec->whiteEngine].c_str(), match->names[1 - rec->whiteEngine].c_str(), result);
+    if (!rec->fen.empty())
+        fprintf(f, "[FEN \"%s\"]\n[SetUp \"1\"]\n", rec->fen.c_str());
+    fprintf(f, "[Termination \"%s\"]\n\n", (rec->reason.find("adjudication") != string::npos)? "adjudication" : "normal");
+
+    //Black may move first from a FEN
+    int blackFirst = (!rec->fen.empty() && rec->fen.find(" b ") != string::npos);
+    int column = 0;
+    for (size_t i = 0; i < rec->san.size(); ++i) {
+        char text[32];
+        int ply = (int)i + blackFirst;
+        if (ply % 2 == 0)
+            snprintf(text, sizeof(text), "%d. %s", ply / 2 + 1, rec->san[i].c_str());
+        else if (i == 0)
+            snprintf(text, sizeof(text), "%d... %s", ply / 2 + 1, rec->san[i].c_str());
+        else
+            snprintf(text, sizeof(text), "%s", rec->san[i].c_str());
+
+        int len = (int)strlen(text);
+        if (column + len + 1 > 79) {
+            fprintf(f, "\n");
+            column = 0;
+        }
+        fprintf(f, "%s%s", (column)? " " : "", text);
+        column += len + (column? 1 : 0);
+    }
+    fprintf(f, "%s{%s} %s\n\n", (column)? " " : "", rec->reason.c_str(), result);
+    fflush(f);
+}
+
+
+/*
+    Name:    SprtLLR
+    Vars:    int wins, draws, losses - Results so far.
+             double elo0, elo1       - The two hypotheses.
+    Purpose: Log likelihood ratio of elo1 against elo0 for the sequential probability ratio test, using the normal
+             approximation to the trinomial results: LLR = N (s1 - s0)(2s - s0 - s1) / (2 var), with s the score per game.
+    Returns: The LLR. 0 until there are both wins or losses and a spread of results.
+*/
+static double SprtLLR(int wins, int draws, int losses, double elo0, double elo1) {
+    double n = wins + draws + losses;
+    if (n == 0 || wins + losses == 0)
+        return 0;
+    double w = wins / n, d = draws / n, l = losses / n;
+    double s = w + d / 2;
+    double var = w * (1 - s) * (1 - s) + d * (0.5 - s) * (0.5 - s) + l * s * s;
+    if (var <= 0)
+        return 0;
+    double s0 = 1 / (1 + pow(10, -elo0 / 400));
+    double s1 = 1 / (1 + pow(10, -elo1 / 400));
+    return n * (s1 - s0) * (2 * s - s0 - s1) / (2 * var);
+}
+
+
+/*
+    Name:    EloEstimate
+    Vars:    int wins, draws, losses - Results so far.
+             double *margin          - Set to the half width of the 95% interval.
+    Returns: The Elo difference the results suggest.
+*/
+static double EloEstimate(int wins, int draws, int losses, double *margin) {
+    double n = wins + draws + losses;
+    *margin = 0;
+    if (n == 0)
+        return 0;
+    double s = (wins + draws / 2.0) / n;
+    double var = (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / n;
+    double lo = s - 1.96 * sqrt(var / n), hi = s + 1.96 * sqrt(var / n);
+    auto elo = [](double p) { p = fmin(fmax(p, 1e-6), 1 - 1e-6); return -400 * log10(1 / p - 1); };
+    *margin = (elo(hi) - elo(lo)) / 2;
+    return elo(s);
+}
+
+
+/*
+    Name:    MatchWorker
+    Vars:    S_MATCH *match - The match.
+    Purpose: Play games until the match is over. Each worker has its own board and a pv table per engine.
+*/
+static void MatchWorker(S_MATCH *match) {
+    S_BOARD board[1];
+    S_PVTABLE tables[2];
+    board->PvTable->pTable = NULL;
+    for (int e = 0; e < 2; ++e) {
+        tables[e].pTable = NULL;
+        InitPvTable(&tables[e]);
+    }
+
+    S_GAMERECORD rec;
+    while (!match->stop) {
+        int gameNum = match->next++;
+        if (gameNum >= match->maxGames)
+            break;
+        PlayGame(match, gameNum, board, tables, &rec);
+
+        lock_guard<mutex> guard(match->lock);
+        int score = (rec.whiteEngine == 0)? rec.result : -rec.result;  //For engine A
+        if (score > 0)      match->wins++;
+        else if (score < 0) match->losses++;
+        else                match->draws++;
+        match->played++;
+        if (match->pgn != NULL)
+            WritePgn(match, gameNum, &rec);
+
+        double margin;
+        double elo = EloEstimate(match->wins, match->draws, match->losses, &margin);
+        double llr = SprtLLR(match->wins, match->draws, match->losses, match->elo0, match->elo1);
+        double lower = log(match->beta / (1 - match->alpha)), upper = log((1 - match->beta) / match->alpha);
+        printf("Game %4d %-9s %-28s A-B %d-%d-%d  Elo %+.1f +/- %.1f  LLR %.2f [%.2f, %.2f]\n",
+               gameNum + 1, (rec.result > 0)? "1-0" : (rec.result < 0)? "0-1" : "1/2-1/2", rec.reason.c_str(),
+               match->wins, match->losses, match->draws, elo, margin, llr, lower, upper);
+        fflush(stdout);
+        if (llr >= upper || llr <= lower)
+            match->stop = TRUE;
+    }
+
+    for (int e = 0; e < 2; ++e)
+        free(tables[e].pTable);
+    ProfileMerge();
+}
+
+
+/*
+    Name:    PlayMatch
+    Vars:    const char *optsA, *optsB - The options of each engine, as one string. Ex. "-nonull -nodes 5000"
+             S_SEARCHINFO *limits      - The limits both engines start from: nodeLimit, moveTime and/or depth.
+             const char *openingFile   - FEN or EPD file of start positions, or NULL for the built in openings.
+             const char *pgnFile       - Where the games are written, or NULL.
+             int games, int threads    - The most games to play, and how many to play at once.
+             double elo0, elo1, alpha, beta - SPRT settings.
+    Purpose: Play two configurations of the engine against each other to see whether a change gains strength.
+             Each opening is played twice with the colours reversed. Games are adjudicated once both engines agree the
+             game is won (+-800 for 4 moves each) or dead drawn (+-10 for 8 moves each after move 40).
+             After every game the SPRT log likelihood ratio is checked, and the match stops as soon as it crosses a bound:
+             the upper bound accepts that A is elo1 stronger than B, the lower that it is no more than elo0 stronger.
+    Returns: 1 if elo1 was accepted, -1 if elo0 was, 0 if the games ran out first.
+*/
+int PlayMatch(const char *optsA, const char *optsB, S_SEARCHINFO *limits, const char *openingFile, const char *pgnFile,
+              int games, int threads, double elo0, double elo1, double alpha, double beta) {
+    S_MATCH match;
+    if (!LoadOpenings(openingFile, match.openings))
+        return 0;
+
+    const char *opts[2] = {optsA, optsB};
+    for (int e = 0; e < 2; ++e) {
+        match.engines[e] = *limits;
+        match.engines[e].quiet = TRUE;
+        match.engines[e].multiPV = 1;
+
+        vector<string> tokens;
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%s", opts[e]);
+        for (char *t = strtok(buf, " "); t != NULL; t = strtok(NULL, " "))
+            tokens.push_back(t);
+        for (size_t i = 0; i < tokens.size(); ++i)
+            if (!ApplyEngineOption(&match.engines[e], tokens, &i))
+                printf("Engine %c: unknown option %s\n", 'A' + e, tokens[i].c_str());
+
+        match.names[e] = string(NAME) + " " + (char)('A' + e);
+        if (opts[e][0] != '\0')
+            match.names[e] += string(" (") + opts[e] + ")";
+    }
+
+    match.maxGames = games;
+    match.elo0 = elo0;
+    match.elo1 = elo1;
+    match.alpha = alpha;
+    match.beta = beta;
+    match.resignScore = 800;
+    match.resignMoves = 4;
+    match.drawScore = 10;
+    match.drawMoves = 8;
+    match.next = 0;
+    match.stop = FALSE;
+    match.wins = match.draws = match.losses = match.played = 0;
+    match.pgn = NULL;
+    if (pgnFile != NULL && (match.pgn = fopen(pgnFile, "w")) == NULL)
+        printf("Could not write %s\n", pgnFile);
+
+    if (threads < 1)
+        threads = 1;
+    printf("%s vs %s, %d openings, up to %d games on %d threads. SPRT elo0 %.1f elo1 %.1f alpha %.2f beta %.2f\n",
+           match.names[0].c_str(), match.names[1].c_str(), (int)match.openings.size(), games, threads, elo0, elo1, alpha, beta);
+
+    int start = GetTimeMs();
+    vector<thread> workers;
+    for (int i = 0; i < threads; ++i)
+        workers.emplace_back(MatchWorker, &match);
+    for (thread &t : workers)
+        t.join();
+
+    if (match.pgn != NULL)
+        fclose(match.pgn);
+
+    double margin;
+    double elo = EloEstimate(match.wins, match.draws, match.losses, &margin);
+    double llr = SprtLLR(match.wins, match.draws, match.losses, elo0, elo1);
+    int verdict = (llr >= log((1 - beta) / alpha))? 1 : (llr <= log(beta / (1 - alpha)))? -1 : 0;
+    printf("\n%d games in %ds: A %d wins, %d losses, %d draws. Elo %+.1f +/- %.1f. LLR %.2f: %s\n",
+           match.played, (GetTimeMs() - start) / 1000, match.wins, match.losses, match.draws, elo, margin, llr,
+           (verdict > 0)? "H1 accepted, A is stronger" : (verdict < 0)? "H0 accepted, A is not stronger" : "inconclusive");
+    ProfileReport("match");
+    return verdict;
+}
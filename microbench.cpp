@@ -0,0 +1,382 @@
+//microbench.cpp
+
+//Microbenchmarks of the core primitives, built as their own program with 'make microbench' so the interactive
+//program is untouched. Each benchmark is warmed up, timed over several repetitions and summarized; -json writes the
+//results in a form that can be compared across commits.
+
+#include "defs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+char START_FEN[] = {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"};  //main.cpp is not linked in
+
+#define BENCH_BATCH 4096    //Random inputs generated ahead of time, so the generator isn't timed
+
+//Positions the board benchmarks cycle through: opening, middlegames, an ending and promotions
+static const char *MicroFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+};
+#define NUMFENS ((int)(sizeof(MicroFens) / sizeof(MicroFens[0])))
+
+//A benchmark runs a primitive ops times and returns a checksum of the results, so the work can't be optimized away
+typedef struct {
+    const char *name;
+    U64 (*run)(long ops);
+} S_MICROBENCH;
+
+//The summary of one benchmark, in nanoseconds per op
+typedef struct {
+    const char *name;
+    long ops;                   //Ops per repetition
+    vector<double> samples;     //ns per op of each repetition
+    double mean, median, stddev, min, max;
+} S_MICRORESULT;
+
+static S_BOARD Boards[NUMFENS];
+static S_MOVELIST MoveLists[NUMFENS];
+static vector<string> UciMoves[NUMFENS];    //The legal moves of each position as text, for the parsers
+static vector<string> SanMoves[NUMFENS];
+static U64 RandomBBs[BENCH_BATCH];
+static int RandomSqs[BENCH_BATCH];
+static volatile U64 Sink;   //Checksums are written here so the compiler has to compute them
+
+
+/*
+    Name:    Rand64
+    Purpose: xorshift64* generator with a fixed seed, so every run benchmarks the same inputs.
+    Returns: A pseudo random 64 bit number.
+*/
+static U64 Rand64() {
+    static U64 s = 0x9E3779B97F4A7C15ULL;
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 0x2545F4914F6CDD1DULL;
+}
+
+
+/*
+    Name:    SetupInputs
+    Purpose: Parse the benchmark positions, generate their moves and fill the random inputs.
+*/
+static void SetupInputs() {
+    for (int i = 0; i < NUMFENS; ++i) {
+        Boards[i].PvTable->pTable = NULL;
+        ParseFen(MicroFens[i], &Boards[i]);
+        GenerateAllMoves(&Boards[i], &MoveLists[i]);
+        for (int moveNum = 0; moveNum < MoveLists[i].count; ++moveNum) {
+            int move = MoveLists[i].moves[moveNum].move;
+            char buf[16];
+            if (!MakeMove(&Boards[i], move))
+                continue;
+            TakeMove(&Boards[i]);
+            UciMoves[i].push_back(MoveToUci(move, buf));
+            SanMoves[i].push_back(MoveToSan(move, &Boards[i], buf));
+        }
+    }
+    for (int i = 0; i < BENCH_BATCH; ++i) {
+        RandomBBs[i] = Rand64() & Rand64();    //About 16 bits set, like a typical piece or attack set
+        RandomSqs[i] = SQ120(Rand64() % 64);
+    }
+}
+
+
+static U64 BenchGenerateAllMoves(long ops) {
+    U64 sum = 0;
+    S_MOVELIST list[1];
+    for (long i = 0; i < ops; ++i) {
+        GenerateAllMoves(&Boards[i % NUMFENS], list);
+        sum += list->count;
+    }
+    return sum;
+}
+
+static U64 BenchGenerateAllCaps(long ops) {
+    U64 sum = 0;
+    S_MOVELIST list[1];
+    for (long i = 0; i < ops; ++i) {
+        GenerateAllCaps(&Boards[i % NUMFENS], list);
+        sum += list->count;
+    }
+    return sum;
+}
+
+//One op is a MakeMove and, if the move was legal, the TakeMove undoing it. The moves of every position are cycled through.
+static U64 BenchMakeTakeMove(long ops) {
+    U64 sum = 0;
+    int fen = 0, moveNum = 0;
+    for (long i = 0; i < ops; ++i) {
+        S_BOARD *pos = &Boards[fen];
+        if (MakeMove(pos, MoveLists[fen].moves[moveNum].move)) {
+            sum += pos->posKey;
+            TakeMove(pos);
+        }
+        if (++moveNum == MoveLists[fen].count) {
+            moveNum = 0;
+            fen = (fen + 1) % NUMFENS;
+        }
+    }
+    return sum;
+}
+
+static U64 BenchSqAttacked(long ops) {
+    U64 sum = 0;
+    for (long i = 0; i < ops; ++i)
+        sum += SqAttacked(RandomSqs[i & (BENCH_BATCH - 1)], i & 1, &Boards[(i >> 1) % NUMFENS]);
+    return sum;
+}
+
+static U64 BenchGeneratePosKey(long ops) {
+    U64 sum = 0;
+    for (long i = 0; i < ops; ++i)
+        sum += GeneratePosKey(&Boards[i % NUMFENS]);
+    return sum;
+}
+
+static U64 BenchParseFen(long ops) {
+    U64 sum = 0;
+    S_BOARD *board = new S_BOARD;
+    board->PvTable->pTable = NULL;
+    for (long i = 0; i < ops; ++i) {
+        ParseFen(MicroFens[i % NUMFENS], board);
+        sum += board->posKey;
+    }
+    delete board;
+    return sum;
+}
+
+//SetupFen on a board that is already set up, as a bulk loader uses it
+static U64 BenchSetupFen(long ops) {
+    U64 sum = 0;
+    S_BOARD *board = new S_BOARD;
+    board->PvTable->pTable = NULL;
+    ResetBoard(board);
+    for (long i = 0; i < ops; ++i) {
+        SetupFen(MicroFens[i % NUMFENS], board, NULL);
+        sum += board->posKey;
+    }
+    delete board;
+    return sum;
+}
+
+static U64 BenchBoardToFen(long ops) {
+    U64 sum = 0;
+    char fen[MAXFENLEN];
+    for (long i = 0; i < ops; ++i)
+        sum += BoardToFen(&Boards[i % NUMFENS], fen)[0];
+    return sum;
+}
+
+//One op formats every move of a position
+static U64 BenchMoveToUci(long ops) {
+    U64 sum = 0;
+    char buf[6];
+    for (long i = 0; i < ops; ++i) {
+        const S_MOVELIST *list = &MoveLists[i % NUMFENS];
+        for (int moveNum = 0; moveNum < list->count; ++moveNum)
+            sum += MoveToUci(list->moves[moveNum].move, buf)[3];
+    }
+    return sum;
+}
+
+//One op parses one move. The legal moves of every position are cycled through.
+static U64 BenchParseText(long ops, vector<string> *moves, int (*parse)(const char *, S_BOARD *)) {
+    U64 sum = 0;
+    int fen = 0, moveNum = 0;
+    for (long i = 0; i < ops; ++i) {
+        sum += parse(moves[fen][moveNum].c_str(), &Boards[fen]);
+        if (++moveNum == (int)moves[fen].size()) {
+            moveNum = 0;
+            fen = (fen + 1) % NUMFENS;
+        }
+    }
+    return sum;
+}
+
+static U64 BenchParseMove(long ops) {
+    return BenchParseText(ops, UciMoves, ParseMove);
+}
+
+static U64 BenchParseSan(long ops) {
+    return BenchParseText(ops, SanMoves, ParseSan);
+}
+
+static U64 BenchCountBits(long ops) {
+    U64 sum = 0;
+    for (long i = 0; i < ops; ++i)
+        sum += CountBits(RandomBBs[i & (BENCH_BATCH - 1)]);
+    return sum;
+}
+
+//One op pops every bit of a bitboard
+static U64 BenchPopBit(long ops) {
+    U64 sum = 0;
+    for (long i = 0; i < ops; ++i) {
+        U64 bb = RandomBBs[i & (BENCH_BATCH - 1)];
+        while (bb)
+            sum += PopBit(&bb);
+    }
+    return sum;
+}
+
+static const S_MICROBENCH MicroBenches[] = {
+    {"GenerateAllMoves", BenchGenerateAllMoves},
+    {"GenerateAllCaps",  BenchGenerateAllCaps},
+    {"MakeMove+TakeMove", BenchMakeTakeMove},
+    {"SqAttacked",       BenchSqAttacked},
+    {"GeneratePosKey",   BenchGeneratePosKey},
+    {"ParseFen",         BenchParseFen},
+    {"SetupFen",         BenchSetupFen},
+    {"BoardToFen",       BenchBoardToFen},
+    {"MoveToUci",        BenchMoveToUci},
+    {"ParseMove",        BenchParseMove},
+    {"ParseSan",         BenchParseSan},
+    {"CountBits",        BenchCountBits},
+    {"PopBit",           BenchPopBit},
+};
+
+
+/*
+    Name:    TimeOps
+    Vars:    const S_MICROBENCH *b - The benchmark.
+             long ops              - How many ops to run.
+    Returns: The time taken in nanoseconds.
+*/
+static double TimeOps(const S_MICROBENCH *b, long ops) {
+    auto start = chrono::steady_clock::now();
+    Sink = Sink + b->run(ops);
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count();
+}
+
+
+/*
+    Name:    RunMicroBench
+    Vars:    const S_MICROBENCH *b - The benchmark.
+             int reps              - Timed repetitions.
+             double minTime        - The least time in ms a repetition should take.
+    Purpose: Find an op count that takes at least minTime (which also warms the caches and branch predictors up),
+             then time reps repetitions of it and summarize them.
+    Returns: The summary.
+*/
+static S_MICRORESULT RunMicroBench(const S_MICROBENCH *b, int reps, double minTime) {
+    S_MICRORESULT r;
+    r.name = b->name;
+
+    long ops = 1;
+    while (TimeOps(b, ops) < minTime * 1e6 && ops < (1L << 40))
+        ops *= 2;
+    TimeOps(b, ops);
+
+    for (int i = 0; i < reps; ++i)
+        r.samples.push_back(TimeOps(b, ops) / ops);
+    r.ops = ops;
+
+    vector<double> sorted = r.samples;
+    sort(sorted.begin(), sorted.end());
+    int n = (int)sorted.size();
+    r.min = sorted[0];
+    r.max = sorted[n - 1];
+    r.median = (n % 2)? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+
+    r.mean = 0;
+    for (double s : sorted)
+        r.mean += s;
+    r.mean /= n;
+
+    r.stddev = 0;
+    for (double s : sorted)
+        r.stddev += (s - r.mean) * (s - r.mean);
+    r.stddev = (n > 1)? sqrt(r.stddev / (n - 1)) : 0;
+
+    return r;
+}
+
+
+/*
+    Name:    WriteJson
+    Vars:    const char *file                  - Where to write.
+             const vector<S_MICRORESULT> &res  - The results.
+             int reps, double minTime          - The settings they were taken with.
+    Purpose: Save the results, every repetition included, for comparing against another build.
+    Returns: TRUE if the file was written.
+*/
+static int WriteJson(const char *file, const vector<S_MICRORESULT> &res, int reps, double minTime) {
+    FILE *f = fopen(file, "w");
+    if (f == NULL) {
+        printf("Could not write %s\n", file);
+        return FALSE;
+    }
+
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    fprintf(f, "{\n  \"context\": {\"date\": \"%s\", \"repetitions\": %d, \"min_time_ms\": %.0f},\n", date, reps, minTime);
+    fprintf(f, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < res.size(); ++i) {
+        const S_MICRORESULT &r = res[i];
+        fprintf(f, "    {\"name\": \"%s\", \"time_unit\": \"ns\", \"iterations\": %ld, \"mean\": %.3f, \"median\": %.3f, "
+                   "\"stddev\": %.3f, \"min\": %.3f, \"max\": %.3f, \"samples\": [",
+                r.name, r.ops, r.mean, r.median, r.stddev, r.min, r.max);
+        for (size_t s = 0; s < r.samples.size(); ++s)
+            fprintf(f, "%s%.3f", (s)? ", " : "", r.samples[s]);
+        fprintf(f, "]}%s\n", (i + 1 < res.size())? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return TRUE;
+}
+
+
+/*
+    Name:    main
+    Purpose: microbench [-reps n] [-mintime ms] [-filter text] [-json file]
+             Runs every benchmark whose name contains the filter and prints a table of ns per op.
+*/
+int main(int argc, char *argv[]) {
+    int reps = 10;
+    double minTime = 50;
+    const char *filter = "";
+    const char *json = NULL;
+
+    for (int i = 1; i + 1 < argc; ++i) {
+        if      (strcmp(argv[i], "-reps") == 0)    reps = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-mintime") == 0) minTime = atof(argv[++i]);
+        else if (strcmp(argv[i], "-filter") == 0)  filter = argv[++i];
+        else if (strcmp(argv[i], "-json") == 0)    json = argv[++i];
+    }
+
+    AllInit();
+    SetupInputs();
+
+    printf("%-18s %12s %10s %10s %10s %10s %10s\n", "Benchmark", "Iterations", "Mean ns", "Median", "Stddev", "Min", "Max");
+    vector<S_MICRORESULT> results;
+    for (const S_MICROBENCH &b : MicroBenches) {
+        if (strstr(b.name, filter) == NULL)
+            continue;
+        S_MICRORESULT r = RunMicroBench(&b, reps, minTime);
+        printf("%-18s %12ld %10.2f %10.2f %10.2f %10.2f %10.2f\n", r.name, r.ops, r.mean, r.median, r.stddev, r.min, r.max);
+        fflush(stdout);
+        results.push_back(r);
+    }
+
+    if (json != NULL && !WriteJson(json, results, reps, minTime))
+        return 1;
+    return 0;
+}
@@ -27,6 +27,24 @@
 
 static void AddCaptureMove (const S_BOARD *pos, int move, S_MOVELIST *list);  //These declarations exist so I can keep the functions in alphabetical order
 static void AddQuietMove (const S_BOARD *pos, int move, S_MOVELIST *list);
+static int  ProvenIllegal (const S_BOARD *pos, const int move);
+
+//Most Valuable Victim, Least Valuable Attacker. Captures of big pieces by small pieces are searched first.
+const int VictimScore[13] = {0, 100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600};
+
+/*
+    Name:    InitMvvLva
+    Purpose: Build the capture ordering scores, indexed by [victim][attacker].
+*/
+static constexpr std::array<std::array<int, 13>, 13> InitMvvLva() {
+    std::array<std::array<int, 13>, 13> scores = {};
+    for (int attacker = wP; attacker <= bK; ++attacker)
+        for (int victim = wP; victim <= bK; ++victim)
+            scores[victim][attacker] = VictimScore[victim] + 6 - (VictimScore[attacker] / 100);
+    return scores;
+}
+
+static constexpr std::array<std::array<int, 13>, 13> MvvLvaScores = InitMvvLva();
 
 //Array used for generating moves for non-sliding pieces. The array will loop through until a 0 is found which allows for white and black pieces to be stored together.
 const int LoopNonSlidePce[6] = {wN, wK, 0, bN, bK, 0};
@@ -113,8 +131,14 @@ static void AddBlackPawnMove(const S_BOARD *pos, const int from, const int to, S
     Purpose: For a given position, add a capture move to the list of possible next moves.
 */
 static void AddCaptureMove (const S_BOARD *pos, int move, S_MOVELIST *list) {
+    if (ProvenIllegal(pos, move))          //Don't add moves the check and pin info already rule out
+        return;
+
+    //En passant captures a pawn that isn't on the 'to' square, so score it as pawn takes pawn
+    int victim = (move & MFLAGEP)? wP : CAPTURED(move);
+
     list->moves[list->count].move = move;  //Store the move
-    list->moves[list->count].score = 0;    //Store the score for the move. This is used for finding the best move.
+    list->moves[list->count].score = MvvLvaScores[victim][pos->pieces[FROMSQ(move)]] + 1000000;  //Captures are ordered above every quiet move
     list->count++;                         //Increment the number of moves in the list.
 }
 
@@ -142,9 +166,21 @@ static void AddQuietMove (const S_BOARD *pos, int move, S_MOVELIST *list) {
     ASSERT(SqOnBoard(FROMSQ(move)));
 	ASSERT(SqOnBoard(TOSQ(move)));
 	ASSERT(CheckBoard(pos));
+
+    if (ProvenIllegal(pos, move))          //Don't add moves the check and pin info already rule out
+        return;
     
     list->moves[list->count].move = move;  //Store the move
-    list->moves[list->count].score = 0;    //Store the score for the move. This is used for finding the best move.
+
+    //Store the score for the move. Killer moves come straight after the captures, then the rest by how often they caused a cutoff.
+    //ply only resets inside search, so moves played at the console can take it past the killer table.
+    if (pos->ply < MAXDEPTH && pos->searchKillers[0][pos->ply] == move)
+        list->moves[list->count].score = 900000;
+    else if (pos->ply < MAXDEPTH && pos->searchKillers[1][pos->ply] == move)
+        list->moves[list->count].score = 800000;
+    else
+        list->moves[list->count].score = pos->searchHistory[pos->pieces[FROMSQ(move)]][TOSQ(move)];
+
     list->count++;                         //Increment the number of moves in the list.
 }
 
@@ -202,12 +238,47 @@ static void AddWhitePawnMove(const S_BOARD *pos, const int from, const int to, S
 
 
 /*
-    Name:    GenerateAllMoves
+    Name:    ProvenIllegal
+    Vars:    S_BOARD *pos - Pointer to a position.
+             int move     - The move to test.
+    Purpose: Use the cached checkers and pinned pieces to rule out moves that can never be legal: any non-king move in double check,
+             a non-king move that neither captures nor blocks a single checker, and a pinned piece leaving its pin line.
+             King moves and en passant are left for MakeMove to test, so this never rejects a legal move.
+    Returns: TRUE if the move is certainly illegal, FALSE if MakeMove has to decide.
+*/
+static int ProvenIllegal (const S_BOARD *pos, const int move) {
+    int kingSq = pos->KingSq[pos->side];
+    if (FROMSQ(move) == kingSq || (move & MFLAGEP))
+        return FALSE;
+
+    int kingSq64 = SQ64(kingSq);
+    U64 fromBB = SetMask[SQ64(FROMSQ(move))];
+    U64 toBB = SetMask[SQ64(TOSQ(move))];
+    U64 checkers = Checkers(pos);
+
+    if (checkers) {
+        if (checkers & (checkers - 1))  //Double check, only the king can move
+            return TRUE;
+        U64 checker = checkers;
+        if (!((Between[kingSq64][POP(&checker)] | checkers) & toBB))
+            return TRUE;
+    }
+
+    if ((pos->pinned & fromBB) && !(Line[kingSq64][SQ64(FROMSQ(move))] & toBB))
+        return TRUE;
+
+    return FALSE;
+}
+
+
+/*
+    Name:    GenerateMoves
     Vars:    S_BOARD *pos     - Pointer to a position.
              S_MOVELIST *list - Pointer to the move list to add moves to.
-    Purpose: Generate all possible moves from a given position.
+             int quiets       - TRUE to generate every move, FALSE for captures (including en passant) only.
+    Purpose: Generate the possible moves from a given position.
 */
-void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
+static void GenerateMoves (const S_BOARD *pos, S_MOVELIST *list, const int quiets) {
     ASSERT(CheckBoard(pos));  //Assert that the position is valid
 
     list->count = 0;
@@ -220,7 +291,7 @@ void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
 
             ASSERT(SqOnBoard(sq));                                                //Assert that the square is on the board
 
-            if (pos->pieces[sq+10] == EMPTY) {                                    //If the pawn can move staight ahead
+            if (quiets && pos->pieces[sq+10] == EMPTY) {                          //If the pawn can move staight ahead
                 AddWhitePawnMove(pos, sq, sq+10, list);                           //Add the move to the list
 
                 if (RanksBrd[sq] == RANK_2 && pos->pieces[sq+20] == EMPTY)        //If the pawn is on the start square, it may move 2 squares
@@ -232,21 +303,23 @@ void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
             if (!SQOFFBOARD(sq+11) && PieceCol[pos->pieces[sq+11]] == BLACK)
                 AddWhitePawnCapMove(pos, sq, sq+11, pos->pieces[sq+11], list);
 
+            if (pos->enPas == NO_SQ)                                              //NO_SQ is 99, which is h7+11, so it must never be matched
+                continue;
             if (sq+9 == pos->enPas)                                               //Add en passant moves with en passant flag
                 AddCaptureMove(pos, MOVE(sq, sq+9, EMPTY, EMPTY, MFLAGEP), list);
             else if (sq+11 == pos->enPas)
                 AddCaptureMove(pos, MOVE(sq, sq+11, EMPTY, EMPTY, MFLAGEP), list);
         }
 
-        //Generate White side castling moves
-        if (pos->castlePerm & WKCA &&                                   //If White King castle perms are set,
+        //Generate White side castling moves. The attack map is only built if a castle is still possible, and then answers every square at once.
+        if (quiets && pos->castlePerm & WKCA &&                                   //If White King castle perms are set,
             pos->pieces[F1] == EMPTY && pos->pieces[G1] == EMPTY &&     //and there's a clear path from the king to the rook,
-            !SqAttacked(E1, BLACK, pos) && !SqAttacked(F1, BLACK, pos)) //and both the king and f1 are not under attack. G1 is already checked in MakeMove.
+            !(AttackMap(pos, BLACK) & (SetMask[SQ64(E1)] | SetMask[SQ64(F1)]))) //and both the king and f1 are not under attack. G1 is already checked in MakeMove.
             AddQuietMove(pos, MOVE(E1, G1, EMPTY, EMPTY, MFLAGCA), list);
         
-        if (pos->castlePerm & WQCA &&                                   //If White Queen castle perms are set
+        if (quiets && pos->castlePerm & WQCA &&                                   //If White Queen castle perms are set
             pos->pieces[D1] == EMPTY && pos->pieces[C1] == EMPTY && pos->pieces[B1] == EMPTY &&
-            !SqAttacked(E1, BLACK, pos) && !SqAttacked(D1, BLACK, pos)) 
+            !(AttackMap(pos, BLACK) & (SetMask[SQ64(E1)] | SetMask[SQ64(D1)])))
             AddQuietMove(pos, MOVE(E1, C1, EMPTY, EMPTY, MFLAGCA), list);
 
     } else {  //Black pawns
@@ -255,7 +328,7 @@ void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
 
             ASSERT(SqOnBoard(sq));  //Assert that the square is on the board
 
-            if (pos->pieces[sq-10] == EMPTY) {           //If the pawn can move staight ahead
+            if (quiets && pos->pieces[sq-10] == EMPTY) { //If the pawn can move staight ahead
                 AddBlackPawnMove(pos, sq, sq-10, list);  //Add the move to the list
 
                 if (RanksBrd[sq] == RANK_7 && pos->pieces[sq-20] == EMPTY)              //If the pawn is on the start square, it may move 2 squares
@@ -267,6 +340,8 @@ void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
             if (!SQOFFBOARD(sq-11) && PieceCol[pos->pieces[sq-11]] == WHITE)
                 AddBlackPawnCapMove(pos, sq, sq-11, pos->pieces[sq-11], list);
 
+            if (pos->enPas == NO_SQ)
+                continue;
             if (sq-9 == pos->enPas)  //Add en passant moves with en passant flag
                 AddCaptureMove(pos, MOVE(sq, sq-9, EMPTY, EMPTY, MFLAGEP), list);
             else if (sq-11 == pos->enPas)
@@ -274,14 +349,14 @@ void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
         }
 
         //Generate Black side castling moves
-        if (pos->castlePerm & BKCA &&                                   //If White King castle perms are set
+        if (quiets && pos->castlePerm & BKCA &&                                   //If White King castle perms are set
             pos->pieces[F8] == EMPTY && pos->pieces[G8] == EMPTY &&     //and there's a clear path from the king to the rook
-            !SqAttacked(E8, WHITE, pos) && !SqAttacked(F8, WHITE, pos)) //and both the king and f1 are not under attack
+            !(AttackMap(pos, WHITE) & (SetMask[SQ64(E8)] | SetMask[SQ64(F8)]))) //and both the king and f1 are not under attack
             AddQuietMove(pos, MOVE(E8, G8, EMPTY, EMPTY, MFLAGCA), list);
         
-        if (pos->castlePerm & BQCA &&                                   //If White Queen castle perms are set
+        if (quiets && pos->castlePerm & BQCA &&                                   //If White Queen castle perms are set
             pos->pieces[D8] == EMPTY && pos->pieces[C8] == EMPTY && pos->pieces[B8] == EMPTY &&
-            !SqAttacked(E8, WHITE, pos) && !SqAttacked(D8, WHITE, pos)) 
+            !(AttackMap(pos, WHITE) & (SetMask[SQ64(E8)] | SetMask[SQ64(D8)])))
             AddQuietMove(pos, MOVE(E8, C8, EMPTY, EMPTY, MFLAGCA), list);
     }
 
@@ -311,7 +386,8 @@ void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
                         break;                                          //The square is occupied so the direction has been fully explored
                     }
 
-                    AddQuietMove(pos, MOVE(sq, t_sq, EMPTY, EMPTY, 0), list);  //If the new square was onboard and empty, moving to it is a normal move
+                    if (quiets)
+                        AddQuietMove(pos, MOVE(sq, t_sq, EMPTY, EMPTY, 0), list);  //If the new square was onboard and empty, moving to it is a normal move
                     t_sq += dir;                                        //Continue in the same direction
                 }
             }
@@ -349,9 +425,142 @@ void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
                     continue;                                       //Continue in the while loop to the next square
                 }
 
-                AddQuietMove(pos, MOVE(sq, t_sq, EMPTY, EMPTY, 0), list);  //If the new square was onboard and empty, moving to it is a normal move
+                if (quiets)
+                    AddQuietMove(pos, MOVE(sq, t_sq, EMPTY, EMPTY, 0), list);  //If the new square was onboard and empty, moving to it is a normal move
             }
         }
         pce = LoopNonSlidePce[pceIndex++];
     }
-}
\ No newline at end of file
+}
+
+
+/*
+    Name:    DecodeMove
+    Vars:    S_BOARD *pos - Pointer to a position.
+             int from     - The square the piece moves from.
+             int to       - The square it moves to.
+             int promoted - The piece a pawn promotes to, as the side to move's piece. Must be EMPTY for other moves.
+    Purpose: Build the move the generator would give for a piece going from one square to another, with its captured
+             piece and flags, by checking only that one piece can make it: pawn pushes onto empty squares, double pushes
+             from the start rank, captures and en passant, the attack tables for the other pieces, and the same tests
+             the generator makes for castling. Nothing else on the board is generated.
+    Returns: The move, pseudo-legal like a generated one, or NOMOVE if the piece can't make it.
+*/
+int DecodeMove (const S_BOARD *pos, const int from, const int to, const int promoted) {
+    if (from < 0 || from >= BRD_SQ_NUM || to < 0 || to >= BRD_SQ_NUM || SQOFFBOARD(from) || SQOFFBOARD(to) ||
+        promoted < EMPTY || promoted > bK)
+        return NOMOVE;
+
+    int side = pos->side;
+    int piece = pos->pieces[from];
+    int cap = pos->pieces[to];
+    if (piece == EMPTY || PieceCol[piece] != side || (cap != EMPTY && PieceCol[cap] == side))
+        return NOMOVE;
+
+    if (PiecePawn[piece]) {
+        int dir = (side == WHITE)? 10 : -10;
+
+        //A pawn reaching the last rank must promote, to a knight, bishop, rook or queen of its own colour, and no other move may
+        if (RanksBrd[to] == ((side == WHITE)? RANK_8 : RANK_1)) {
+            if (promoted == EMPTY || PieceCol[promoted] != side || PiecePawn[promoted] || IsKi(promoted))
+                return NOMOVE;
+        } else if (promoted != EMPTY)
+            return NOMOVE;
+
+        if (to == from + dir)
+            return (cap == EMPTY)? MOVE(from, to, EMPTY, promoted, 0) : NOMOVE;
+        if (to == from + 2 * dir)
+            return (cap == EMPTY && pos->pieces[from + dir] == EMPTY && RanksBrd[from] == ((side == WHITE)? RANK_2 : RANK_7))?
+                   MOVE(from, to, EMPTY, EMPTY, MFLAGPS) : NOMOVE;
+        if (to == from + dir - 1 || to == from + dir + 1) {
+            if (cap != EMPTY)
+                return MOVE(from, to, cap, promoted, 0);
+            return (to == pos->enPas)? MOVE(from, to, EMPTY, EMPTY, MFLAGEP) : NOMOVE;
+        }
+        return NOMOVE;
+    }
+
+    if (promoted != EMPTY)
+        return NOMOVE;
+
+    //Castling, with the tests GenerateMoves makes. The king's other moves are a single step and go through the table below.
+    if (IsKi(piece) && (to == from + 2 || to == from - 2)) {
+        int kingSide = (to > from);
+        if (side == WHITE) {
+            if (from != E1 || !(pos->castlePerm & ((kingSide)? WKCA : WQCA)))
+                return NOMOVE;
+            if ((kingSide)? (pos->pieces[F1] != EMPTY || pos->pieces[G1] != EMPTY)
+                          : (pos->pieces[D1] != EMPTY || pos->pieces[C1] != EMPTY || pos->pieces[B1] != EMPTY))
+                return NOMOVE;
+            if (AttackMap(pos, BLACK) & (SetMask[SQ64(E1)] | SetMask[SQ64((kingSide)? F1 : D1)]))
+                return NOMOVE;
+        } else {
+            if (from != E8 || !(pos->castlePerm & ((kingSide)? BKCA : BQCA)))
+                return NOMOVE;
+            if ((kingSide)? (pos->pieces[F8] != EMPTY || pos->pieces[G8] != EMPTY)
+                          : (pos->pieces[D8] != EMPTY || pos->pieces[C8] != EMPTY || pos->pieces[B8] != EMPTY))
+                return NOMOVE;
+            if (AttackMap(pos, WHITE) & (SetMask[SQ64(E8)] | SetMask[SQ64((kingSide)? F8 : D8)]))
+                return NOMOVE;
+        }
+        return MOVE(from, to, EMPTY, EMPTY, MFLAGCA);
+    }
+
+    int from64 = SQ64(from);
+    U64 reach = 0ULL;
+    if (IsKn(piece))
+        reach = KnightAttacks[from64];
+    else if (IsKi(piece))
+        reach = KingAttacks[from64];
+    else {
+        if (IsBQ(piece))
+            reach |= BishopAttacks(from64, pos->occupied[BOTH]);
+        if (IsRQ(piece))
+            reach |= RookAttacks(from64, pos->occupied[BOTH]);
+    }
+
+    return (reach & SetMask[SQ64(to)])? MOVE(from, to, cap, EMPTY, 0) : NOMOVE;
+}
+
+
+/*
+    Name:    GenerateAllMoves
+    Vars:    S_BOARD *pos     - Pointer to a position.
+             S_MOVELIST *list - Pointer to the move list to add moves to.
+    Purpose: Generate all possible moves from a given position.
+*/
+void GenerateAllMoves (const S_BOARD *pos, S_MOVELIST *list) {
+    PROFILE(PROF_GENMOVES);
+    GenerateMoves(pos, list, TRUE);
+}
+
+
+/*
+    Name:    GenerateAllCaps
+    Vars:    S_BOARD *pos     - Pointer to a position.
+             S_MOVELIST *list - Pointer to the move list to add moves to.
+    Purpose: Generate only the captures from a given position. Used by the quiescence search.
+*/
+void GenerateAllCaps (const S_BOARD *pos, S_MOVELIST *list) {
+    PROFILE(PROF_GENCAPS);
+    GenerateMoves(pos, list, FALSE);
+}
+
+
+/*
+    Name:    MoveExists
+    Vars:    S_BOARD *pos - Pointer to a position.
+             int move     - The move to look for.
+    Purpose: Check a move that came from somewhere other than the move generator (ex. the pv table) before it is played.
+             MakeMove trusts its input, so the move must be the one the generator gives for this position and be legal.
+             DecodeMove rebuilds it from its squares instead of generating every move.
+    Returns: TRUE if the move can be played, FALSE otherwise.
+*/
+int MoveExists (S_BOARD *pos, const int move) {
+    if (move == NOMOVE || DecodeMove(pos, FROMSQ(move), TOSQ(move), PROMOTED(move)) != move)
+        return FALSE;
+    if (!MakeMove(pos, move))  //Pseudo-legal but leaves the king in check
+        return FALSE;
+    TakeMove(pos);
+    return TRUE;
+}
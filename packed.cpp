@@ -0,0 +1,345 @@
+//packed.cpp
+
+#include "defs.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+//A packed file is a header the size of one record followed by the records, so every record stays 32 byte aligned.
+//Records are written in the machine's own byte order, which is little-endian on every platform the engine builds on.
+static const char PackedMagic[8] = {'C', 'B', 'P', 'A', 'C', 'K', '0', '1'};
+
+static_assert(sizeof(S_PACKEDPOS) == 32, "A packed position must be 32 bytes");
+
+
+/*
+    Name:    PackPosition
+    Vars:    const S_BOARD *pos - Pointer to a position.
+             S_PACKEDPOS *pp    - Filled with the packed position. The score, move and result are left empty.
+    Purpose: The pieces are stored as one nibble each, in the order of the set bits of the occupancy, so the squares
+             don't have to be stored. A legal position has at most 32 pieces, which fills the 16 bytes exactly.
+    Returns: TRUE if the position fits.
+*/
+int PackPosition(const S_BOARD *pos, S_PACKEDPOS *pp) {
+    ASSERT(CheckBoard(pos));
+
+    memset(pp, 0, sizeof(S_PACKEDPOS));
+    pp->occupied = pos->occupied[BOTH];
+    if (CNT(pp->occupied) > 32)
+        return FALSE;
+
+    U64 occ = pp->occupied;
+    for (int i = 0; occ; ++i) {
+        int sq64 = POP(&occ);
+        pp->pieces[i >> 1] |= pos->pieces[SQ120(sq64)] << ((i & 1) * 4);
+    }
+
+    pp->flags = (unsigned char)(pos->side | (pos->castlePerm << 1));
+    pp->enPas = (unsigned char)((pos->enPas == NO_SQ)? 64 : SQ64(pos->enPas));
+    pp->fiftyMove = (unsigned char)((pos->fiftyMove < 255)? pos->fiftyMove : 255);
+    pp->result = -1;
+    return TRUE;
+}
+
+
+/*
+    Name:    PackMove
+    Vars:    const int move - A move.
+    Returns: The move as stored in a packed position: from | to << 6 | promoted piece kind << 12, on the 64 square board.
+             The kinds are 1 knight, 2 bishop, 3 rook and 4 queen, for either colour.
+*/
+unsigned short PackMove(const int move) {
+    int promoted = PROMOTED(move), kind = 0;
+    if (promoted != EMPTY)
+        kind = IsKn(promoted)? 1 : IsRQ(promoted)? ((IsBQ(promoted))? 4 : 3) : 2;
+    return (unsigned short)(SQ64(FROMSQ(move)) | (SQ64(TOSQ(move)) << 6) | (kind << 12));
+}
+
+
+/*
+    Name:    UnpackPosition
+    Vars:    const S_PACKEDPOS *pp - A packed position.
+             S_BOARD *pos          - Set to the position.
+    Purpose: Decode a packed position straight into a board. The pieces are placed, listed, counted and keyed by
+             SetupPiece in one walk over the occupancy, so neither ResetBoard's full clear nor UpdateListsMaterial's
+             120 square scan is needed. The search tables are left alone since SearchPosition clears them itself.
+    Returns: TRUE if the record holds a board the engine can use.
+*/
+int UnpackPosition(const S_PACKEDPOS *pp, S_BOARD *pos) {
+    for (int i = 0; i < BRD_SQ_NUM; ++i)
+        pos->pieces[i] = OFFBOARD;
+    for (int i = 0; i < 64; ++i)
+        pos->pieces[SQ120(i)] = EMPTY;
+    memset(pos->pawns, 0, sizeof(pos->pawns));
+    memset(pos->occupied, 0, sizeof(pos->occupied));
+    memset(pos->pceBB, 0, sizeof(pos->pceBB));
+    memset(pos->pceNum, 0, sizeof(pos->pceNum));
+    memset(pos->bigPce, 0, sizeof(pos->bigPce));
+    memset(pos->majPce, 0, sizeof(pos->majPce));
+    memset(pos->minPce, 0, sizeof(pos->minPce));
+    memset(pos->material, 0, sizeof(pos->material));
+    memset(pos->repTable, 0, sizeof(pos->repTable));
+    pos->KingSq[WHITE] = pos->KingSq[BLACK] = NO_SQ;
+
+    pos->posKey = 0ULL;
+    U64 occ = pp->occupied;
+    for (int i = 0; occ; ++i) {
+        int sq = SQ120(POP(&occ));
+        int piece = (pp->pieces[i >> 1] >> ((i & 1) * 4)) & 0xF;
+        if (piece == EMPTY || piece > bK || !SetupPiece(pos, sq, piece))
+            return FALSE;
+        if (PiecePawn[piece] && (RanksBrd[sq] == RANK_1 || RanksBrd[sq] == RANK_8))
+            return FALSE;
+    }
+    if (pos->pceNum[wK] != 1 || pos->pceNum[bK] != 1)
+        return FALSE;
+
+    pos->side       = pp->flags & 1;
+    pos->castlePerm = (pp->flags >> 1) & 0xF;
+    pos->enPas      = (pp->enPas < 64)? SQ120(pp->enPas) : NO_SQ;
+    pos->fiftyMove  = pp->fiftyMove;
+    pos->ply        = 0;
+    pos->hisPly     = 0;
+    pos->moveNumber = 1;
+
+    //The same castling and en passant checks as SetupFen, so a corrupt record is skipped instead of reaching MakeMove
+    if (((pos->castlePerm & (WKCA | WQCA)) && pos->pieces[E1] != wK) ||
+        ((pos->castlePerm & (BKCA | BQCA)) && pos->pieces[E8] != bK) ||
+        ((pos->castlePerm & WKCA) && pos->pieces[H1] != wR) || ((pos->castlePerm & WQCA) && pos->pieces[A1] != wR) ||
+        ((pos->castlePerm & BKCA) && pos->pieces[H8] != bR) || ((pos->castlePerm & BQCA) && pos->pieces[A8] != bR))
+        return FALSE;
+    if (pp->enPas != 64) {
+        if (pp->enPas > 64 || RanksBrd[pos->enPas] != ((pos->side == WHITE)? RANK_6 : RANK_3))
+            return FALSE;
+        if (pos->pieces[pos->enPas + ((pos->side == WHITE)? -10 : 10)] != ((pos->side == WHITE)? bP : wP))
+            return FALSE;
+    }
+
+    if (pos->side == WHITE) pos->posKey ^= SideKey;
+    if (pos->enPas != NO_SQ) pos->posKey ^= PieceKeys[EMPTY][pos->enPas];
+    pos->posKey ^= CastleKeys[pos->castlePerm];
+
+    pos->attackMapValid = 0;
+    pos->checkInfoValid = FALSE;
+
+    if (SqAttacked(pos->KingSq[pos->side ^ 1], pos->side, pos))
+        return FALSE;
+    ASSERT(CheckBoard(pos));
+    return TRUE;
+}
+
+
+/*
+    Name:    CreatePackedFile
+    Vars:    const char *file - Where to write.
+    Purpose: Start a packed file. Records are then appended with fwrite.
+    Returns: The open file, or NULL if it couldn't be created.
+*/
+FILE *CreatePackedFile(const char *file) {
+    FILE *f = fopen(file, "wb");
+    if (f == NULL) {
+        printf("Could not write %s\n", file);
+        return NULL;
+    }
+    S_PACKEDPOS header;
+    memset(&header, 0, sizeof(header));
+    memcpy(&header, PackedMagic, sizeof(PackedMagic));
+    fwrite(&header, sizeof(header), 1, f);
+    return f;
+}
+
+
+/*
+    Name:    OpenPackedFile
+    Vars:    const char *file - A packed file.
+             S_PACKEDFILE *pf - Set to the open file.
+    Purpose: Memory map a packed file. The records are read in place, so a file of any size costs no heap, and the
+             pages are hinted as read in order so the kernel reads ahead of a streaming reader.
+    Returns: TRUE if the file is a packed file.
+*/
+int OpenPackedFile(const char *file, S_PACKEDFILE *pf) {
+    memset(pf, 0, sizeof(S_PACKEDFILE));
+
+#ifdef WIN32
+    HANDLE h = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return FALSE;
+    LARGE_INTEGER size;
+    GetFileSizeEx(h, &size);
+    HANDLE mapping = (size.QuadPart > 0)? CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    const unsigned char *data = (mapping)? (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (data == NULL) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(h);
+        return FALSE;
+    }
+    pf->file = h;
+    pf->mapping = mapping;
+    pf->size = (size_t)size.QuadPart;
+#else
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return FALSE;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return FALSE;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  //The mapping keeps the file open
+    if (data == MAP_FAILED)
+        return FALSE;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    pf->size = (size_t)st.st_size;
+#endif
+    pf->data = (const unsigned char *)data;
+
+    if (pf->size < sizeof(S_PACKEDPOS) || memcmp(pf->data, PackedMagic, sizeof(PackedMagic)) != 0) {
+        ClosePackedFile(pf);
+        return FALSE;
+    }
+    pf->records = (const S_PACKEDPOS *)pf->data + 1;
+    pf->count = (long)(pf->size / sizeof(S_PACKEDPOS)) - 1;   //A record cut short by a crashed writer is ignored
+    pf->next = 0;
+    return TRUE;
+}
+
+
+/*
+    Name:    ClosePackedFile
+    Vars:    S_PACKEDFILE *pf - An open packed file.
+    Purpose: Unmap the file.
+*/
+void ClosePackedFile(S_PACKEDFILE *pf) {
+    if (pf->data == NULL)
+        return;
+
+#ifdef WIN32
+    UnmapViewOfFile(pf->data);
+    CloseHandle((HANDLE)pf->mapping);
+    CloseHandle((HANDLE)pf->file);
+#else
+    munmap((void *)pf->data, pf->size);
+#endif
+    memset(pf, 0, sizeof(S_PACKEDFILE));
+}
+
+
+/*
+    Name:    ReadPacked
+    Vars:    S_PACKEDFILE *pf        - An open packed file.
+             S_BOARD *pos            - Set to the next position.
+             const S_PACKEDPOS **rec - Set to its record, for the score, move and result. May be NULL.
+    Purpose: Stream through the file. Records that don't decode are skipped.
+    Returns: TRUE while there are positions left.
+*/
+int ReadPacked(S_PACKEDFILE *pf, S_BOARD *pos, const S_PACKEDPOS **rec) {
+    while (pf->next < pf->count) {
+        const S_PACKEDPOS *pp = &pf->records[pf->next++];
+        if (UnpackPosition(pp, pos)) {
+            if (rec != NULL)
+                *rec = pp;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+/*
+    Name:    PackFile
+    Vars:    const char *in  - FEN or EPD lines, optionally labelled with a game result as for tuning.
+             const char *out - The packed file to write.
+    Purpose: Convert a text position file. The halfmove clock is kept when the line has one; EPD lines have none.
+    Returns: The number of positions written, or -1 if a file couldn't be opened.
+*/
+long PackFile(const char *in, const char *out) {
+    FILE *f = fopen(in, "r");
+    if (f == NULL) {
+        printf("Could not open %s\n", in);
+        return -1;
+    }
+    FILE *o = CreatePackedFile(out);
+    if (o == NULL) {
+        fclose(f);
+        return -1;
+    }
+
+    S_BOARD *board = new S_BOARD;
+    board->PvTable->pTable = NULL;
+    ResetBoard(board);
+    char line[1024];
+    long written = 0, skipped = 0;
+    int start = GetTimeMs();
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strchr(line, '/') == NULL)
+            continue;   //Blank or comment line
+        S_PACKEDPOS pp;
+        if (SetupFen(line, board, NULL) != NULL || !PackPosition(board, &pp)) {
+            skipped++;
+            continue;
+        }
+        pp.result = (signed char)ReadResult(line);
+        fwrite(&pp, sizeof(pp), 1, o);
+        written++;
+    }
+    fclose(f);
+    fclose(o);
+    delete board;
+
+    printf("Packed %ld positions (%ld skipped) into %s, %ld bytes, in %dms\n",
+           written, skipped, out, (long)((written + 1) * sizeof(S_PACKEDPOS)), GetTimeMs() - start);
+    return written;
+}
+
+
+/*
+    Name:    ReadPackedFile
+    Vars:    const char *file - A packed file.
+    Purpose: Decode every position of a packed file, check its key against one built from scratch, and report how
+             fast the positions were read. Records UnpackPosition rejects are left out of the count read.
+    Returns: The number of positions read, or -1 if the file isn't a packed file.
+*/
+long ReadPackedFile(const char *file) {
+    S_PACKEDFILE pf;
+    if (!OpenPackedFile(file, &pf)) {
+        printf("%s is not a packed position file\n", file);
+        return -1;
+    }
+
+    S_BOARD *board = new S_BOARD;
+    board->PvTable->pTable = NULL;
+    long read = 0, bad = 0, results = 0;
+    U64 checksum = 0;
+    int start = GetTimeMs();
+
+    while (ReadPacked(&pf, board, NULL)) {
+        if (GeneratePosKey(board) != board->posKey)
+            bad++;
+        checksum ^= board->posKey;
+        read++;
+    }
+    for (long i = 0; i < pf.count; ++i)
+        if (pf.records[i].result >= 0)
+            results++;
+
+    int ms = GetTimeMs() - start;
+    printf("Read %ld of %ld records (%ld with a result), %ld bad keys, checksum %llX, in %dms (%.0f positions/s)\n",
+           read, pf.count, results, bad, checksum, ms, read * 1000.0 / ((ms > 0)? ms : 1));
+    ClosePackedFile(&pf);
+    delete board;
+    return read;
+}
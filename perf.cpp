@@ -3,6 +3,8 @@
 #include "defs.h"
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -29,6 +31,7 @@ void Perft(int depth, S_BOARD *pos) {
     for (MoveNum = 0; MoveNum < list->count; ++MoveNum) {
         if (!MakeMove(pos, list->moves[MoveNum].move))
             continue;
+        VerifyPosKey(pos);
         Perft(depth-1, pos);
         TakeMove(pos);
     }
@@ -64,7 +67,61 @@ void PerftTest(int depth, S_BOARD *pos) {
     }
 
     cout << "\nTest Complete : " << leafNodes << " leaf nodes visited in " << GetTimeMs()-start << "ms." << endl;
+    ProfileReport("perft");
 
     return;
 }
 
+/*
+    Name:    PerftSuite
+    Vars:    int depth        - The deepest perft to run on each position.
+             const char *file - A perft suite file. Each line is a FEN followed by the expected counts, ex. ";D1 20 ;D2 400".
+    Purpose: Run perft on every position in the suite and compare the leaf counts against the expected values.
+    Returns: The number of positions whose counts did not match.
+*/
+int PerftSuite(int depth, const char *file) {
+    FILE *f = fopen(file, "r");
+    if (f == NULL) {
+        cout << "Could not open " << file << endl;
+        return -1;
+    }
+
+    S_BOARD board[1];
+    char line[1024];
+    int lineNum = 0, failed = 0;
+    int start = GetTimeMs();
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineNum++;
+        if (line[0] == '\n' || ParseFen(line, board) != 0)
+            continue;
+
+        //Find the expected count for the requested depth. Lines that stop short of it are run at their deepest listed depth.
+        char *field = strchr(line, ';');
+        int testDepth = 0;
+        long expected = 0;
+        while (field != NULL) {
+            int d = 0;
+            long count = 0;
+            if (sscanf(field, ";D%d %ld", &d, &count) == 2 && d <= depth) {
+                testDepth = d;
+                expected = count;
+            }
+            field = strchr(field+1, ';');
+        }
+        if (testDepth == 0)
+            continue;
+
+        leafNodes = 0;
+        Perft(testDepth, board);
+        if (leafNodes != expected) {
+            failed++;
+            cout << "Line " << lineNum << " depth " << testDepth << ": expected " << expected << " got " << leafNodes << endl;
+        }
+    }
+    fclose(f);
+
+    cout << "Perft suite complete: " << lineNum << " positions, " << failed << " failed in " << GetTimeMs()-start << "ms." << endl;
+    ProfileReport("perft suite");
+    return failed;
+}
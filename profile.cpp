@@ -0,0 +1,71 @@
+//profile.cpp
+
+#include "defs.h"
+
+#include <cstdio>
+#include <mutex>
+
+using namespace std;
+
+#ifdef INSTRUMENT
+thread_local S_PROFILE Profile;     //Written only by its own thread, so counting needs no locking or atomics
+static S_PROFILE ProfileTotals;     //Counts merged in from threads that have finished
+static mutex ProfileLock;
+#endif
+
+static const char *ProfileNames[PROF_NUM] = {
+    "GenerateAllMoves", "GenerateAllCaps", "MakeMove", "TakeMove", "SqAttacked", "CheckBoard", "EvalPosition"
+};
+
+
+/*
+    Name:    ProfileMerge
+    Purpose: Add the running thread's counters to the totals and zero them. Worker threads call this before they exit,
+             since their counters go with them.
+*/
+void ProfileMerge() {
+#ifdef INSTRUMENT
+    lock_guard<mutex> guard(ProfileLock);
+    for (int i = 0; i < PROF_NUM; ++i) {
+        ProfileTotals.calls[i] += Profile.calls[i];
+        ProfileTotals.cycles[i] += Profile.cycles[i];
+        Profile.calls[i] = Profile.cycles[i] = 0;
+    }
+#endif
+}
+
+
+/*
+    Name:    ProfileReport
+    Vars:    const char *title - What was run. Ex. "perft"
+    Purpose: Print the calls (and cycles, if timed) of every hot function since the last report, summed over the running
+             thread and the workers that have merged, then start counting afresh. Prints nothing unless built with INSTRUMENT.
+             It goes to stderr so modes that print results on stdout are not disturbed.
+*/
+void ProfileReport(const char *title) {
+#ifdef INSTRUMENT
+    ProfileMerge();
+
+    lock_guard<mutex> guard(ProfileLock);
+    fprintf(stderr, "\nProfile: %s\n", title);
+#ifdef INSTRUMENT_CYCLES
+    fprintf(stderr, "%-18s %14s %16s %12s\n", "Function", "Calls", "Cycles", "Cycles/call");
+#else
+    fprintf(stderr, "%-18s %14s\n", "Function", "Calls");
+#endif
+    for (int i = 0; i < PROF_NUM; ++i) {
+        if (ProfileTotals.calls[i] == 0)
+            continue;
+#ifdef INSTRUMENT_CYCLES
+        fprintf(stderr, "%-18s %14llu %16llu %12.1f\n", ProfileNames[i], ProfileTotals.calls[i], ProfileTotals.cycles[i],
+                (double)ProfileTotals.cycles[i] / ProfileTotals.calls[i]);
+#else
+        fprintf(stderr, "%-18s %14llu\n", ProfileNames[i], ProfileTotals.calls[i]);
+#endif
+        ProfileTotals.calls[i] = ProfileTotals.cycles[i] = 0;
+    }
+#else
+    (void)title;
+    (void)ProfileNames;
+#endif
+}
@@ -3,6 +3,7 @@
 #include "defs.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
 
 const int PvSize = 0x100000 * 2;  //2MB
@@ -13,7 +14,7 @@ const int PvSize = 0x100000 * 2;  //2MB
     Vars:    S_PVTABLE *t - A pointer to the table storing the list of known positions.
     Purpose: Clear the pvTable of keys and moves -- both to 0.
 */
-static void ClearPvTable(S_PVTABLE *t) {
+void ClearPvTable(S_PVTABLE *t) {
     S_PVENTRY *pvEntry;
     //Loop through all entries in the table; set the key and move to 0.
     for (pvEntry = t->pTable; pvEntry < t->pTable + t->numEntries; pvEntry++) {
@@ -23,18 +24,79 @@ static void ClearPvTable(S_PVTABLE *t) {
 }
 
 
+/*
+    Name:    GetPvLine
+    Vars:    int depth    - The most moves to extract.
+             S_BOARD *pos - A pointer to the board.
+    Purpose: Follow the best moves stored in the table from the current position to rebuild the principal variation in pos->PvArray.
+             Entries can be overwritten by other positions, so every move is checked with MoveExists before MakeMove plays it.
+    Returns: The number of moves in the line.
+*/
+int GetPvLine(const int depth, S_BOARD *pos) {
+    ASSERT(depth < MAXDEPTH);
+
+    int move = ProbePvTable(pos);
+    int count = 0;
+
+    while (move != NOMOVE && count < depth) {
+        if (!MoveExists(pos, move))
+            break;
+        MakeMove(pos, move);
+        pos->PvArray[count++] = move;
+        move = ProbePvTable(pos);
+    }
+
+    //Take the line back so the position is unchanged
+    for (int i = 0; i < count; ++i)
+        TakeMove(pos);
+
+    return count;
+}
+
+
 /*
     Name:    InitPvTable
-    Vars:    S_PVTABLE *t - A pointer to the table storing the list of known positions.
+    Vars:    S_PVTABLE *t - A pointer to the table storing the list of known positions. t->pTable must be NULL or a previous table.
     Purpose: Initialize a new pvTable by allocating memory and calling ClearPvTable
 */
 void InitPvTable(S_PVTABLE *t) {
     t->numEntries = PvSize / sizeof(S_PVENTRY);  //Size of table / size of entries gives the number of entries
     t->numEntries -= 2;  //Make sure program doesn't try to access entries outside the table
+    if (t->pTable != NULL)
+        free(t->pTable);  //Free any table this one replaces
     t->pTable = (S_PVENTRY *)malloc(t->numEntries * sizeof(S_PVENTRY));  //Allocate enough memory for the table
-    free(t->pTable);  //Free the memory *t points to
     ClearPvTable(t);
-    std::cout << "PVTABLE init complete with " << t->numEntries << " entries.\n";
+    std::cerr << "PVTABLE init complete with " << t->numEntries << " entries.\n";  //stderr, so machine readable output on stdout stays clean
+}
 
-    //Make PvTable a vector of pairs?
-}
\ No newline at end of file
+
+/*
+    Name:    ProbePvTable
+    Vars:    S_BOARD *pos - A pointer to the board.
+    Purpose: Look up the best move stored for the current position.
+    Returns: The move, or NOMOVE if the entry holds a different position.
+*/
+int ProbePvTable(const S_BOARD *pos) {
+    int index = pos->posKey % pos->PvTable->numEntries;
+    ASSERT(index >= 0 && index < pos->PvTable->numEntries);
+
+    if (pos->PvTable->pTable[index].posKey == pos->posKey)
+        return pos->PvTable->pTable[index].move;
+
+    return NOMOVE;
+}
+
+
+/*
+    Name:    StorePvMove
+    Vars:    S_BOARD *pos - A pointer to the board.
+             int move     - The best move found for the position.
+    Purpose: Save the best move for the current position, replacing whatever shared its slot.
+*/
+void StorePvMove(const S_BOARD *pos, const int move) {
+    int index = pos->posKey % pos->PvTable->numEntries;
+    ASSERT(index >= 0 && index < pos->PvTable->numEntries);
+
+    pos->PvTable->pTable[index].move = move;
+    pos->PvTable->pTable[index].posKey = pos->posKey;
+}
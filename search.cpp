@@ -3,19 +3,72 @@
 #include "defs.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
 
+using namespace std;
+
+const int NULL_R = 2;                     //Depth reduction of the null move search, on top of the move itself
+const int FutilityMargin[3] = {0, 200, 500}; //By remaining depth. A quiet move this far below alpha is not searched.
+const int RFP_MARGIN = 120;               //Per ply of remaining depth. A static eval this far above beta is trusted.
+const int ASPIRATION_WINDOW = 25;         //Half width of the first root window around the previous score. Doubles on every fail.
+
+
+/*
+    Name:    CheckUp
+    Vars:    S_SEARCHINFO *info - The search limits.
+    Purpose: Stop the search once its time or node budget is used up.
+*/
+static void CheckUp(S_SEARCHINFO *info) {
+    if (info->timeset && GetTimeMs() > info->stoptime)
+        info->stopped = TRUE;
+    if (info->nodeLimit && info->nodes >= info->nodeLimit)
+        info->stopped = TRUE;
+}
+
+
+/*
+    Name:    PickNextMove
+    Vars:    int moveNum      - The index of the next move to search.
+             S_MOVELIST *list - The moves of the node.
+    Purpose: Swap the best scoring move not yet searched into moveNum, so moves are searched best first without sorting the whole list.
+*/
+static void PickNextMove(int moveNum, S_MOVELIST *list) {
+    int bestScore = list->moves[moveNum].score;
+    int bestNum = moveNum;
+
+    for (int index = moveNum + 1; index < list->count; ++index) {
+        if (list->moves[index].score > bestScore) {
+            bestScore = list->moves[index].score;
+            bestNum = index;
+        }
+    }
+
+    S_MOVE temp = list->moves[moveNum];
+    list->moves[moveNum] = list->moves[bestNum];
+    list->moves[bestNum] = temp;
+}
+
 
 /*
     Name:    IsRepetition
     Vars:    S_BOARD *pos  - A pointer to the board.
     Purpose: Find if the board position has already been seen to improve performance when calculating moves.
+             The repetition table answers most calls in O(1): an empty bucket means no key in history can match.
+             Only when the bucket is in use is the history scanned to confirm the match.
     Returns: TRUE if the position has been seen.
              FALSE otherwise.
 */
 int IsRepetition (const S_BOARD *pos) {
-    //Loop from the last time the 50 move rule was reset to search for identical board positions
-    for (int i = pos->hisPly - pos->fiftyMove; i < pos->hisPly-1; ++i) {
+    if (pos->repTable[REPINDEX(pos->posKey)] == 0)
+        return FALSE;
+
+    //Loop from the last time the 50 move rule was reset to search for identical board positions.
+    //A clock read from a FEN can reach back past the start of the history.
+    int first = pos->hisPly - pos->fiftyMove;
+    if (first < 0)
+        first = 0;
+    for (int i = first; i < pos->hisPly-1; ++i) {
         ASSERT(i >= 0 && i < MAXGAMEMOVES);
         if (pos->posKey == pos->history[i].posKey) 
             return TRUE; 
@@ -24,11 +77,532 @@ int IsRepetition (const S_BOARD *pos) {
 }
 
 
+/*
+    Name:    ClearForSearch
+    Vars:    S_BOARD *pos       - A pointer to the board.
+             S_SEARCHINFO *info - The search limits.
+    Purpose: Reset the move ordering tables and search statistics before a new search.
+*/
+static void ClearForSearch(S_BOARD *pos, S_SEARCHINFO *info) {
+    int i, i2;
+
+    for (i = 0; i < 13; ++i)
+        for (i2 = 0; i2 < BRD_SQ_NUM; ++i2)
+            pos->searchHistory[i][i2] = 0;
+
+    for (i = 0; i < 2; ++i)
+        for (i2 = 0; i2 < MAXDEPTH; ++i2)
+            pos->searchKillers[i][i2] = NOMOVE;
+
+    if (!info->keepHash)
+        ClearPvTable(pos->PvTable);
+    pos->ply = 0;
+
+    info->starttime = GetTimeMs();
+    if (info->moveTime > 0) {
+        info->timeset = TRUE;
+        info->stoptime = info->starttime + info->moveTime;
+    }
+    info->stopped = FALSE;
+    info->nodes = 0;
+    info->bestMove = NOMOVE;
+    info->bestScore = -INFINITE;
+    info->pvCount = 0;
+    info->numExcluded = 0;
+    info->iterations = 0;
+    info->fh = info->fhf = 0;
+    info->nullTries = info->nullCutoffs = 0;
+    info->lmrReduced = info->lmrResearched = 0;
+    info->futilityPruned = info->rfpPruned = info->checkExtended = 0;
+    info->pvsResearched = info->aspFailLow = info->aspFailHigh = 0;
+    info->tbHits = 0;
+}
+
+
+/*
+    Name:    Quiescence
+    Vars:    int alpha, beta    - The score window.
+             S_BOARD *pos       - A pointer to the board.
+             S_SEARCHINFO *info - The search limits.
+    Purpose: Search captures only until the position is quiet, so the static evaluation is never taken in the middle of an exchange.
+    Returns: The score of the position for the side to move.
+*/
+static int Quiescence(int alpha, int beta, S_BOARD *pos, S_SEARCHINFO *info) {
+    ASSERT(CheckBoard(pos));
+
+    if ((info->nodes & 2047) == 0)
+        CheckUp(info);
+
+    info->nodes++;
+
+    if ((IsRepetition(pos) || pos->fiftyMove >= 100) && pos->ply)
+        return 0;
+
+    if (pos->ply > MAXDEPTH - 1)
+        return EvalPosition(pos);
+
+    //Stand pat: the side to move does not have to capture
+    int score = EvalPosition(pos);
+    if (score >= beta)
+        return beta;
+    if (score > alpha)
+        alpha = score;
+
+    S_MOVELIST list[1];
+    GenerateAllCaps(pos, list);
+
+    int legal = 0;
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        PickNextMove(moveNum, list);
+
+        if (!MakeMove(pos, list->moves[moveNum].move))
+            continue;
+
+        legal++;
+        score = -Quiescence(-beta, -alpha, pos, info);
+        TakeMove(pos);
+
+        if (info->stopped)
+            return 0;
+
+        if (score > alpha) {
+            if (score >= beta) {
+                if (legal == 1) info->fhf++;
+                info->fh++;
+                return beta;
+            }
+            alpha = score;
+        }
+    }
+
+    return alpha;
+}
+
+
+/*
+    Name:    IsExcluded
+    Vars:    int move           - A root move.
+             S_SEARCHINFO *info - The search info holding the excluded moves.
+    Purpose: Check if a root move already heads an earlier line of a MultiPV iteration.
+    Returns: TRUE if the move must be skipped.
+*/
+static int IsExcluded(const int move, const S_SEARCHINFO *info) {
+    for (int i = 0; i < info->numExcluded; ++i)
+        if (info->excluded[i] == move)
+            return TRUE;
+    return FALSE;
+}
+
+
+/*
+    Name:    AlphaBeta
+    Vars:    int alpha, beta    - The score window.
+             int depth          - The remaining depth in plies.
+             S_BOARD *pos       - A pointer to the board.
+             S_SEARCHINFO *info - The search limits and statistics.
+             int doNull         - FALSE straight after a null move, so two null moves are never played in a row.
+    Purpose: Fail-hard principal variation search with null move pruning, reverse futility pruning, futility pruning,
+             late move reductions and check extensions. Each can be switched off through info.
+             Nodes searched with a zero window (beta == alpha + 1) are expected to fail one way or the other; the pruning
+             that trusts the static evaluation is only done there, never on the principal variation.
+    Returns: The score of the position for the side to move, clamped to [alpha, beta].
+*/
+static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO *info, int doNull) {
+    ASSERT(CheckBoard(pos));
+
+    if (depth <= 0)
+        return Quiescence(alpha, beta, pos, info);
+
+    if ((info->nodes & 2047) == 0)
+        CheckUp(info);
+
+    info->nodes++;
+    VerifyPosKey(pos);
+
+    if ((IsRepetition(pos) || pos->fiftyMove >= 100) && pos->ply)
+        return 0;
+
+    if (pos->ply > MAXDEPTH - 1)
+        return EvalPosition(pos);
+
+    //Tablebases: a position with few enough pieces has a known result. SyzygyProbeWdl only answers straight after
+    //a capture or pawn move, so each ending is probed once on entry instead of at every node inside it.
+    if (TBLargest && pos->ply && depth >= info->tbProbeDepth && CNT(pos->occupied[BOTH]) <= info->tbProbeLimit) {
+        int wdl;
+        if (SyzygyProbeWdl(pos, &wdl)) {
+            info->tbHits++;
+            int score = (wdl > 1)? TBWIN - pos->ply : (wdl < -1)? -TBWIN + pos->ply : 0;  //Results the 50 move rule spoils are draws
+            if (score >= beta)  return beta;
+            if (score <= alpha) return alpha;
+            return score;
+        }
+    }
+
+    int inCheck = InCheck(pos);
+    int isPV = (beta - alpha > 1);
+
+    //Check extension: never let the horizon fall while the king is in check
+    if (inCheck && info->useCheckExt) {
+        depth++;
+        info->checkExtended++;
+    }
+
+    int staticEval = (inCheck)? -INFINITE : EvalPosition(pos);
+
+    //Reverse futility: near the leaves, if the static score beats beta by a wide margin, assume the search would too
+    if (info->useRFP && !isPV && !inCheck && pos->ply && depth <= 3 && abs(beta) < ISMATE
+        && staticEval - RFP_MARGIN * depth >= beta) {
+        info->rfpPruned++;
+        return beta;
+    }
+
+    //Null move: give the opponent a free move. If a reduced search still fails high, the real moves would too.
+    //Skipped without non-pawn pieces (bigPce counts the king), where passing can be better than every move (zugzwang).
+    if (info->useNullMove && !isPV && doNull && !inCheck && pos->ply && depth >= 4
+        && pos->bigPce[pos->side] > 1 && staticEval >= beta) {
+        info->nullTries++;
+        MakeNullMove(pos);
+        int score = -AlphaBeta(-beta, -beta + 1, depth - 1 - NULL_R, pos, info, FALSE);
+        TakeNullMove(pos);
+
+        if (info->stopped)
+            return 0;
+
+        if (score >= beta && abs(score) < ISMATE) {
+            info->nullCutoffs++;
+            return beta;
+        }
+    }
+
+    //Futility: with little depth left and the static score far below alpha, only captures, promotions and checks can catch up
+    int futile = info->useFutility && !isPV && !inCheck && depth <= 2 && abs(alpha) < ISMATE
+              && staticEval + FutilityMargin[depth] <= alpha;
+
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+
+    int legal = 0;
+    int oldAlpha = alpha;
+    int bestMove = NOMOVE;
+    int score = -INFINITE;
+    int pvMove = ProbePvTable(pos);
+
+    //Search the move from the pv table first
+    if (pvMove != NOMOVE) {
+        for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+            if (list->moves[moveNum].move == pvMove) {
+                list->moves[moveNum].score = 2000000;
+                break;
+            }
+        }
+    }
+
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        PickNextMove(moveNum, list);
+
+        int move = list->moves[moveNum].move;
+        int moveScore = list->moves[moveNum].score;
+        int tactical = (move & MFLAGCAP) || PROMOTED(move) != EMPTY;
+
+        if (pos->ply == 0 && IsExcluded(move, info))
+            continue;
+
+        if (!MakeMove(pos, move))
+            continue;
+
+        legal++;
+        int givesCheck = InCheck(pos);
+
+        if (futile && legal > 1 && !tactical && !givesCheck) {
+            info->futilityPruned++;
+            TakeMove(pos);
+            continue;
+        }
+
+        //Late move reductions: quiet moves ordered late (no killer, little history) are searched shallower first.
+        //Moves the history table has never seen cut are reduced one ply more. Independent of PVS, so either can be tested alone.
+        int reduction = 0;
+        if (info->useLMR && legal > 3 && depth >= 3 && !inCheck && !tactical && !givesCheck && moveScore < 800000) {
+            reduction = (legal > 6 && moveScore == 0)? 2 : 1;
+            info->lmrReduced++;
+        }
+
+        if (legal == 1 || !info->usePVS) {
+            //The first move is expected to be the best, so it gets the full window
+            score = -AlphaBeta(-beta, -alpha, depth - 1 - reduction, pos, info, TRUE);
+
+            if (score > alpha && reduction) {  //The reduced search beat alpha, so check it at full depth
+                info->lmrResearched++;
+                score = -AlphaBeta(-beta, -alpha, depth - 1, pos, info, TRUE);
+            }
+        } else {
+            //Every later move only has to be proven no better than alpha, which a zero window scout does cheaply
+            score = -AlphaBeta(-alpha - 1, -alpha, depth - 1 - reduction, pos, info, TRUE);
+
+            if (score > alpha && reduction) {  //The reduced scout beat alpha, so check it at full depth
+                info->lmrResearched++;
+                score = -AlphaBeta(-alpha - 1, -alpha, depth - 1, pos, info, TRUE);
+            }
+
+            if (score > alpha && score < beta) {  //The move really is better. Search it again with the full window for its exact score.
+                info->pvsResearched++;
+                score = -AlphaBeta(-beta, -alpha, depth - 1, pos, info, TRUE);
+            }
+        }
+
+        TakeMove(pos);
+
+        if (info->stopped)
+            return 0;
+
+        if (score > alpha) {
+            if (score >= beta) {
+                if (legal == 1) info->fhf++;
+                info->fh++;
+
+                //Remember quiet moves that cut so they are tried early in sibling nodes
+                if (!tactical && pos->ply < MAXDEPTH) {
+                    pos->searchKillers[1][pos->ply] = pos->searchKillers[0][pos->ply];
+                    pos->searchKillers[0][pos->ply] = move;
+                }
+                return beta;
+            }
+            alpha = score;
+            bestMove = move;
+            if (!tactical)
+                pos->searchHistory[pos->pieces[FROMSQ(move)]][TOSQ(move)] += depth;
+        }
+    }
+
+    //No legal moves is checkmate or stalemate
+    if (legal == 0)
+        return (inCheck)? -INFINITE + pos->ply : 0;
+
+    if (alpha != oldAlpha)
+        StorePvMove(pos, bestMove);
+
+    return alpha;
+}
+
+
+/*
+    Name:    InitSearchInfo
+    Vars:    S_SEARCHINFO *info - The search limits to set up.
+    Purpose: Set the default limits (depth 6, no time limit) with every selectivity feature switched on.
+*/
+void InitSearchInfo(S_SEARCHINFO *info) {
+    info->depth = 6;
+    info->timeset = FALSE;
+    info->stoptime = 0;
+    info->quiet = FALSE;
+
+    info->useNullMove = TRUE;
+    info->useLMR = TRUE;
+    info->useFutility = TRUE;
+    info->useRFP = TRUE;
+    info->useCheckExt = TRUE;
+    info->usePVS = TRUE;
+    info->useAspiration = TRUE;
+    info->multiPV = 1;
+    info->moveTime = 0;
+    info->nodeLimit = 0;
+    info->keepHash = FALSE;
+    info->useBook = FALSE;
+    info->tbProbeDepth = 1;
+    info->tbProbeLimit = 7;
+}
+
+
+/*
+    Name:    SearchRoot
+    Vars:    int depth          - The depth of this iteration.
+             int prevScore      - The score of the previous iteration.
+             S_BOARD *pos       - A pointer to the board.
+             S_SEARCHINFO *info - The search limits and statistics.
+    Purpose: Search the root with an aspiration window centred on the previous score. A score on the edge of the window
+             is only a bound, so the failing side of the window is widened (doubling each time) and the root searched again.
+    Returns: The exact score of the root.
+*/
+static int SearchRoot(int depth, int prevScore, S_BOARD *pos, S_SEARCHINFO *info) {
+    if (!info->useAspiration || depth < 4 || abs(prevScore) >= ISMATE)
+        return AlphaBeta(-INFINITE, INFINITE, depth, pos, info, TRUE);
+
+    int delta = ASPIRATION_WINDOW;
+    int alpha = prevScore - delta;
+    int beta  = prevScore + delta;
+
+    while (TRUE) {
+        int score = AlphaBeta(alpha, beta, depth, pos, info, TRUE);
+        if (info->stopped)
+            return score;
+
+        delta *= 2;
+        if (score <= alpha) {
+            info->aspFailLow++;
+            alpha = (delta > 1000)? -INFINITE : prevScore - delta;
+        } else if (score >= beta) {
+            info->aspFailHigh++;
+            beta = (delta > 1000)? INFINITE : prevScore + delta;
+        } else {
+            return score;
+        }
+    }
+}
+
+
+/*
+    Name:    CountRootMoves
+    Vars:    S_BOARD *pos - A pointer to the board.
+    Purpose: Count the legal moves at the root, which caps the number of MultiPV lines.
+    Returns: The number of legal moves.
+*/
+static int CountRootMoves(S_BOARD *pos) {
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+
+    int legal = 0;
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        if (!MakeMove(pos, list->moves[moveNum].move))
+            continue;
+        TakeMove(pos);
+        legal++;
+    }
+    return legal;
+}
+
+
 /*
     Name:    SearchPosition
-    Vars:    S_BOARD *pos  - A pointer to the board.
-    Purpose: 
+    Vars:    S_BOARD *pos       - A pointer to the board.
+             S_SEARCHINFO *info - The search limits. The best move, the MultiPV lines and statistics are returned in it.
+    Purpose: Iterative deepening search. Each iteration prints its score, node count, effective branching factor and principal variation.
+             With info->multiPV above 1 every iteration searches the root once per line, skipping the root moves of the lines
+             already found. The searches share the pv table, killers and history, so later lines and deeper iterations are
+             ordered by what the earlier ones learned instead of each line being an independent search.
 */
-void SearchPosition(S_BOARD *pos) {
+void SearchPosition(S_BOARD *pos, S_SEARCHINFO *info) {
+    ClearForSearch(pos, info);
+
+    //In book there is nothing to search. Out of book, GetBookMove finds nothing and the search runs as normal.
+    if (info->useBook) {
+        int bookMove = GetBookMove(pos);
+        if (bookMove != NOMOVE) {
+            info->bestMove = bookMove;
+            info->bestScore = 0;
+            if (!info->quiet)
+                printf("bestmove %s (book)\n", PrMove(bookMove));
+            return;
+        }
+    }
+
+    //With a tablebase position at the root, play the move that converts fastest (or resists longest) under the 50 move rule
+    if (TBLargest && CNT(pos->occupied[BOTH]) <= info->tbProbeLimit && info->multiPV == 1) {
+        int tbMove, wdl, dtz;
+        if (SyzygyProbeRoot(pos, &tbMove, &wdl, &dtz)) {
+            info->tbHits++;
+            info->bestMove = tbMove;
+            info->bestScore = (wdl > 1)? TBWIN - dtz : (wdl < -1)? -TBWIN + dtz : 0;
+            if (!info->quiet)
+                printf("bestmove %s (tablebase wdl %d dtz %d)\n", PrMove(tbMove), wdl, dtz);
+            return;
+        }
+    }
+
+    int numLines = info->multiPV;
+    int rootMoves = CountRootMoves(pos);
+    if (rootMoves == 0) {  //The game is already over. Score the mate or stalemate without searching.
+        info->bestScore = (InCheck(pos))? -INFINITE : 0;
+        if (!info->quiet)
+            printf("bestmove %s\n", PrMove(NOMOVE));
+        return;
+    }
+    if (numLines > MAXMULTIPV) numLines = MAXMULTIPV;
+    if (numLines > rootMoves)  numLines = rootMoves;
+    if (numLines < 1)          numLines = 1;
+
+    long lastNodes = 0;
+    int prevScores[MAXMULTIPV] = {0};
+    S_PVLINE lines[MAXMULTIPV];
+
+    for (int currentDepth = 1; currentDepth <= info->depth && currentDepth < MAXDEPTH; ++currentDepth) {
+        long startNodes = info->nodes;
+        int found = 0;
+
+        for (int pvIdx = 0; pvIdx < numLines; ++pvIdx) {
+            info->numExcluded = pvIdx;
+            int score = SearchRoot(currentDepth, prevScores[pvIdx], pos, info);
+
+            if (info->stopped)
+                break;
+
+            //The line is rebuilt from the table. Its first move is the best root move not yet excluded.
+            S_PVLINE *line = &lines[pvIdx];
+            line->score = score;
+            line->count = GetPvLine(currentDepth, pos);
+            for (int i = 0; i < line->count; ++i)
+                line->moves[i] = pos->PvArray[i];
+
+            if (line->count == 0)
+                break;
+            info->excluded[pvIdx] = line->moves[0];
+            found++;
+        }
+        info->numExcluded = 0;
 
-}
\ No newline at end of file
+        //A partial iteration can't be compared against the complete one before it
+        if (info->stopped || found == 0)
+            break;
+
+        //Pruning can let a later line outscore an earlier one, so order the lines by score
+        for (int i = 1; i < found; ++i) {
+            S_PVLINE tmp = lines[i];
+            int j = i - 1;
+            for (; j >= 0 && lines[j].score < tmp.score; --j)
+                lines[j + 1] = lines[j];
+            lines[j + 1] = tmp;
+        }
+
+        info->pvCount = found;
+        for (int i = 0; i < found; ++i) {
+            info->lines[i] = lines[i];
+            prevScores[i] = lines[i].score;
+        }
+        info->bestMove = lines[0].moves[0];
+        info->bestScore = lines[0].score;
+
+        S_ITERATION *iter = &info->iter[info->iterations++];
+        iter->move = info->bestMove;
+        iter->score = info->bestScore;
+        iter->time = GetTimeMs() - info->starttime;
+        iter->nodes = info->nodes;
+
+        long iterNodes = info->nodes - startNodes;
+        if (!info->quiet) {
+            for (int i = 0; i < found; ++i) {
+                printf("Depth %d", currentDepth);
+                if (numLines > 1)
+                    printf(" multipv %d", i + 1);
+                printf(" score %d nodes %ld time %d", lines[i].score, info->nodes, GetTimeMs() - info->starttime);
+                if (lastNodes > 0 && i == 0)
+                    printf(" ebf %.2f", (double)iterNodes / lastNodes);  //Effective branching factor of this iteration
+                printf(" pv");
+                for (int m = 0; m < lines[i].count; ++m)
+                    printf(" %s", PrMove(lines[i].moves[m]));
+                printf("\n");
+            }
+        }
+        lastNodes = iterNodes;
+    }
+
+    if (!info->quiet) {
+        printf("Ordering: %.2f%% of cutoffs on the first move\n", (info->fh)? 100.0 * info->fhf / info->fh : 0.0);
+        printf("Null move: %ld tried, %ld cut   LMR: %ld reduced, %ld re-searched\n",
+               info->nullTries, info->nullCutoffs, info->lmrReduced, info->lmrResearched);
+        printf("Futility: %ld pruned   Reverse futility: %ld pruned   Check extensions: %ld\n",
+               info->futilityPruned, info->rfpPruned, info->checkExtended);
+        printf("PVS: %ld re-searched   Aspiration: %ld failed low, %ld failed high   Tablebase hits: %ld\n",
+               info->pvsResearched, info->aspFailLow, info->aspFailHigh, info->tbHits);
+        printf("bestmove %s\n", PrMove(info->bestMove));
+        ProfileReport("search");
+    }
+}
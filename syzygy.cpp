@@ -0,0 +1,120 @@
+//syzygy.cpp
+
+#include "defs.h"
+
+#include <iostream>
+
+//Syzygy tablebases are probed by tbprobe.cpp, which maps the table files into memory itself.
+
+using namespace std;
+
+int TBLargest = 0;  //Most pieces (kings included) of the tables found by SyzygyInit. 0 when no tables are loaded.
+
+
+/*
+    Name:    SyzygyInit
+    Vars:    const char *path - Directory of the tables. Several can be given separated by ':' (';' on Windows).
+    Purpose: Load the tablebases so search and the root can probe them.
+    Returns: The most pieces the loaded tables cover, 0 if none were found.
+*/
+int SyzygyInit(const char *path) {
+    TBLargest = TBInit(path);
+    if (TBLargest == 0)
+        cout << "Syzygy: could not load tables from " << path << endl;
+    else
+        cout << "Syzygy: " << TBLargest << " piece tables loaded from " << path << endl;
+    return TBLargest;
+}
+
+
+/*
+    Name:    SyzygyFree
+    Purpose: Unmap the tables.
+*/
+void SyzygyFree() {
+    TBFree();
+    TBLargest = 0;
+}
+
+
+/*
+    Name:    SyzygyProbeWdl
+    Vars:    S_BOARD *pos - Pointer to a position.
+             int *wdl     - Set to the result for the side to move: 2 win, 1 win spoiled by the 50 move rule,
+                            0 draw, -1 loss saved by the 50 move rule, -2 loss.
+    Purpose: Probe the win/draw/loss tables. The tables assume no castling rights and a fifty move count of zero,
+             so only positions straight after a capture or pawn move (the ones search can't have probed already) qualify.
+    Returns: TRUE if the position was found.
+*/
+int SyzygyProbeWdl(S_BOARD *pos, int *wdl) {
+    if (pos->castlePerm || pos->fiftyMove || CNT(pos->occupied[BOTH]) > TBLargest)
+        return FALSE;
+
+    int success;
+    *wdl = TBProbeWdl(pos, &success);
+    return success;
+}
+
+
+/*
+    Name:    SyzygyProbeRoot
+    Vars:    S_BOARD *pos - Pointer to a position.
+             int *move    - Set to the move to play.
+             int *wdl     - Set to the result for the side to move, as for SyzygyProbeWdl.
+             int *dtz     - Set to the distance to zeroing (plies to the next capture or pawn move) after the move.
+    Purpose: Probe the distance-to-zero tables at the root. Play the move that keeps the best result and, when
+             winning, reaches the next zeroing move fastest, so a won ending is converted within the 50 move rule.
+             When losing, the move that holds out longest, so a slip by the opponent can still save the game.
+    Returns: TRUE if the position was found.
+*/
+int SyzygyProbeRoot(S_BOARD *pos, int *move, int *wdl, int *dtz) {
+    if (pos->castlePerm || CNT(pos->occupied[BOTH]) > TBLargest)
+        return FALSE;
+
+    const int MaxRank = 1000000;
+    int cnt50 = pos->fiftyMove;
+    int bestMove = NOMOVE, bestRank = -MaxRank - 1, bestDtz = 0;
+
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        int m = list->moves[moveNum].move;
+        if (!MakeMove(pos, m))
+            continue;
+
+        //The move's DTZ counted from the root. A zeroing move only needs the result after it.
+        int success = TRUE, moveDtz;
+        if (pos->fiftyMove == 0) {
+            int moveWdl = -TBProbeWdl(pos, &success);
+            moveDtz = (moveWdl == 2)? 1 : (moveWdl == 1)? 101 : (moveWdl == -1)? -101 : (moveWdl == -2)? -1 : 0;
+        } else if (IsRepetition(pos) || pos->fiftyMove >= 100)
+            moveDtz = 0;
+        else {
+            moveDtz = -TBProbeDtz(pos, &success);
+            moveDtz += (moveDtz > 0) - (moveDtz < 0);
+        }
+        if (moveDtz == 2 && InCheck(pos) && !HasLegalMove(pos))  //Mate
+            moveDtz = 1;
+        TakeMove(pos);
+        if (!success)
+            return FALSE;
+
+        //Wins the 50 move rule allows rank equal above the rest, then sooner zeroing first. Losses the rule can't save
+        //rank equal below the rest, then later zeroing first.
+        int rank = (moveDtz > 0)? ((moveDtz + cnt50 <= 99)? MaxRank : MaxRank - (moveDtz + cnt50))
+                 : (moveDtz < 0)? ((-moveDtz * 2 + cnt50 < 100)? -MaxRank : -MaxRank + (-moveDtz + cnt50))
+                 : 0;
+        if (rank > bestRank || (rank == bestRank && moveDtz < bestDtz)) {
+            bestMove = m;
+            bestRank = rank;
+            bestDtz = moveDtz;
+        }
+    }
+    if (bestMove == NOMOVE)  //Mate or stalemate: nothing to play
+        return FALSE;
+
+    *move = bestMove;
+    *dtz = abs(bestDtz);
+    *wdl = (bestDtz > 0)? ((bestDtz + cnt50 <= 100)? 2 : 1) : (bestDtz < 0)? ((-bestDtz + cnt50 <= 100)? -2 : -1) : 0;
+    return TRUE;
+}
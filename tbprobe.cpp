@@ -0,0 +1,1877 @@
+//tbprobe.cpp
+
+//The Syzygy tablebase prober, built into every build. Table files are memory mapped and read in place.
+//A file holds, for each table (one per side to move, and per leading pawn file when there are pawns), the order the
+//pieces are encoded in and a stream of values. The values are compressed by recursive pairing, where the most frequent
+//pair of symbols keeps being replaced by a new symbol, and the symbols are then stored as canonical Huffman codes in
+//fixed size blocks. A probe turns the position into an index and decodes that one value.
+//WDL files (.rtbw) hold the win/draw/loss of every position, DTZ files (.rtbz) the distance to the next capture or
+//pawn move for one side to move. Both leave out positions the probe settles by looking at the captures itself.
+
+#include "defs.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#define TB_PIECES 7     //Most pieces, kings included, a table can have
+
+//The first bytes of WDL and DTZ files
+static const unsigned char WdlMagic[4] = {0x71, 0xE8, 0x23, 0x5D};
+static const unsigned char DtzMagic[4] = {0xD7, 0x66, 0x0C, 0xA5};
+
+//Flags of each table in a file
+enum {TBF_STM = 1, TBF_MAPPED = 2, TBF_WINPLIES = 4, TBF_LOSSPLIES = 8, TBF_WIDE = 16, TBF_SINGLEVALUE = 128};
+
+//How a probe ended
+enum {TBP_FAIL, TBP_OK, TBP_CHANGESTM, TBP_ZEROING};
+
+//Win/draw/loss for the side to move. Cursed wins and blessed losses are spoiled by the 50 move rule.
+enum {TB_LOSS = -2, TB_BLESSEDLOSS, TB_DRAW, TB_CURSEDWIN, TB_WIN};
+
+//The files number pieces white pawn 1 .. white king 6 and black pawn 9 .. black king 14, so bit 3 is the colour
+static const int TBPieceCode[13] = {0, 1, 2, 3, 4, 5, 6, 9, 10, 11, 12, 13, 14};
+
+//One compressed table
+typedef struct {
+    int flags;
+    int pieces[TB_PIECES];          //The order the pieces are encoded in, as file piece codes
+    int groupLen[TB_PIECES + 1];    //Pieces encoded together, 0 terminated
+    U64 groupIdx[TB_PIECES + 1];    //What an index step of each group is worth. The last one is the table size.
+    U64 blockSize;                  //Bytes per block of Huffman codes
+    U64 span;                       //Values between two entries of the sparse index
+    U64 sparseIndexSize;
+    U64 numBlocks;
+    U64 blockLengthSize;
+    int minSymLen, maxSymLen;       //Shortest and longest code. minSymLen is the value of a single valued table.
+    const unsigned char *lowestSym; //Lowest symbol of each code length, 16 bit little-endian
+    vector<U64> base64;             //Lowest code of each length, left aligned in 64 bits
+    vector<unsigned char> symLen;   //Values a symbol expands to, less one
+    const unsigned char *btree;     //The pair each symbol stands for, two 12 bit symbols in 3 bytes
+    const unsigned char *sparseIndex;   //6 byte entries: the block and the offset in it of every span-th value
+    const unsigned char *blockLength;   //Values in each block, less one, 16 bit little-endian
+    const unsigned char *data;          //The blocks
+    int mapIdx[4];                  //DTZ only: where the value maps for wins, losses, cursed wins and blessed losses start
+} S_TBPAIRS;
+
+//A memory mapped file
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+#ifdef WIN32
+    HANDLE file, mapping;
+#endif
+} S_TBFILE;
+
+//One material balance. Ex. KQvKR, which also answers KRvKQ with the colours swapped.
+typedef struct {
+    string name;
+    U64 key;            //Material of the name as written, white the first side
+    U64 key2;           //The same with the colours swapped. Equal to key for symmetric tables.
+    int pieceCount;
+    int hasPawns;
+    int hasUniquePieces;//A side has exactly one of some piece, so three pieces can be encoded together
+    int pawnCount[2];   //Pawns of the leading colour (the side with fewer pawns, if both have some) and of the other
+    S_TBFILE wdlFile, dtzFile;
+    int hasDtz;
+    S_TBPAIRS wdl[4][2];//By leading pawn file and side to move
+    S_TBPAIRS dtz[4];   //By leading pawn file. DTZ tables hold one side to move.
+    const unsigned char *dtzMap;
+} S_TBENTRY;
+
+static vector<S_TBENTRY *> TBEntries;
+static unordered_map<U64, S_TBENTRY *> TBByKey;
+
+//Encoding tables, filled by TBInitTables
+static int MapB1H1H7[64];   //Squares below the a1-h8 diagonal to 0..27
+static int MapA1D1D4[64];   //The a1-d1-d4 triangle to 0..9, the diagonal last
+static int MapKK[10][64];   //Both kings to 0..461
+static int MapPawns[64];    //a2-h7 to 0..47, higher for pawns nearer the edge and lower on the board
+static U64 Binomial[TB_PIECES - 1][64];
+static U64 LeadPawnIdx[TB_PIECES - 1][64];
+static U64 LeadPawnsSize[TB_PIECES - 1][4];
+
+static inline int OffA1H8(int sq) { return (sq >> 3) - (sq & 7); }
+static inline unsigned Le16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+static inline unsigned Le32(const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24); }
+static inline unsigned Be32(const unsigned char *p) { return ((unsigned)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static inline U64 Be64(const unsigned char *p) { return ((U64)Be32(p) << 32) | Be32(p + 4); }
+static inline int BtreeLeft(const unsigned char *b, int s)  { return ((b[3 * s + 1] & 0xF) << 8) | b[3 * s]; }
+static inline int BtreeRight(const unsigned char *b, int s) { return (b[3 * s + 2] << 4) | (b[3 * s + 1] >> 4); }
+
+
+/*
+    Name:    TBInitTables
+    Purpose: Fill the tables that turn piece squares into an index. The numbering has to be exactly the one the table
+             generator used, so it is built the same way: squares are numbered in a1..h8 order within each region.
+*/
+static void TBInitTables() {
+    int code = 0;
+    for (int sq = 0; sq < 64; ++sq)
+        if (OffA1H8(sq) < 0)
+            MapB1H1H7[sq] = code++;
+
+    code = 0;
+    vector<int> diagonal;
+    for (int sq = 0; sq <= 27; ++sq) {  //a1..d4
+        if (OffA1H8(sq) < 0 && (sq & 7) <= 3)
+            MapA1D1D4[sq] = code++;
+        else if (OffA1H8(sq) == 0 && (sq & 7) <= 3)
+            diagonal.push_back(sq);
+    }
+    for (int sq : diagonal)
+        MapA1D1D4[sq] = code++;
+
+    //Both kings. With the first king on the diagonal the second is kept on or below it, and the pairs with both on
+    //the diagonal come last.
+    code = 0;
+    vector<pair<int, int>> bothOnDiagonal;
+    for (int idx = 0; idx < 10; ++idx) {
+        for (int s1 = 0; s1 <= 27; ++s1) {
+            if ((s1 & 7) > 3 || OffA1H8(s1) > 0 || MapA1D1D4[s1] != idx || (idx == 0 && s1 != 1))
+                continue;
+            for (int s2 = 0; s2 < 64; ++s2) {
+                if (s2 == s1 || (KingAttacks[s1] & SetMask[s2]))
+                    continue;
+                if (OffA1H8(s1) == 0 && OffA1H8(s2) > 0)
+                    continue;
+                if (OffA1H8(s1) == 0 && OffA1H8(s2) == 0)
+                    bothOnDiagonal.push_back({idx, s2});
+                else
+                    MapKK[idx][s2] = code++;
+            }
+        }
+    }
+    for (auto &p : bothOnDiagonal)
+        MapKK[p.first][p.second] = code++;
+    ASSERT(code == 462);
+
+    Binomial[0][0] = 1;
+    for (int n = 1; n < 64; ++n)
+        for (int k = 0; k < TB_PIECES - 1 && k <= n; ++k)
+            Binomial[k][n] = ((k > 0)? Binomial[k - 1][n - 1] : 0) + ((k < n)? Binomial[k][n - 1] : 0);
+
+    //Lead pawns. The tables are split by the leading pawn's file, so each file counts from 0 again.
+    int available = 47;
+    for (int count = 1; count < TB_PIECES - 1; ++count) {
+        for (int file = 0; file < 4; ++file) {
+            U64 idx = 0;
+            for (int rank = 1; rank <= 6; ++rank) {
+                int sq = rank * 8 + file;
+                if (count == 1) {
+                    MapPawns[sq] = available--;
+                    MapPawns[sq ^ 7] = available--;
+                }
+                LeadPawnIdx[count][sq] = idx;
+                idx += Binomial[count - 1][MapPawns[sq]];
+            }
+            LeadPawnsSize[count][file] = idx;
+        }
+    }
+}
+
+
+/*
+    Name:    MaterialKey
+    Vars:    const int counts[2][5] - Pawns, knights, bishops, rooks and queens of each side.
+    Returns: A key that is the same for every position with this material.
+*/
+static U64 MaterialKey(const int counts[2][5]) {
+    U64 key = 0;
+    for (int type = 0; type < 5; ++type)
+        key |= ((U64)counts[WHITE][type] << (4 * type)) | ((U64)counts[BLACK][type] << (4 * (type + 5)));
+    return key;
+}
+
+static U64 PositionKey(const S_BOARD *pos) {
+    int counts[2][5];
+    for (int type = 0; type < 5; ++type) {
+        counts[WHITE][type] = pos->pceNum[wP + type];
+        counts[BLACK][type] = pos->pceNum[bP + type];
+    }
+    return MaterialKey(counts);
+}
+
+
+/*
+    Name:    UnmapFile
+    Vars:    S_TBFILE *f - A mapping made by MapFile. Cleared.
+*/
+static void UnmapFile(S_TBFILE *f) {
+    if (f->data == NULL)
+        return;
+#ifdef WIN32
+    UnmapViewOfFile(f->data);
+    CloseHandle(f->mapping);
+    CloseHandle(f->file);
+#else
+    munmap((void *)f->data, f->size);
+#endif
+    *f = {};
+}
+
+
+/*
+    Name:    MapFile
+    Vars:    const string &file - The table file.
+             S_TBFILE *f        - Set to the mapping.
+             const unsigned char *magic - The 4 bytes the file must start with.
+    Returns: TRUE if the file was mapped and looks like a table.
+*/
+static int MapFile(const string &file, S_TBFILE *f, const unsigned char *magic) {
+    *f = {};
+#ifdef WIN32
+    HANDLE h = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return FALSE;
+    LARGE_INTEGER size;
+    GetFileSizeEx(h, &size);
+    HANDLE mapping = (size.QuadPart > 0)? CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    const unsigned char *data = (mapping)? (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (data == NULL) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(h);
+        return FALSE;
+    }
+    f->file = h;
+    f->mapping = mapping;
+    f->size = (size_t)size.QuadPart;
+#else
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+        return FALSE;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return FALSE;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return FALSE;
+    madvise(data, st.st_size, MADV_RANDOM);
+    f->size = (size_t)st.st_size;
+#endif
+    f->data = (const unsigned char *)data;
+
+    //Files are padded so their size is 16 more than a multiple of 64
+    if (f->size % 64 != 16 || memcmp(f->data, magic, 4) != 0) {
+        cout << "Syzygy: " << file << " is not a tablebase file" << endl;
+        UnmapFile(f);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/*
+    Name:    SetGroups
+    Vars:    const S_TBENTRY *e - The material balance.
+             S_TBPAIRS *d       - A table whose pieces are read. Its groups are set.
+             const int order[2] - Which group is encoded first (the leading one) and which second (the other pawns).
+             int file           - The leading pawn's file, 0 without pawns.
+    Purpose: Split the pieces into groups and work out what a step of each group's index is worth. The leading group
+             (the kings, three unique pieces, or the leading pawns) is encoded together and every further group of
+             identical pieces as a combination of the squares left, so the index is a number in the table's base.
+*/
+static void SetGroups(const S_TBENTRY *e, S_TBPAIRS *d, const int order[2], int file) {
+    int n = 0, firstLen = (e->hasPawns)? 0 : (e->hasUniquePieces)? 3 : 2;
+    d->groupLen[n] = 1;
+    for (int i = 1; i < e->pieceCount; ++i) {
+        if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1])
+            d->groupLen[n]++;
+        else
+            d->groupLen[++n] = 1;
+    }
+    d->groupLen[++n] = 0;
+
+    int pp = e->hasPawns && e->pawnCount[1];    //Pawns on both sides. The other side's pawns are the second group.
+    int next = (pp)? 2 : 1;
+    int freeSquares = 64 - d->groupLen[0] - ((pp)? d->groupLen[1] : 0);
+    U64 idx = 1;
+
+    for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+        if (k == order[0]) {
+            d->groupIdx[0] = idx;
+            idx *= (e->hasPawns)? LeadPawnsSize[d->groupLen[0]][file] : (e->hasUniquePieces)? 31332 : 462;
+        } else if (k == order[1]) {
+            d->groupIdx[1] = idx;
+            idx *= Binomial[d->groupLen[1]][48 - d->groupLen[0]];
+        } else {
+            d->groupIdx[next] = idx;
+            idx *= Binomial[d->groupLen[next]][freeSquares];
+            freeSquares -= d->groupLen[next++];
+        }
+    }
+    d->groupIdx[n] = idx;
+}
+
+
+/*
+    Name:    SetSymLen
+    Purpose: Count the values a symbol expands to, less one. A symbol is either a value (a leaf) or a pair of symbols.
+*/
+static int SetSymLen(S_TBPAIRS *d, int sym, vector<char> &visited) {
+    visited[sym] = TRUE;
+    int right = BtreeRight(d->btree, sym);
+    if (right == 0xFFF)
+        return 0;
+    int left = BtreeLeft(d->btree, sym);
+    if (!visited[left])
+        d->symLen[left] = SetSymLen(d, left, visited);
+    if (!visited[right])
+        d->symLen[right] = SetSymLen(d, right, visited);
+    return d->symLen[left] + d->symLen[right] + 1;
+}
+
+
+/*
+    Name:    SetSizes
+    Vars:    S_TBPAIRS *d              - A table with its groups set.
+             const unsigned char *data - Its Huffman code header.
+    Purpose: Read the sizes of the table's blocks and indexes and its code tables.
+    Returns: Where the next header starts.
+*/
+static const unsigned char *SetSizes(S_TBPAIRS *d, const unsigned char *data) {
+    d->flags = *data++;
+    if (d->flags & TBF_SINGLEVALUE) {
+        d->numBlocks = d->blockLengthSize = 0;
+        d->span = d->sparseIndexSize = 0;
+        d->minSymLen = *data++;
+        return data;
+    }
+
+    int n = 0;
+    while (d->groupLen[n])
+        n++;
+    U64 tbSize = d->groupIdx[n];
+
+    d->blockSize = 1ULL << *data++;
+    d->span = 1ULL << *data++;
+    d->sparseIndexSize = (tbSize + d->span - 1) / d->span;
+    int padding = *data++;
+    d->numBlocks = Le32(data);
+    data += 4;
+    d->blockLengthSize = d->numBlocks + padding;    //Padded so the sparse index never points past the end
+    d->maxSymLen = *data++;
+    d->minSymLen = *data++;
+    d->lowestSym = data;
+
+    //Canonical Huffman codes: longer codes have lower values and the codes of one length are consecutive. base64[i]
+    //is the lowest code of length minSymLen + i, so a code's length is the first i whose base it is not below.
+    int lengths = d->maxSymLen - d->minSymLen + 1;
+    d->base64.assign(lengths, 0);
+    for (int i = lengths - 2; i >= 0; --i)
+        d->base64[i] = (d->base64[i + 1] + Le16(d->lowestSym + 2 * i) - Le16(d->lowestSym + 2 * (i + 1))) / 2;
+    for (int i = 0; i < lengths; ++i)
+        d->base64[i] <<= 64 - i - d->minSymLen;
+    data += 2 * lengths;
+
+    int numSyms = Le16(data);
+    data += 2;
+    d->btree = data;
+    d->symLen.assign(numSyms, 0);
+    vector<char> visited(numSyms, FALSE);
+    for (int sym = 0; sym < numSyms; ++sym)
+        if (!visited[sym])
+            d->symLen[sym] = SetSymLen(d, sym, visited);
+
+    return data + 3 * numSyms + (numSyms & 1);
+}
+
+
+/*
+    Name:    SetDtzMap
+    Purpose: DTZ tables can store their values through a map, one for each of win, loss, cursed win and blessed loss.
+             Note where each starts.
+    Returns: Where the sparse indexes start.
+*/
+static const unsigned char *SetDtzMap(S_TBENTRY *e, const unsigned char *data, int maxFile) {
+    e->dtzMap = data;
+    for (int file = 0; file <= maxFile; ++file) {
+        S_TBPAIRS *d = &e->dtz[file];
+        if (!(d->flags & TBF_MAPPED))
+            continue;
+        if (d->flags & TBF_WIDE) {
+            data += (uintptr_t)data & 1;
+            for (int i = 0; i < 4; ++i) {
+                d->mapIdx[i] = (int)((data - e->dtzMap) / 2 + 1);
+                data += 2 * Le16(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4; ++i) {
+                d->mapIdx[i] = (int)(data - e->dtzMap + 1);
+                data += *data + 1;
+            }
+        }
+    }
+    return data + ((uintptr_t)data & 1);
+}
+
+
+/*
+    Name:    ParseFile
+    Vars:    S_TBENTRY *e - The material balance, its file mapped.
+             int dtz      - TRUE for the DTZ file, FALSE for the WDL one.
+    Purpose: Read the headers of every table in the file and point them at their data.
+    Returns: TRUE if the file matches the material balance.
+*/
+static int ParseFile(S_TBENTRY *e, int dtz) {
+    const unsigned char *data = ((dtz)? e->dtzFile.data : e->wdlFile.data) + 4;
+    const unsigned char *end = data - 4 + ((dtz)? e->dtzFile.size : e->wdlFile.size);
+
+    //The first byte says whether the file has pawns and whether it holds both sides to move
+    if (((*data & 2) != 0) != (e->hasPawns != 0) || ((*data & 1) != 0) != (e->key != e->key2))
+        return FALSE;
+    data++;
+
+    int sides = (!dtz && e->key != e->key2)? 2 : 1;
+    int maxFile = (e->hasPawns)? 3 : 0;
+    int pp = e->hasPawns && e->pawnCount[1];
+
+    for (int file = 0; file <= maxFile; ++file) {
+        int order[2][2] = {{*data & 0xF, (pp)? data[1] & 0xF : 0xF}, {*data >> 4, (pp)? data[1] >> 4 : 0xF}};
+        data += 1 + pp;
+        for (int k = 0; k < e->pieceCount; ++k, ++data)
+            for (int i = 0; i < sides; ++i)
+                ((dtz)? &e->dtz[file] : &e->wdl[file][i])->pieces[k] = (i)? *data >> 4 : *data & 0xF;
+        for (int i = 0; i < sides; ++i)
+            SetGroups(e, (dtz)? &e->dtz[file] : &e->wdl[file][i], order[i], file);
+    }
+    data += (uintptr_t)data & 1;
+
+    for (int file = 0; file <= maxFile; ++file)
+        for (int i = 0; i < sides; ++i)
+            data = SetSizes((dtz)? &e->dtz[file] : &e->wdl[file][i], data);
+
+    if (dtz)
+        data = SetDtzMap(e, data, maxFile);
+
+    for (int file = 0; file <= maxFile; ++file)
+        for (int i = 0; i < sides; ++i) {
+            S_TBPAIRS *d = (dtz)? &e->dtz[file] : &e->wdl[file][i];
+            d->sparseIndex = data;
+            data += 6 * d->sparseIndexSize;
+        }
+    for (int file = 0; file <= maxFile; ++file)
+        for (int i = 0; i < sides; ++i) {
+            S_TBPAIRS *d = (dtz)? &e->dtz[file] : &e->wdl[file][i];
+            d->blockLength = data;
+            data += 2 * d->blockLengthSize;
+        }
+    for (int file = 0; file <= maxFile; ++file)
+        for (int i = 0; i < sides; ++i) {
+            S_TBPAIRS *d = (dtz)? &e->dtz[file] : &e->wdl[file][i];
+            data = (const unsigned char *)(((uintptr_t)data + 0x3F) & ~(uintptr_t)0x3F);
+            d->data = data;
+            data += d->numBlocks * d->blockSize;
+        }
+    return data <= end;
+}
+
+
+/*
+    Name:    DecompressPairs
+    Vars:    const S_TBPAIRS *d - A table.
+             U64 idx            - The index of a position in it.
+    Returns: The value stored for the position.
+*/
+static int DecompressPairs(const S_TBPAIRS *d, U64 idx) {
+    if (d->flags & TBF_SINGLEVALUE)
+        return d->minSymLen;
+
+    //Every span-th value has a sparse index entry giving its block and its offset within the block. Start from the
+    //entry nearest idx and walk the block lengths to the block that holds it.
+    U64 k = idx / d->span;
+    unsigned block = Le32(d->sparseIndex + 6 * k);
+    long long offset = Le16(d->sparseIndex + 6 * k + 4);
+    offset += (long long)(idx % d->span) - (long long)(d->span / 2);
+
+    while (offset < 0)
+        offset += Le16(d->blockLength + 2 * --block) + 1;
+    while (offset > Le16(d->blockLength + 2 * block))
+        offset -= Le16(d->blockLength + 2 * block++) + 1;
+
+    //Read codes from the start of the block until the symbol that covers the offset
+    const unsigned char *ptr = d->data + (U64)block * d->blockSize;
+    U64 buf64 = Be64(ptr);
+    ptr += 8;
+    int buf64Size = 64;
+    int sym;
+    while (TRUE) {
+        int len = 0;
+        while (buf64 < d->base64[len])
+            ++len;
+        sym = (int)((buf64 - d->base64[len]) >> (64 - len - d->minSymLen)) + Le16(d->lowestSym + 2 * len);
+        if (offset < d->symLen[sym] + 1)
+            break;
+        offset -= d->symLen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+        if (buf64Size <= 32) {
+            buf64Size += 32;
+            buf64 |= (U64)Be32(ptr) << (64 - buf64Size);
+            ptr += 4;
+        }
+    }
+
+    //Expand the symbol's pairs down to the value at the offset
+    while (d->symLen[sym]) {
+        int left = BtreeLeft(d->btree, sym);
+        if (offset < d->symLen[left] + 1)
+            sym = left;
+        else {
+            offset -= d->symLen[left] + 1;
+            sym = BtreeRight(d->btree, sym);
+        }
+    }
+    return BtreeLeft(d->btree, sym);
+}
+
+
+/*
+    Name:    EncodePosition
+    Vars:    const S_BOARD *pos     - Pointer to a position with the material of e.
+             const S_TBENTRY *e     - The material balance.
+             int dtz                - TRUE for the DTZ table, FALSE for the WDL one.
+             const S_TBPAIRS **table - Set to the table the position is in.
+             int *result            - Set to TBP_CHANGESTM if the DTZ table is for the other side to move.
+    Purpose: Turn the position into its index in the table. The tables are stored with white the stronger side, so a
+             position with the colours the other way round is flipped top to bottom first, and the symmetries of the
+             board (left-right, and without pawns top-bottom and the diagonal) are folded away.
+    Returns: The index.
+*/
+static U64 EncodePosition(const S_BOARD *pos, const S_TBENTRY *e, int dtz, const S_TBPAIRS **table, int *result) {
+    U64 key = PositionKey(pos);
+
+    int squares[TB_PIECES], pieces[TB_PIECES];
+    int size = 0, leadPawnsCnt = 0, tbFile = 0;
+    U64 leadPawns = 0;
+
+    int flip = (e->key == e->key2 && pos->side == BLACK) || key != e->key;
+    int flipColour = (flip)? 8 : 0, flipSquares = (flip)? 56 : 0;
+    int stm = flip ^ pos->side;
+
+    //The lead pawns are those of the colour of the first piece in the tables. Their leader, the one nearest the edge
+    //and then lowest, picks the table.
+    if (e->hasPawns) {
+        int pawn = ((dtz)? e->dtz[0].pieces[0] : e->wdl[0][0].pieces[0]) ^ flipColour;
+        U64 b = leadPawns = pos->pceBB[(pawn & 8)? bP : wP];
+        while (b)
+            squares[size++] = POP(&b) ^ flipSquares;
+        leadPawnsCnt = size;
+        int *lead = max_element(squares, squares + leadPawnsCnt, [](int a, int b) { return MapPawns[a] < MapPawns[b]; });
+        swap(squares[0], *lead);
+        tbFile = min(squares[0] & 7, 7 - (squares[0] & 7));
+    }
+
+    const S_TBPAIRS *d = *table = (dtz)? &e->dtz[tbFile] : &e->wdl[tbFile][stm];
+    if (dtz && (d->flags & TBF_STM) != stm && !(e->key == e->key2 && !e->hasPawns)) {
+        *result = TBP_CHANGESTM;
+        return 0;
+    }
+
+    U64 b = pos->occupied[BOTH] ^ leadPawns;
+    while (b) {
+        int sq = POP(&b);
+        squares[size] = sq ^ flipSquares;
+        pieces[size++] = TBPieceCode[pos->pieces[SQ120(sq)]] ^ flipColour;
+    }
+
+    //Put the pieces in the order the table encodes them
+    for (int i = leadPawnsCnt; i < size - 1; ++i)
+        for (int j = i + 1; j < size; ++j)
+            if (d->pieces[i] == pieces[j]) {
+                swap(pieces[i], pieces[j]);
+                swap(squares[i], squares[j]);
+                break;
+            }
+
+    if ((squares[0] & 7) > 3)
+        for (int i = 0; i < size; ++i)
+            squares[i] ^= 7;
+
+    U64 idx;
+    if (e->hasPawns) {
+        idx = LeadPawnIdx[leadPawnsCnt][squares[0]];
+        stable_sort(squares + 1, squares + leadPawnsCnt, [](int a, int b) { return MapPawns[a] < MapPawns[b]; });
+        for (int i = 1; i < leadPawnsCnt; ++i)
+            idx += Binomial[i][MapPawns[squares[i]]];
+    } else {
+        if ((squares[0] >> 3) > 3)
+            for (int i = 0; i < size; ++i)
+                squares[i] ^= 56;
+
+        //The first piece of the leading group off the a1-h8 diagonal goes below it
+        for (int i = 0; i < d->groupLen[0]; ++i) {
+            if (!OffA1H8(squares[i]))
+                continue;
+            if (OffA1H8(squares[i]) > 0)
+                for (int j = i; j < size; ++j)
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            break;
+        }
+
+        if (e->hasUniquePieces) {
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (OffA1H8(squares[0]))
+                idx = (MapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            else if (OffA1H8(squares[1]))
+                idx = (6 * 63 + (squares[0] >> 3) * 28 + MapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            else if (OffA1H8(squares[2]))
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] >> 3) * 7 * 28 + ((squares[1] >> 3) - adjust1) * 28
+                    + MapB1H1H7[squares[2]];
+            else
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (squares[0] >> 3) * 7 * 6
+                    + ((squares[1] >> 3) - adjust1) * 6 + ((squares[2] >> 3) - adjust2);
+        } else
+            idx = MapKK[MapA1D1D4[squares[0]]][squares[1]];
+    }
+
+    //The other groups are combinations of the squares the earlier groups leave free, pawns only having 48
+    idx *= d->groupIdx[0];
+    int *groupSq = squares + d->groupLen[0];
+    int remainingPawns = e->hasPawns && e->pawnCount[1];
+    for (int next = 1; d->groupLen[next]; ++next) {
+        sort(groupSq, groupSq + d->groupLen[next]);
+        U64 n = 0;
+        for (int i = 0; i < d->groupLen[next]; ++i) {
+            int adjust = (int)count_if(squares, groupSq, [&](int sq) { return groupSq[i] > sq; });
+            n += Binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+        }
+        remainingPawns = FALSE;
+        idx += n * d->groupIdx[next];
+        groupSq += d->groupLen[next];
+    }
+
+    return idx;
+}
+
+
+/*
+    Name:    ProbeTable
+    Vars:    S_BOARD *pos - Pointer to a position without castling rights.
+             int dtz      - TRUE to read the DTZ table, FALSE for the WDL one.
+             int wdl      - For DTZ: the position's win/draw/loss, which picks the value map.
+             int *result  - Set to TBP_FAIL if there is no table, TBP_CHANGESTM if the DTZ table is for the other side to move.
+    Returns: The WDL (TB_LOSS .. TB_WIN) or the DTZ in plies stored for the position.
+*/
+static int ProbeTable(const S_BOARD *pos, int dtz, int wdl, int *result) {
+    if (CNT(pos->occupied[BOTH]) == 2)  //KvK
+        return 0;
+
+    auto it = TBByKey.find(PositionKey(pos));
+    if (it == TBByKey.end() || (dtz && !it->second->hasDtz)) {
+        *result = TBP_FAIL;
+        return 0;
+    }
+    const S_TBENTRY *e = it->second;
+    const S_TBPAIRS *d;
+    U64 idx = EncodePosition(pos, e, dtz, &d, result);
+    if (*result == TBP_CHANGESTM)
+        return 0;
+
+    int value = DecompressPairs(d, idx);
+    if (!dtz)
+        return value - 2;
+
+    //DTZ values are mapped and counted in moves unless the flags say plies
+    static const int WdlMap[5] = {1, 3, 0, 2, 0};
+    if (d->flags & TBF_MAPPED) {
+        int at = d->mapIdx[WdlMap[wdl + 2]] + value;
+        value = (d->flags & TBF_WIDE)? (int)Le16(e->dtzMap + 2 * at) : e->dtzMap[at];
+    }
+    if ((wdl == TB_WIN && !(d->flags & TBF_WINPLIES)) || (wdl == TB_LOSS && !(d->flags & TBF_LOSSPLIES))
+        || wdl == TB_CURSEDWIN || wdl == TB_BLESSEDLOSS)
+        value *= 2;
+    return value + 1;
+}
+
+
+static inline int IsZeroing(const S_BOARD *pos, int move) {
+    return (move & MFLAGCAP) || PiecePawn[pos->pieces[FROMSQ(move)]];
+}
+
+
+/*
+    Name:    SearchWdl
+    Vars:    S_BOARD *pos      - Pointer to a position.
+             int *result       - Set to TBP_FAIL if a table is missing, TBP_ZEROING if a capture (or with checkZeroing a pawn
+                                 move) is the best move, else TBP_OK.
+             int checkZeroing  - Also try pawn moves, for DTZ which does not store positions won by a pawn move.
+    Purpose: The tables leave out (store a "don't care" value for) positions where a capture does at least as well as
+             anything else, so captures are searched first and the table is only trusted when it promises more.
+    Returns: TB_LOSS .. TB_WIN for the side to move.
+*/
+static int SearchWdl(S_BOARD *pos, int *result, int checkZeroing) {
+    int value, bestValue = TB_LOSS;
+    int totalCount = 0, moveCount = 0;
+
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        int move = list->moves[moveNum].move;
+        int zeroing = (move & MFLAGCAP) || (checkZeroing && PiecePawn[pos->pieces[FROMSQ(move)]]);
+        if (!MakeMove(pos, move))
+            continue;
+        totalCount++;
+        if (!zeroing) {
+            TakeMove(pos);
+            continue;
+        }
+        moveCount++;
+        value = -SearchWdl(pos, result, FALSE);
+        TakeMove(pos);
+        if (*result == TBP_FAIL)
+            return TB_DRAW;
+        if (value > bestValue) {
+            bestValue = value;
+            if (value >= TB_WIN) {
+                *result = TBP_ZEROING;
+                return value;
+            }
+        }
+    }
+
+    //With every legal move searched the table isn't needed, and may be wrong (it ignores en passant)
+    int noMoreMoves = (moveCount && moveCount == totalCount);
+    if (noMoreMoves)
+        value = bestValue;
+    else {
+        value = ProbeTable(pos, FALSE, TB_DRAW, result);
+        if (*result == TBP_FAIL)
+            return TB_DRAW;
+    }
+
+    if (bestValue >= value) {
+        *result = (bestValue > TB_DRAW || noMoreMoves)? TBP_ZEROING : TBP_OK;
+        return bestValue;
+    }
+    *result = TBP_OK;
+    return value;
+}
+
+
+//The DTZ of a position whose best move zeroes the fifty move count, from its WDL
+static int DtzBeforeZeroing(int wdl) {
+    return (wdl == TB_WIN)? 1 : (wdl == TB_CURSEDWIN)? 101 : (wdl == TB_BLESSEDLOSS)? -101 : (wdl == TB_LOSS)? -1 : 0;
+}
+
+
+/*
+    Name:    TBProbeWdl
+    Vars:    S_BOARD *pos - Pointer to a position without castling rights. Its fifty move count is taken as 0.
+             int *success - Set to FALSE if a table needed is missing.
+    Returns: TB_LOSS .. TB_WIN (-2 .. 2) for the side to move.
+*/
+int TBProbeWdl(S_BOARD *pos, int *success) {
+    int result = TBP_OK;
+    int wdl = SearchWdl(pos, &result, FALSE);
+    *success = (result != TBP_FAIL);
+    return wdl;
+}
+
+
+/*
+    Name:    TBProbeDtz
+    Vars:    S_BOARD *pos - Pointer to a position without castling rights. Its fifty move count is taken as 0.
+             int *success - Set to FALSE if a table needed is missing.
+    Purpose: The distance to zeroing: plies to the next capture or pawn move with best play, keeping the result.
+             A DTZ table only holds one side to move, so for the other a ply is searched.
+    Returns: Positive when winning, negative when losing, 0 for a draw. Past 100 the fifty move rule spoils the result.
+*/
+int TBProbeDtz(S_BOARD *pos, int *success) {
+    int result = TBP_OK;
+    *success = TRUE;
+    int wdl = SearchWdl(pos, &result, TRUE);
+    if (result == TBP_FAIL) {
+        *success = FALSE;
+        return 0;
+    }
+    if (wdl == TB_DRAW)
+        return 0;
+    if (result == TBP_ZEROING)
+        return DtzBeforeZeroing(wdl);
+
+    int dtz = ProbeTable(pos, TRUE, wdl, &result);
+    if (result == TBP_FAIL) {
+        *success = FALSE;
+        return 0;
+    }
+    if (result != TBP_CHANGESTM)
+        return (dtz + ((wdl == TB_BLESSEDLOSS || wdl == TB_CURSEDWIN)? 100 : 0)) * ((wdl > 0)? 1 : -1);
+
+    //Stored for the other side to move: take the best of the moves, each a ply further
+    int minDtz = 0xFFFF;
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        int move = list->moves[moveNum].move;
+        int zeroing = IsZeroing(pos, move);
+        if (!MakeMove(pos, move))
+            continue;
+        //A zeroing move's DTZ is that of the position before it, so only the result after it is needed
+        if (zeroing) {
+            result = TBP_OK;
+            dtz = -DtzBeforeZeroing(SearchWdl(pos, &result, FALSE));
+        } else
+            dtz = -TBProbeDtz(pos, success);
+        if (dtz == 1 && InCheck(pos) && !HasLegalMove(pos))
+            minDtz = 1;
+        if (!zeroing)
+            dtz += (dtz > 0) - (dtz < 0);
+        if (dtz < minDtz && (dtz > 0) == (wdl > 0) && dtz != 0)
+            minDtz = dtz;
+        TakeMove(pos);
+        if (result == TBP_FAIL || !*success) {
+            *success = FALSE;
+            return 0;
+        }
+    }
+    return (minDtz == 0xFFFF)? -1 : minDtz;
+}
+
+
+/*
+    Name:    NewEntry
+    Vars:    const string &name - A material balance like KRPvKR.
+    Purpose: Work out the keys and piece counts of a balance, before any of its files are read.
+    Returns: The new entry.
+*/
+static S_TBENTRY *NewEntry(const string &name) {
+    static const string Letters = "PNBRQ";
+
+    int counts[2][5] = {}, swapped[2][5];
+    int side = 0, pieceCount = 0;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == 'v') {
+            side = 1;
+            continue;
+        }
+        pieceCount++;
+        if (name[i] != 'K')
+            counts[side][Letters.find(name[i])]++;
+    }
+    for (int type = 0; type < 5; ++type) {
+        swapped[WHITE][type] = counts[BLACK][type];
+        swapped[BLACK][type] = counts[WHITE][type];
+    }
+
+    S_TBENTRY *e = new S_TBENTRY();
+    e->name = name;
+    e->key = MaterialKey(counts);
+    e->key2 = MaterialKey(swapped);
+    e->pieceCount = pieceCount;
+    e->hasPawns = counts[WHITE][0] || counts[BLACK][0];
+    for (int colour = 0; colour < 2; ++colour)
+        for (int type = 0; type < 5; ++type)
+            if (counts[colour][type] == 1)
+                e->hasUniquePieces = TRUE;
+    int white = !counts[BLACK][0] || (counts[WHITE][0] && counts[BLACK][0] >= counts[WHITE][0]);
+    e->pawnCount[0] = counts[(white)? WHITE : BLACK][0];
+    e->pawnCount[1] = counts[(white)? BLACK : WHITE][0];
+    return e;
+}
+
+
+/*
+    Name:    AddTable
+    Vars:    const string &name - A material balance like KRPvKR.
+             const vector<string> &dirs - The table directories.
+    Purpose: Map and read the balance's WDL file and, if there is one, its DTZ file.
+    Returns: TRUE if the WDL file was loaded.
+*/
+static int AddTable(const string &name, const vector<string> &dirs) {
+    S_TBENTRY *e = NewEntry(name);
+    for (const string &dir : dirs)
+        if (!e->wdlFile.data && MapFile(dir + "/" + name + ".rtbw", &e->wdlFile, WdlMagic) && !ParseFile(e, FALSE)) {
+            cout << "Syzygy: " << name << ".rtbw does not match its name" << endl;
+            UnmapFile(&e->wdlFile);
+        }
+    if (!e->wdlFile.data) {
+        delete e;
+        return FALSE;
+    }
+    for (const string &dir : dirs)
+        if (!e->dtzFile.data && MapFile(dir + "/" + name + ".rtbz", &e->dtzFile, DtzMagic)) {
+            e->hasDtz = ParseFile(e, TRUE);
+            if (!e->hasDtz) {
+                cout << "Syzygy: " << name << ".rtbz does not match its name" << endl;
+                UnmapFile(&e->dtzFile);
+            }
+        }
+
+    TBEntries.push_back(e);
+    TBByKey[e->key] = e;
+    TBByKey[e->key2] = e;
+    return TRUE;
+}
+
+
+/*
+    Name:    TBInit
+    Vars:    const char *path - Directories of the tables separated by ':' (';' on Windows).
+    Purpose: Find and map every table in the directories. Tables are named after their material, like KQvKR.rtbw,
+             with the stronger side first.
+    Returns: The most pieces, kings included, of the tables loaded. 0 if there are none.
+*/
+int TBInit(const char *path) {
+    static int tablesReady = FALSE;
+    if (!tablesReady) {
+        TBInitTables();
+        tablesReady = TRUE;
+    }
+    TBFree();
+
+#ifdef WIN32
+    const char separator = ';';
+#else
+    const char separator = ':';
+#endif
+    vector<string> dirs;
+    string list = path;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(separator, start);
+        if (end == string::npos)
+            end = list.size();
+        if (end > start)
+            dirs.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+
+    vector<string> names;
+    for (const string &dir : dirs) {
+        error_code ec;
+        for (const auto &file : filesystem::directory_iterator(dir, ec)) {
+            if (file.path().extension() != ".rtbw")
+                continue;
+            string name = file.path().stem().string();
+            int kings = 0, pieces = 0, valid = name.size() >= 3 && name[0] == 'K';
+            for (size_t i = 0; i < name.size() && valid; ++i) {
+                if (name[i] == 'K')
+                    kings++;
+                else if (name[i] == 'v')
+                    valid = (kings == 1 && i + 1 < name.size() && name[i + 1] == 'K');
+                else if (string("PNBRQ").find(name[i]) == string::npos)
+                    valid = FALSE;
+                if (name[i] != 'v')
+                    pieces++;
+            }
+            if (valid && kings == 2 && pieces <= TB_PIECES && find(names.begin(), names.end(), name) == names.end())
+                names.push_back(name);
+        }
+    }
+
+    int largest = 0;
+    for (const string &name : names)
+        if (AddTable(name, dirs))
+            largest = max(largest, TBEntries.back()->pieceCount);
+    return largest;
+}
+
+
+/*
+    Name:    TBFree
+    Purpose: Unmap every table.
+*/
+void TBFree() {
+    for (S_TBENTRY *e : TBEntries) {
+        UnmapFile(&e->wdlFile);
+        UnmapFile(&e->dtzFile);
+        delete e;
+    }
+    TBEntries.clear();
+    TBByKey.clear();
+}
+
+
+//Checking tables against the rules, and writing small tables to test the prober with
+
+/*
+    Name:    BalancePieces
+    Vars:    const string &name - A material balance like KRvKP.
+             int swap           - TRUE to give the first side of the name to black.
+    Returns: The engine pieces of the balance, in the order of the name.
+*/
+static vector<int> BalancePieces(const string &name, int swap) {
+    static const string Letters = "PNBRQK";
+    vector<int> pieces;
+    int side = WHITE;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == 'v')
+            side = BLACK;
+        else
+            pieces.push_back(((side ^ swap) == WHITE)? wP + (int)Letters.find(name[i]) : bP + (int)Letters.find(name[i]));
+    }
+    return pieces;
+}
+
+
+/*
+    Name:    PlacePieces
+    Vars:    S_BOARD *pos                - Set to the position.
+             const vector<int> &pieces   - Engine pieces.
+             const int *sq64             - The square of each piece.
+             int side                    - The side to move.
+    Purpose: Build a position through UnpackPosition, which already turns away the ones that can't happen.
+    Returns: TRUE if the position is legal.
+*/
+static int PlacePieces(S_BOARD *pos, const vector<int> &pieces, const int *sq64, int side) {
+    S_PACKEDPOS pp;
+    memset(&pp, 0, sizeof(pp));
+    int onSquare[64];
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        if (pp.occupied & SetMask[sq64[i]])
+            return FALSE;
+        pp.occupied |= SetMask[sq64[i]];
+        onSquare[sq64[i]] = pieces[i];
+    }
+    U64 occ = pp.occupied;
+    for (int i = 0; occ; ++i)
+        pp.pieces[i >> 1] |= onSquare[POP(&occ)] << ((i & 1) * 4);
+    pp.flags = (unsigned char)side;
+    pp.enPas = 64;
+    return UnpackPosition(&pp, pos);
+}
+
+
+//Placements are numbered by the side to move and then the square of each piece
+static void PlacementSquares(long id, int count, int *sq64, int *side) {
+    for (int i = count - 1; i >= 0; --i) {
+        sq64[i] = id & 63;
+        id >>= 6;
+    }
+    *side = (int)id;
+}
+
+
+/*
+    Name:    DtzInPlies
+    Vars:    const S_BOARD *pos - A position with a DTZ table.
+             int wdl            - Its result.
+    Returns: TRUE if the DTZ of the result is stored in plies. Counted in moves it can be a ply too high.
+*/
+static int DtzInPlies(const S_BOARD *pos, int wdl) {
+    if (wdl != TB_WIN && wdl != TB_LOSS)
+        return FALSE;
+    auto it = TBByKey.find(PositionKey(pos));
+    if (it == TBByKey.end())
+        return TRUE;
+    for (int file = 0; file <= ((it->second->hasPawns)? 3 : 0); ++file)
+        if (!(it->second->dtz[file].flags & ((wdl == TB_WIN)? TBF_WINPLIES : TBF_LOSSPLIES)))
+            return FALSE;
+    return TRUE;
+}
+
+
+/*
+    Name:    ProbeBoth
+    Vars:    S_BOARD *pos - A position.
+             int *wdl     - Set to its result.
+             int *dtz     - Set to its DTZ.
+    Purpose: Probe a position for the checks, remembering it since every position is reached from many others.
+    Returns: FALSE if a table is missing.
+*/
+static int ProbeBoth(S_BOARD *pos, int *wdl, int *dtz) {
+    static unordered_map<U64, int> probed;
+    if (probed.size() > 4000000)
+        probed.clear();
+
+    auto it = probed.find(pos->posKey);
+    if (it != probed.end()) {
+        *wdl = (it->second & 7) - 2;
+        *dtz = it->second >> 3;
+        return TRUE;
+    }
+    int wdlFound, dtzFound;
+    *wdl = TBProbeWdl(pos, &wdlFound);
+    *dtz = TBProbeDtz(pos, &dtzFound);
+    if (!wdlFound || !dtzFound)
+        return FALSE;
+    probed[pos->posKey] = (*dtz * 8) | (*wdl + 2);
+    return TRUE;
+}
+
+
+/*
+    Name:    SearchOnePly
+    Vars:    S_BOARD *pos - A position with legal moves.
+             int *wdl     - Set to the best result of the moves.
+             int *dtz     - Set to the DTZ that result gives: the quickest win or the slowest loss. A capture, pawn
+                            move or mate is one ply, any other move one more than the DTZ after it.
+    Purpose: Work out what the tables must say about a position from what they say about the positions after it.
+             If that holds for every position of a balance, and the balances it captures or promotes into are right,
+             the balance is right: each win leads by a shorter DTZ to a capture, pawn move or mate.
+    Returns: FALSE if a table is missing.
+*/
+static int SearchOnePly(S_BOARD *pos, int *wdl, int *dtz) {
+    int results[MAXPOSITIONMOVES], dtzs[MAXPOSITIONMOVES], ends[MAXPOSITIONMOVES];
+    int count = 0;
+    *wdl = TB_LOSS;
+
+    S_MOVELIST list[1];
+    GenerateAllMoves(pos, list);
+    for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+        int move = list->moves[moveNum].move;
+        int zeroing = IsZeroing(pos, move);
+        if (!MakeMove(pos, move))
+            continue;
+        int found = ProbeBoth(pos, &results[count], &dtzs[count]);
+        results[count] = -results[count];
+        ends[count] = zeroing || (InCheck(pos) && !HasLegalMove(pos));
+        TakeMove(pos);
+        if (!found)
+            return FALSE;
+        *wdl = max(*wdl, results[count]);
+        count++;
+    }
+
+    *dtz = (*wdl > TB_DRAW)? 0xFFFF : 0;
+    for (int i = 0; i < count && *wdl != TB_DRAW; ++i) {
+        if (results[i] != *wdl)
+            continue;
+        int plies = (ends[i])? abs(DtzBeforeZeroing(*wdl)) : 1 + abs(dtzs[i]);
+        *dtz = (*wdl > TB_DRAW)? min(*dtz, plies) : min(*dtz, -plies);
+    }
+    return TRUE;
+}
+
+
+/*
+    Name:    VerifyTablebases
+    Vars:    const char *path - Directories of the tables, as for TBInit.
+             int step         - Check every step-th placement. 1 checks every position, which for a 4 piece balance
+                                takes a while.
+    Purpose: Check every table found against the rules, as SearchOnePly says. Each position is probed with both
+             colours, and KPvK positions are also checked against the KPK bitbase, which knows nothing of the files.
+             The DTZ of a position with no moves is never read, since the search finds mates itself.
+    Returns: The number of positions the tables get wrong, or -1 if there are no tables.
+*/
+int VerifyTablebases(const char *path, int step) {
+    if (TBInit(path) == 0) {
+        cout << "No tables found in " << path << endl;
+        return -1;
+    }
+    vector<S_TBENTRY *> entries = TBEntries;
+    sort(entries.begin(), entries.end(), [](const S_TBENTRY *a, const S_TBENTRY *b) {
+        return (a->pieceCount != b->pieceCount)? a->pieceCount < b->pieceCount : a->name < b->name;
+    });
+
+    S_BOARD *board = new S_BOARD;
+    board->PvTable->pTable = NULL;
+    char fen[MAXFENLEN];
+    long total = 0, errors = 0;
+    int start = GetTimeMs();
+
+    for (const S_TBENTRY *e : entries) {
+        long positions = 0, wdlWrong = 0, dtzWrong = 0, kpkWrong = 0, missing = 0;
+        int kpk = (e->name == "KPvK");
+        for (int swap = 0; swap < ((e->key == e->key2)? 1 : 2); ++swap) {
+            vector<int> pieces = BalancePieces(e->name, swap);
+            int count = (int)pieces.size();
+            int sq64[TB_PIECES], side;
+            for (long id = 0; id < (2L << (6 * count)); id += step) {
+                PlacementSquares(id, count, sq64, &side);
+                if (!PlacePieces(board, pieces, sq64, side))
+                    continue;
+                positions++;
+
+                int wdl, dtz, wantWdl, wantDtz;
+                int moves = HasLegalMove(board);
+                if (!ProbeBoth(board, &wdl, &dtz) || (moves && !SearchOnePly(board, &wantWdl, &wantDtz))) {
+                    missing++;
+                    continue;
+                }
+                if (!moves) {
+                    wantWdl = (InCheck(board))? TB_LOSS : TB_DRAW;
+                    wantDtz = dtz;
+                }
+                if (wdl != wantWdl) {
+                    if (wdlWrong++ < 5)
+                        cout << "  " << BoardToFen(board, fen) << " WDL " << wdl << ", should be " << wantWdl << endl;
+                } else if (dtz != wantDtz && !(abs(dtz - wantDtz) == 1 && !DtzInPlies(board, wdl))) {
+                    if (dtzWrong++ < 5)
+                        cout << "  " << BoardToFen(board, fen) << " DTZ " << dtz << ", should be " << wantDtz << endl;
+                }
+                if (kpk) {
+                    int strong = (board->pceNum[wP])? WHITE : BLACK;
+                    int won = ProbeKPK(strong, board->side, board->KingSq[strong], board->KingSq[strong ^ 1],
+                                       board->pList[(strong == WHITE)? wP : bP][0]);
+                    if (wdl != ((won)? ((board->side == strong)? TB_WIN : TB_LOSS) : TB_DRAW) && kpkWrong++ < 5)
+                        cout << "  " << BoardToFen(board, fen) << " WDL " << wdl << " disagrees with the KPK bitbase" << endl;
+                }
+            }
+        }
+        cout << e->name << ": " << positions << " positions, " << wdlWrong << " WDL wrong, " << dtzWrong << " DTZ wrong";
+        if (kpk)
+            cout << ", " << kpkWrong << " against KPK";
+        if (missing)
+            cout << ", " << missing << " missing a table";
+        cout << endl;
+        total += positions;
+        errors += wdlWrong + dtzWrong + kpkWrong + missing;
+    }
+
+    cout << "Tablebase verification: " << entries.size() << " balances, " << total << " positions, " << errors
+         << " wrong, in " << GetTimeMs() - start << "ms" << endl;
+    delete board;
+    TBFree();
+    return (int)min(errors, 1000000L);
+}
+
+
+//A balance solved by retrograde analysis, for the test tables
+typedef struct {
+    string name;
+    U64 key;
+    vector<int> pieces;         //Engine pieces, one of each
+    vector<char> legal;         //By placement
+    vector<signed char> wdl;    //TB_LOSS, TB_DRAW or TB_WIN for the side to move
+    vector<short> dtz;
+} S_TBSOLVED;
+
+//A move of a position being solved: to another placement of the balance, or out of it with a known result
+typedef struct {
+    long id;
+    int wdl;
+    char zeroing, mate;
+} S_TBSOLVEMOVE;
+
+//A compressed table being written
+typedef struct {
+    int flags;
+    int single;                 //The value of a table that holds just one, else -1
+    int maxLen, minLen;
+    vector<int> lowest;         //Lowest symbol of each code length
+    vector<pair<int, int>> pairs;   //What each symbol stands for: a value and 0xFFF, or two symbols
+    vector<pair<unsigned, int>> sparse;
+    vector<int> blockLen;
+    vector<unsigned char> data;
+} S_TBWRITTEN;
+
+#define TBW_BLOCKBITS 6         //64 byte blocks
+#define TBW_SPANBITS 7          //A sparse index entry every 128 values
+
+
+/*
+    Name:    TestRand
+    Purpose: xorshift64* generator with a fixed seed, so the test tables come out the same every time.
+    Returns: A pseudo random 64 bit number.
+*/
+static U64 TestRand() {
+    static U64 s = 0x9E3779B97F4A7C15ULL;
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 0x2545F4914F6CDD1DULL;
+}
+
+
+static long SolvedId(const S_TBSOLVED *s, const S_BOARD *pos) {
+    long id = pos->side;
+    for (int piece : s->pieces) {
+        U64 bb = pos->pceBB[piece];
+        id = (id << 6) | POP(&bb);
+    }
+    return id;
+}
+
+
+//The result for the side to move of a position reached by a capture or promotion
+static int SolvedWdl(const vector<S_TBSOLVED *> &solved, const S_BOARD *pos, int *found) {
+    *found = TRUE;
+    if (CNT(pos->occupied[BOTH]) == 2)
+        return TB_DRAW;
+    for (const S_TBSOLVED *s : solved)
+        if (s->key == PositionKey(pos))
+            return s->wdl[SolvedId(s, pos)];
+    *found = FALSE;
+    return TB_DRAW;
+}
+
+
+/*
+    Name:    SolveBalance
+    Vars:    S_BOARD *pos                        - A board to work on.
+             const string &name                  - A 3 piece balance, each piece different.
+             const vector<S_TBSOLVED *> &solved  - The balances its promotions lead to.
+    Purpose: Solve every position by retrograde analysis: positions are settled as won when a move reaches a lost
+             one and as lost when every move reaches a won one, until nothing changes. The DTZ is then filled in one
+             ply at a time.
+    Returns: The solved balance, or NULL if a balance it promotes into hasn't been solved.
+*/
+static S_TBSOLVED *SolveBalance(S_BOARD *pos, const string &name, const vector<S_TBSOLVED *> &solved) {
+    S_TBSOLVED *s = new S_TBSOLVED;
+    S_TBENTRY *e = NewEntry(name);
+    s->name = name;
+    s->key = e->key;
+    s->pieces = BalancePieces(name, FALSE);
+    delete e;
+
+    int count = (int)s->pieces.size();
+    long size = 2L << (6 * count);
+    s->legal.assign(size, FALSE);
+    s->wdl.assign(size, TB_DRAW);
+    s->dtz.assign(size, 0);
+
+    vector<vector<S_TBSOLVEMOVE>> moves(size);
+    vector<char> known(size, FALSE);
+    int sq64[TB_PIECES], side;
+    for (long id = 0; id < size; ++id) {
+        PlacementSquares(id, count, sq64, &side);
+        if (!PlacePieces(pos, s->pieces, sq64, side))
+            continue;
+        s->legal[id] = TRUE;
+
+        S_MOVELIST list[1];
+        GenerateAllMoves(pos, list);
+        for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+            int move = list->moves[moveNum].move;
+            S_TBSOLVEMOVE m;
+            m.zeroing = IsZeroing(pos, move);
+            if (!MakeMove(pos, move))
+                continue;
+            m.mate = InCheck(pos) && !HasLegalMove(pos);
+            m.id = -1;
+            m.wdl = TB_DRAW;
+            int found = TRUE;
+            if (PositionKey(pos) == s->key)
+                m.id = SolvedId(s, pos);
+            else
+                m.wdl = SolvedWdl(solved, pos, &found);
+            TakeMove(pos);
+            if (!found) {
+                cout << name << " promotes into a balance that hasn't been solved" << endl;
+                delete s;
+                return NULL;
+            }
+            moves[id].push_back(m);
+        }
+        if (moves[id].empty()) {
+            known[id] = TRUE;
+            s->wdl[id] = (InCheck(pos))? TB_LOSS : TB_DRAW;
+        }
+    }
+
+    for (int changed = TRUE; changed; ) {
+        changed = FALSE;
+        for (long id = 0; id < size; ++id) {
+            if (!s->legal[id] || known[id])
+                continue;
+            int wins = FALSE, losses = TRUE;
+            for (const S_TBSOLVEMOVE &m : moves[id]) {
+                int settled = (m.id < 0) || known[m.id];
+                int wdl = (m.id < 0)? m.wdl : s->wdl[m.id];
+                if (settled && wdl == TB_LOSS)
+                    wins = TRUE;
+                if (!settled || wdl != TB_WIN)
+                    losses = FALSE;
+            }
+            if (wins || losses) {
+                s->wdl[id] = (wins)? TB_WIN : TB_LOSS;
+                known[id] = TRUE;
+                changed = TRUE;
+            }
+        }
+    }
+
+    //DTZ: a win of n plies needs a move to a loss of n - 1, a loss of n plies has its longest move at n
+    vector<char> done(size, FALSE);
+    for (long id = 0; id < size; ++id) {
+        if (s->legal[id] && s->wdl[id] == TB_DRAW)
+            done[id] = TRUE;
+        if (s->legal[id] && moves[id].empty() && s->wdl[id] == TB_LOSS) {
+            s->dtz[id] = -1;
+            done[id] = TRUE;
+        }
+    }
+    for (int plies = 1; plies < 1000; ++plies) {
+        vector<long> won;
+        for (long id = 0; id < size; ++id) {
+            if (!s->legal[id] || done[id] || s->wdl[id] != TB_WIN)
+                continue;
+            int best = 0xFFFF;
+            for (const S_TBSOLVEMOVE &m : moves[id]) {
+                if (((m.id < 0)? m.wdl : s->wdl[m.id]) != TB_LOSS)
+                    continue;
+                if (m.zeroing || m.mate)
+                    best = 1;
+                else if (done[m.id])
+                    best = min(best, 1 - s->dtz[m.id]);
+            }
+            if (best == plies)
+                won.push_back(id);
+        }
+        for (long id : won) {
+            s->dtz[id] = plies;
+            done[id] = TRUE;
+        }
+        for (long id = 0; id < size; ++id) {
+            if (!s->legal[id] || done[id] || s->wdl[id] != TB_LOSS)
+                continue;
+            int longest = 0, settled = TRUE;
+            for (const S_TBSOLVEMOVE &m : moves[id]) {
+                if (m.zeroing)
+                    longest = max(longest, 1);
+                else if (!done[m.id])
+                    settled = FALSE;
+                else
+                    longest = max(longest, 1 + s->dtz[m.id]);
+            }
+            if (settled) {
+                s->dtz[id] = -longest;
+                done[id] = TRUE;
+            }
+        }
+    }
+    return s;
+}
+
+
+/*
+    Name:    CompressValues
+    Vars:    const vector<int> &values - The values of one table, by index.
+             int flags                 - The table's flags.
+    Purpose: Compress a table as the prober reads it. The most frequent pair of symbols keeps being replaced by a new
+             symbol while that pays, then the symbols get canonical Huffman codes, longest codes numbered first, and
+             the codes are packed into blocks that never split a code.
+    Returns: The compressed table.
+*/
+static S_TBWRITTEN CompressValues(const vector<int> &values, int flags) {
+    S_TBWRITTEN w;
+    w.flags = flags;
+    w.single = -1;
+    if (count(values.begin(), values.end(), values[0]) == (long)values.size()) {
+        w.single = values[0];
+        w.flags |= TBF_SINGLEVALUE;
+        return w;
+    }
+
+    //Recursive pairing
+    vector<pair<int, int>> pairs;
+    vector<long> length;    //Values each symbol expands to
+    vector<int> symbols;
+    unordered_map<int, int> leaf;
+    for (int v : values) {
+        if (!leaf.count(v)) {
+            leaf[v] = (int)pairs.size();
+            pairs.push_back(make_pair(v, 0xFFF));
+            length.push_back(1);
+        }
+        symbols.push_back(leaf[v]);
+    }
+    while (pairs.size() < 4000) {
+        unordered_map<long, long> seen;
+        long bestPair = 0, bestCount = 0;
+        for (size_t i = 0; i + 1 < symbols.size(); ++i) {
+            long p = ((long)symbols[i] << 12) | symbols[i + 1];
+            if (++seen[p] > bestCount || (seen[p] == bestCount && p < bestPair)) {
+                bestCount = seen[p];
+                bestPair = p;
+            }
+        }
+        int left = (int)(bestPair >> 12), right = (int)(bestPair & 0xFFF);
+        if (bestCount < 4 || length[left] + length[right] > 2000)
+            break;
+        vector<int> paired;
+        for (size_t i = 0; i < symbols.size(); ) {
+            if (i + 1 < symbols.size() && symbols[i] == left && symbols[i + 1] == right) {
+                paired.push_back((int)pairs.size());
+                i += 2;
+            } else
+                paired.push_back(symbols[i++]);
+        }
+        if (count(paired.begin(), paired.end(), paired[0]) == (long)paired.size())
+            break;  //A single symbol has no code
+        pairs.push_back(make_pair(left, right));
+        length.push_back(length[left] + length[right]);
+        symbols.swap(paired);
+    }
+
+    //Huffman code lengths, with the counts halved until no code is longer than 24 bits
+    int numSyms = (int)pairs.size();
+    vector<long> freq(numSyms, 0);
+    for (int sym : symbols)
+        freq[sym]++;
+    vector<int> codeLen(numSyms, 0);
+    for (;;) {
+        vector<long> weight;
+        vector<int> parent;
+        vector<pair<long, int>> heap;
+        vector<int> node(numSyms, -1);
+        for (int sym = 0; sym < numSyms; ++sym)
+            if (freq[sym]) {
+                node[sym] = (int)weight.size();
+                heap.push_back(make_pair(-freq[sym], (int)weight.size()));
+                weight.push_back(freq[sym]);
+                parent.push_back(-1);
+            }
+        make_heap(heap.begin(), heap.end());
+        while (heap.size() > 1) {
+            pop_heap(heap.begin(), heap.end());
+            pair<long, int> a = heap.back();
+            heap.pop_back();
+            pop_heap(heap.begin(), heap.end());
+            pair<long, int> b = heap.back();
+            heap.pop_back();
+            parent[a.second] = parent[b.second] = (int)weight.size();
+            heap.push_back(make_pair(a.first + b.first, (int)weight.size()));
+            push_heap(heap.begin(), heap.end());
+            weight.push_back(-(a.first + b.first));
+            parent.push_back(-1);
+        }
+        int longest = 0;
+        for (int sym = 0; sym < numSyms; ++sym) {
+            codeLen[sym] = 0;
+            for (int n = node[sym]; n >= 0 && parent[n] >= 0; n = parent[n])
+                codeLen[sym]++;
+            longest = max(longest, codeLen[sym]);
+        }
+        if (longest <= 24)
+            break;
+        for (long &f : freq)
+            if (f)
+                f = f / 2 + 1;
+    }
+    w.minLen = 64;
+    w.maxLen = 0;
+    for (int sym = 0; sym < numSyms; ++sym)
+        if (freq[sym]) {
+            w.minLen = min(w.minLen, codeLen[sym]);
+            w.maxLen = max(w.maxLen, codeLen[sym]);
+        }
+    int lengths = w.maxLen - w.minLen + 1;
+
+    //Number the symbols longest code first, with the unused ones last
+    vector<int> order, number(numSyms);
+    for (int len = w.maxLen; len >= w.minLen; --len)
+        for (int sym = 0; sym < numSyms; ++sym)
+            if (freq[sym] && codeLen[sym] == len)
+                order.push_back(sym);
+    for (int sym = 0; sym < numSyms; ++sym)
+        if (!freq[sym])
+            order.push_back(sym);
+    for (int i = 0; i < numSyms; ++i)
+        number[order[i]] = i;
+    w.lowest.assign(lengths, 0);
+    vector<U64> base(lengths, 0);
+    for (int i = lengths - 2; i >= 0; --i) {
+        int ofLen = 0;
+        for (int sym = 0; sym < numSyms; ++sym)
+            ofLen += (freq[sym] && codeLen[sym] == w.minLen + i + 1);
+        w.lowest[i] = w.lowest[i + 1] + ofLen;
+        base[i] = (base[i + 1] + w.lowest[i] - w.lowest[i + 1]) / 2;
+    }
+    w.pairs.resize(numSyms);
+    for (int sym = 0; sym < numSyms; ++sym)
+        w.pairs[number[sym]] = (pairs[sym].second == 0xFFF)? pairs[sym]
+                                                             : make_pair(number[pairs[sym].first], number[pairs[sym].second]);
+
+    //Blocks, each holding at most 65536 values
+    vector<long> blockStart;
+    long values0 = 0;
+    for (size_t i = 0; i < symbols.size(); ) {
+        vector<unsigned char> block(1 << TBW_BLOCKBITS, 0);
+        int bits = 0;
+        long held = 0;
+        blockStart.push_back(values0);
+        while (i < symbols.size()) {
+            int sym = symbols[i], len = codeLen[sym];
+            if (bits + len > (8 << TBW_BLOCKBITS) || held + length[sym] > 65536)
+                break;
+            U64 code = base[len - w.minLen] + (number[sym] - w.lowest[len - w.minLen]);
+            for (int bit = len - 1; bit >= 0; --bit, ++bits)
+                if ((code >> bit) & 1)
+                    block[bits / 8] |= 0x80 >> (bits % 8);
+            held += length[sym];
+            i++;
+        }
+        w.blockLen.push_back((int)held - 1);
+        values0 += held;
+        w.data.insert(w.data.end(), block.begin(), block.end());
+    }
+    long span = 1L << TBW_SPANBITS;
+    for (long at = span / 2, block = 0; at - span / 2 < values0; at += span) {
+        while (block + 1 < (long)blockStart.size() && blockStart[block + 1] <= at)
+            block++;
+        w.sparse.push_back(make_pair((unsigned)block, (int)(at - blockStart[block])));
+    }
+    return w;
+}
+
+
+static void Put8(vector<unsigned char> &out, unsigned v)  { out.push_back((unsigned char)v); }
+static void Put16(vector<unsigned char> &out, unsigned v) { Put8(out, v & 0xFF); Put8(out, v >> 8); }
+static void Put32(vector<unsigned char> &out, unsigned v) { Put16(out, v & 0xFFFF); Put16(out, v >> 16); }
+
+
+//The number of values a table holds
+static U64 TableSize(const S_TBPAIRS *d) {
+    int n = 0;
+    while (d->groupLen[n])
+        n++;
+    return d->groupIdx[n];
+}
+
+
+//The piece order (as file piece codes) and leading group of each table of a test balance
+typedef struct {
+    const char *name;
+    int pieces[2][3];   //By side to move, the first white to move
+    int order[2];
+    int dtzSide;        //The side to move the DTZ file holds
+} S_TBTESTSPEC;
+
+static const S_TBTESTSPEC TestSpecs[] = {
+    {"KQvK", {{5, 6, 14}, {14, 5, 6}}, {0, 0}, WHITE},
+    {"KRvK", {{6, 4, 14}, {4, 14, 6}}, {0, 0}, BLACK},
+    {"KBvK", {{3, 6, 14}, {3, 6, 14}}, {0, 0}, WHITE},
+    {"KNvK", {{2, 6, 14}, {2, 6, 14}}, {0, 0}, WHITE},
+    {"KPvK", {{1, 6, 14}, {1, 14, 6}}, {1, 0}, BLACK},
+};
+
+
+/*
+    Name:    WriteTableFile
+    Vars:    const string &file        - Where to write.
+             const S_TBENTRY *e        - The balance.
+             int dtz                   - TRUE for a DTZ file.
+             const S_TBTESTSPEC *spec  - The piece order of its tables.
+             const vector<S_TBWRITTEN> &tables - The compressed tables, by file and then side to move.
+    Purpose: Write the header, the piece orders, the code tables, the indexes and the blocks, in the order
+             ParseFile reads them.
+    Returns: TRUE if the file was written.
+*/
+static int WriteTableFile(const string &file, const S_TBENTRY *e, int dtz, const S_TBTESTSPEC *spec,
+                          const vector<S_TBWRITTEN> &tables) {
+    vector<unsigned char> out;
+    for (int i = 0; i < 4; ++i)
+        Put8(out, (dtz)? DtzMagic[i] : WdlMagic[i]);
+    Put8(out, ((e->key != e->key2)? 1 : 0) | ((e->hasPawns)? 2 : 0));
+
+    int sides = (!dtz && e->key != e->key2)? 2 : 1;
+    for (int file = 0; file <= ((e->hasPawns)? 3 : 0); ++file) {
+        Put8(out, spec->order[0] | (((sides == 2)? spec->order[1] : 0) << 4));
+        for (int i = 0; i < e->pieceCount; ++i)
+            Put8(out, spec->pieces[0][i] | (((sides == 2)? spec->pieces[1][i] : 0) << 4));
+    }
+    if (out.size() & 1)
+        Put8(out, 0);
+
+    for (const S_TBWRITTEN &w : tables) {
+        Put8(out, w.flags);
+        if (w.single >= 0) {
+            Put8(out, w.single);
+            continue;
+        }
+        Put8(out, TBW_BLOCKBITS);
+        Put8(out, TBW_SPANBITS);
+        Put8(out, 0);
+        Put32(out, (unsigned)w.blockLen.size());
+        Put8(out, w.maxLen);
+        Put8(out, w.minLen);
+        for (int lowest : w.lowest)
+            Put16(out, lowest);
+        Put16(out, (unsigned)w.pairs.size());
+        for (const pair<int, int> &p : w.pairs) {
+            Put8(out, p.first & 0xFF);
+            Put8(out, ((p.first >> 8) & 0xF) | ((p.second & 0xF) << 4));
+            Put8(out, p.second >> 4);
+        }
+        if (w.pairs.size() & 1)
+            Put8(out, 0);
+    }
+    if (out.size() & 1)
+        Put8(out, 0);
+    for (const S_TBWRITTEN &w : tables)
+        for (const pair<unsigned, int> &entry : w.sparse) {
+            Put32(out, entry.first);
+            Put16(out, entry.second);
+        }
+    for (const S_TBWRITTEN &w : tables)
+        for (int len : w.blockLen)
+            Put16(out, len);
+    for (const S_TBWRITTEN &w : tables) {
+        while (out.size() % 64)
+            Put8(out, 0);
+        out.insert(out.end(), w.data.begin(), w.data.end());
+    }
+    Put32(out, 0);  //The decoder reads 8 bytes past a block
+    Put32(out, 0);
+    while (out.size() % 64 != 16)
+        Put8(out, 0);
+
+    FILE *f = fopen(file.c_str(), "wb");
+    if (f == NULL)
+        return FALSE;
+    int written = (fwrite(out.data(), 1, out.size(), f) == out.size());
+    fclose(f);
+    return written;
+}
+
+
+/*
+    Name:    WriteBalance
+    Vars:    S_BOARD *pos                       - A board to work on.
+             const S_TBSOLVED *s                - A solved balance.
+             const S_TBTESTSPEC *spec           - How to lay out its tables.
+             const vector<S_TBSOLVED *> &solved - Every solved balance, for the results of captures and promotions.
+             const string &dir                  - Where to write.
+    Purpose: Write the balance's .rtbw and .rtbz files. As in real tables, a WDL value the captures settle and a DTZ
+             value a zeroing move settles is a "don't care", and is filled with noise here so the prober is caught if
+             it reads one. The DTZ file holds one side to move.
+    Returns: The number of positions whose values clash with another's at the same index.
+*/
+static long WriteBalance(S_BOARD *pos, const S_TBSOLVED *s, const S_TBTESTSPEC *spec,
+                         const vector<S_TBSOLVED *> &solved, const string &dir) {
+    S_TBENTRY *e = NewEntry(s->name);
+    int maxFile = (e->hasPawns)? 3 : 0;
+    int sides = (e->key != e->key2)? 2 : 1;
+    vector<vector<int>> wdlValues, dtzValues;
+    vector<vector<char>> wdlSet, dtzSet;
+    for (int file = 0; file <= maxFile; ++file) {
+        int order[2] = {spec->order[0], 0xF};
+        for (int side = 0; side < sides; ++side) {
+            memcpy(e->wdl[file][side].pieces, spec->pieces[side], sizeof(spec->pieces[side]));
+            order[0] = spec->order[side];
+            SetGroups(e, &e->wdl[file][side], order, file);
+        }
+        memcpy(e->dtz[file].pieces, spec->pieces[0], sizeof(spec->pieces[0]));
+        order[0] = spec->order[0];
+        SetGroups(e, &e->dtz[file], order, file);
+        e->dtz[file].flags = spec->dtzSide | TBF_WINPLIES | TBF_LOSSPLIES;
+
+        for (int side = 0; side < sides; ++side) {
+            wdlValues.push_back(vector<int>(TableSize(&e->wdl[file][side])));
+            wdlSet.push_back(vector<char>(wdlValues.back().size(), FALSE));
+            for (int &v : wdlValues.back())
+                v = TestRand() % 5;
+        }
+        dtzValues.push_back(vector<int>(TableSize(&e->dtz[file])));
+        dtzSet.push_back(vector<char>(dtzValues.back().size(), FALSE));
+        for (int &v : dtzValues.back())
+            v = TestRand() % 7;
+    }
+
+    long clashes = 0;
+    int sq64[TB_PIECES], side;
+    for (long id = 0; id < (long)s->legal.size(); ++id) {
+        if (!s->legal[id])
+            continue;
+        PlacementSquares(id, (int)s->pieces.size(), sq64, &side);
+        PlacePieces(pos, s->pieces, sq64, side);
+
+        //What the captures and zeroing moves settle
+        int bestCapture = TB_LOSS - 1, bestZeroing = TB_LOSS - 1, quiet = FALSE, slow = FALSE, found;
+        S_MOVELIST list[1];
+        GenerateAllMoves(pos, list);
+        for (int moveNum = 0; moveNum < list->count; ++moveNum) {
+            int move = list->moves[moveNum].move;
+            int capture = move & MFLAGCAP, zeroing = IsZeroing(pos, move);
+            if (!MakeMove(pos, move))
+                continue;
+            int wdl = -((PositionKey(pos) == s->key)? s->wdl[SolvedId(s, pos)] : SolvedWdl(solved, pos, &found));
+            TakeMove(pos);
+            if (capture)
+                bestCapture = max(bestCapture, wdl);
+            else
+                quiet = TRUE;
+            if (zeroing)
+                bestZeroing = max(bestZeroing, wdl);
+            else
+                slow = TRUE;
+        }
+
+        int wdl = s->wdl[id], result = TBP_OK;
+        const S_TBPAIRS *d;
+        U64 idx = EncodePosition(pos, e, FALSE, &d, &result);
+        int table = (int)((d - &e->wdl[0][0]) / 2) * sides + (int)((d - &e->wdl[0][0]) % 2);
+        if (!quiet && bestCapture >= TB_LOSS) {
+            //Every move captures, so the value is never read
+        } else if (bestCapture >= wdl) {
+            if (!wdlSet[table][idx])
+                wdlValues[table][idx] = TestRand() % (bestCapture + 3);
+        } else {
+            clashes += (wdlSet[table][idx] && wdlValues[table][idx] != wdl + 2);
+            wdlValues[table][idx] = wdl + 2;
+            wdlSet[table][idx] = TRUE;
+        }
+
+        result = TBP_OK;
+        idx = EncodePosition(pos, e, TRUE, &d, &result);
+        if (result != TBP_CHANGESTM && wdl != TB_DRAW && bestZeroing < TB_WIN && (slow || bestZeroing < TB_LOSS)) {
+            table = (int)(d - &e->dtz[0]);
+            clashes += (dtzSet[table][idx] && dtzValues[table][idx] != abs(s->dtz[id]) - 1);
+            dtzValues[table][idx] = abs(s->dtz[id]) - 1;
+            dtzSet[table][idx] = TRUE;
+        }
+    }
+
+    vector<S_TBWRITTEN> wdlTables, dtzTables;
+    for (size_t i = 0; i < wdlValues.size(); ++i)
+        wdlTables.push_back(CompressValues(wdlValues[i], 0));
+    for (size_t i = 0; i < dtzValues.size(); ++i)
+        dtzTables.push_back(CompressValues(dtzValues[i], spec->dtzSide | TBF_WINPLIES | TBF_LOSSPLIES));
+    if (!WriteTableFile(dir + "/" + s->name + ".rtbw", e, FALSE, spec, wdlTables)
+        || !WriteTableFile(dir + "/" + s->name + ".rtbz", e, TRUE, spec, dtzTables)) {
+        cout << "Could not write " << s->name << " in " << dir << endl;
+        clashes++;
+    }
+    delete e;
+    return clashes;
+}
+
+
+/*
+    Name:    WriteTestTables
+    Vars:    const char *dir - An existing directory.
+    Purpose: Solve KQvK, KRvK, KBvK, KNvK and KPvK and write them as Syzygy files, to run VerifyTablebases on where
+             real tables can't be had. The layouts differ between balances, and the DTZ files hold black to move for
+             some and white for others, to cover the prober's paths. A writer and prober that misread the format the
+             same way still agree, so this tests the prober's handling of the layout, not the format itself.
+    Returns: The number of positions that couldn't be stored, or -1 if the tables couldn't be made.
+*/
+long WriteTestTables(const char *dir) {
+    TBInitTables();
+    S_BOARD *board = new S_BOARD;
+    board->PvTable->pTable = NULL;
+    vector<S_TBSOLVED *> solved;
+    long clashes = 0;
+    int start = GetTimeMs();
+
+    for (const S_TBTESTSPEC &spec : TestSpecs) {
+        S_TBSOLVED *s = SolveBalance(board, spec.name, solved);
+        if (s == NULL) {
+            clashes = -1;
+            break;
+        }
+        solved.push_back(s);
+        clashes += WriteBalance(board, s, &spec, solved, dir);
+        cout << "Wrote " << s->name << endl;
+    }
+    for (S_TBSOLVED *s : solved)
+        delete s;
+    delete board;
+    if (clashes >= 0)
+        cout << "Test tables written to " << dir << " in " << GetTimeMs() - start << "ms, " << clashes
+             << " positions not stored" << endl;
+    return clashes;
+}
@@ -0,0 +1,398 @@
+//tune.cpp
+
+#include "defs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//The evaluation weights of evaluate.cpp and data.cpp
+extern int PawnTable[64], KnightTable[64], BishopTable[64], RookTable[64], KingE[64], KingO[64];
+extern int PawnIsolated, PawnPassed[8], RookOpenFile, RookSemiOpenFile, QueenOpenFile, QueenSemiOpenFile, BishopPair;
+
+//A group of weights tuned together, printed as one C declaration
+typedef struct {
+    const char *name;
+    int *values;
+    int count;
+    int material;   //TRUE for the piece values, which reach the evaluation through pos->material
+} S_TUNEGROUP;
+
+static S_TUNEGROUP TuneGroups[] = {
+    {"PieceVal",          PieceVal + wP, 5, TRUE},  //Pawn to queen. The black entries are kept equal.
+    {"PawnTable",         PawnTable,    64, FALSE},
+    {"KnightTable",       KnightTable,  64, FALSE},
+    {"BishopTable",       BishopTable,  64, FALSE},
+    {"RookTable",         RookTable,    64, FALSE},
+    {"KingE",             KingE,        64, FALSE},
+    {"KingO",             KingO,        64, FALSE},
+    {"PawnIsolated",      &PawnIsolated, 1, FALSE},
+    {"PawnPassed",        PawnPassed,    8, FALSE},
+    {"RookOpenFile",      &RookOpenFile, 1, FALSE},
+    {"RookSemiOpenFile",  &RookSemiOpenFile, 1, FALSE},
+    {"QueenOpenFile",     &QueenOpenFile, 1, FALSE},
+    {"QueenSemiOpenFile", &QueenSemiOpenFile, 1, FALSE},
+    {"BishopPair",        &BishopPair,   1, FALSE},
+};
+#define NUMGROUPS ((int)(sizeof(TuneGroups) / sizeof(TuneGroups[0])))
+
+//One non-zero term of a position's evaluation: the evaluation changes by coeff when the weight changes by 1
+typedef struct {
+    unsigned short index;   //The weight
+    short coeff;
+} S_TUNECOEFF;
+
+//A training position, reduced to what the loss needs. Its terms are coeffs[first] to coeffs[first + count - 1].
+typedef struct {
+    unsigned int first;
+    unsigned short count;
+    unsigned char result;   //For white, in half points: 0 loss, 1 draw, 2 win
+    short base;             //The part of the evaluation no weight touches
+} S_TUNEPOS;
+
+//The data set, held as flat arrays so an epoch just streams through memory
+typedef struct {
+    vector<int *> params;   //Every weight, in group order
+    vector<int> groupOf;    //The group of each weight
+    vector<S_TUNEPOS> positions;
+    vector<S_TUNECOEFF> coeffs;
+    long skipped;           //Positions left out: no result, bad FEN, or scored by a special endgame evaluator
+} S_TUNESET;
+
+
+/*
+    Name:    WhiteEval
+    Vars:    const S_BOARD *pos - Pointer to a position.
+    Returns: EvalPosition from white's point of view, which is what the game result is measured against.
+*/
+static int WhiteEval(const S_BOARD *pos) {
+    int score = EvalPosition(pos);
+    return (pos->side == WHITE)? score : -score;
+}
+
+
+/*
+    Name:    ReadResult
+    Vars:    const char *line - A FEN followed by the game result.
+    Purpose: Accept the usual labels of tuning sets: "1-0", "0-1", "1/2-1/2" (as a c9 opcode or bare) or [1.0], [0.5], [0.0].
+    Returns: The result for white in half points, or -1 if the line has none.
+*/
+int ReadResult(const char *line) {
+    if (strstr(line, "1/2-1/2") != NULL || strstr(line, "[0.5]") != NULL) return 1;
+    if (strstr(line, "1-0") != NULL || strstr(line, "[1.0]") != NULL || strstr(line, "[1]") != NULL) return 2;
+    if (strstr(line, "0-1") != NULL || strstr(line, "[0.0]") != NULL || strstr(line, "[0]") != NULL) return 0;
+    return -1;
+}
+
+
+/*
+    Name:    AddPosition
+    Vars:    S_TUNESET *set - The data set.
+             S_BOARD *pos   - The position.
+             int result     - The game result for white, in half points.
+    Purpose: Find how much each weight contributes to the position's evaluation, once, so the epochs never evaluate.
+             The evaluation is linear in its weights, so a weight's coefficient is the change in the evaluation when the
+             weight is raised by one. The piece values are counted from the material instead, since pos->material is
+             only computed when the position is set up. The coefficients are checked by rebuilding the evaluation.
+    Returns: TRUE if the position was added.
+*/
+static int AddPosition(S_TUNESET *set, S_BOARD *pos, int result) {
+    int dummy;
+    if (EvaluateEndgame(pos, &dummy))
+        return FALSE;
+
+    int eval = WhiteEval(pos);
+    S_TUNEPOS tp;
+    tp.first = (unsigned int)set->coeffs.size();
+    tp.result = (unsigned char)result;
+
+    long rebuilt = 0;
+    for (size_t i = 0; i < set->params.size(); ++i) {
+        int coeff;
+        if (TuneGroups[set->groupOf[i]].material) {
+            int pce = wP + (int)(set->params[i] - PieceVal - wP);
+            coeff = pos->pceNum[pce] - pos->pceNum[pce + bP - wP];
+        } else {
+            (*set->params[i])++;
+            coeff = WhiteEval(pos) - eval;
+            (*set->params[i])--;
+        }
+        if (coeff != 0) {
+            set->coeffs.push_back({(unsigned short)i, (short)coeff});
+            rebuilt += (long)coeff * *set->params[i];
+        }
+    }
+    tp.count = (unsigned short)(set->coeffs.size() - tp.first);
+    tp.base = (short)(eval - rebuilt);
+    set->positions.push_back(tp);
+    return TRUE;
+}
+
+
+/*
+    Name:    LoadTuneSet
+    Vars:    const char *file - Positions with game results, one per line, or a packed file.
+             S_TUNESET *set   - Filled with the data set.
+    Returns: TRUE if the file could be read.
+*/
+static int LoadTuneSet(const char *file, S_TUNESET *set) {
+    for (int g = 0; g < NUMGROUPS; ++g) {
+        for (int i = 0; i < TuneGroups[g].count; ++i) {
+            set->params.push_back(&TuneGroups[g].values[i]);
+            set->groupOf.push_back(g);
+        }
+    }
+
+    S_BOARD board[1];
+    ResetBoard(board);
+    set->skipped = 0;
+    int start = GetTimeMs();
+
+    S_PACKEDFILE pf;
+    if (OpenPackedFile(file, &pf)) {   //Packed positions decode without any text parsing
+        const S_PACKEDPOS *rec;
+        long decoded = 0;
+        while (ReadPacked(&pf, board, &rec)) {
+            decoded++;
+            if (rec->result < 0 || !AddPosition(set, board, rec->result))
+                set->skipped++;
+        }
+        set->skipped += pf.count - decoded;
+        ClosePackedFile(&pf);
+    } else {
+        FILE *f = fopen(file, "r");
+        if (f == NULL) {
+            printf("Could not open %s\n", file);
+            return FALSE;
+        }
+        char line[1024];
+        while (fgets(line, sizeof(line), f) != NULL) {
+            int result = ReadResult(line);
+            if (result < 0 || SetupFen(line, board, NULL) != NULL || !AddPosition(set, board, result))
+                set->skipped++;
+        }
+        fclose(f);
+    }
+
+    printf("Loaded %d positions (%ld skipped), %d weights, %.1f terms per position, %.1f MB, in %dms\n",
+           (int)set->positions.size(), set->skipped, (int)set->params.size(),
+           (set->positions.empty())? 0.0 : (double)set->coeffs.size() / set->positions.size(),
+           (set->positions.size() * sizeof(S_TUNEPOS) + set->coeffs.size() * sizeof(S_TUNECOEFF)) / 1048576.0,
+           GetTimeMs() - start);
+    return TRUE;
+}
+
+
+/*
+    Name:    Sigmoid
+    Vars:    double k    - Scaling constant.
+             double eval - Centipawns.
+    Returns: The expected score for an evaluation.
+*/
+static double Sigmoid(double k, double eval) {
+    return 1.0 / (1.0 + pow(10.0, -k * eval / 400.0));
+}
+
+
+/*
+    Name:    LossWorker
+    Vars:    const S_TUNESET *set - The data set.
+             const double *w      - The weights.
+             double k             - Scaling constant.
+             size_t begin, end    - The positions this worker covers.
+             double *loss         - Set to the summed squared error of the positions.
+             double *grad         - If not NULL, set to the summed gradient of the error. One entry per weight.
+*/
+static void LossWorker(const S_TUNESET *set, const double *w, double k, size_t begin, size_t end, double *loss, double *grad) {
+    const double dsig = k * log(10.0) / 400.0;
+    double sum = 0;
+
+    for (size_t p = begin; p < end; ++p) {
+        const S_TUNEPOS *tp = &set->positions[p];
+        const S_TUNECOEFF *c = &set->coeffs[tp->first];
+
+        double eval = tp->base;
+        for (int i = 0; i < tp->count; ++i)
+            eval += w[c[i].index] * c[i].coeff;
+
+        double s = Sigmoid(k, eval);
+        double err = tp->result / 2.0 - s;
+        sum += err * err;
+
+        if (grad != NULL) {
+            double d = -2.0 * err * s * (1.0 - s) * dsig;
+            for (int i = 0; i < tp->count; ++i)
+                grad[c[i].index] += d * c[i].coeff;
+        }
+    }
+    *loss = sum;
+}
+
+
+/*
+    Name:    Loss
+    Vars:    const S_TUNESET *set - The data set.
+             const double *w      - The weights.
+             double k             - Scaling constant.
+             int threads          - Worker threads. The positions are split between them evenly.
+             double *grad         - If not NULL, set to the gradient of the loss.
+    Purpose: Mean squared error between the game results and the expected scores. Each worker sums into its own gradient
+             so they never share a write, and the sums are added up once they finish.
+    Returns: The loss.
+*/
+static double Loss(const S_TUNESET *set, const double *w, double k, int threads, double *grad) {
+    size_t n = set->positions.size();
+    size_t numParams = set->params.size();
+    vector<double> losses(threads, 0);
+    vector<vector<double>> grads(threads, vector<double>((grad != NULL)? numParams : 0, 0));
+    vector<thread> workers;
+
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back(LossWorker, set, w, k, n * t / threads, n * (t + 1) / threads, &losses[t],
+                             (grad != NULL)? grads[t].data() : (double *)NULL);
+    for (thread &t : workers)
+        t.join();
+
+    double loss = 0;
+    for (int t = 0; t < threads; ++t)
+        loss += losses[t];
+    if (grad != NULL) {
+        for (size_t i = 0; i < numParams; ++i) {
+            grad[i] = 0;
+            for (int t = 0; t < threads; ++t)
+                grad[i] += grads[t][i];
+            grad[i] /= n;
+        }
+    }
+    return loss / n;
+}
+
+
+/*
+    Name:    FitK
+    Vars:    const S_TUNESET *set - The data set.
+             const double *w      - The starting weights.
+             int threads          - Worker threads.
+    Purpose: Find the scaling constant that best maps the current evaluation to results, so tuning changes the weights
+             rather than the overall scale of the evaluation. Golden section search.
+    Returns: The constant.
+*/
+static double FitK(const S_TUNESET *set, const double *w, int threads) {
+    double lo = 0.05, hi = 3.0;
+    const double phi = (sqrt(5.0) - 1) / 2;
+    double a = hi - phi * (hi - lo), b = lo + phi * (hi - lo);
+    double la = Loss(set, w, a, threads, NULL), lb = Loss(set, w, b, threads, NULL);
+
+    while (hi - lo > 0.001) {
+        if (la < lb) {
+            hi = b; b = a; lb = la;
+            a = hi - phi * (hi - lo);
+            la = Loss(set, w, a, threads, NULL);
+        } else {
+            lo = a; a = b; la = lb;
+            b = lo + phi * (hi - lo);
+            lb = Loss(set, w, b, threads, NULL);
+        }
+    }
+    return (lo + hi) / 2;
+}
+
+
+/*
+    Name:    PrintWeights
+    Vars:    FILE *f     - Where to write.
+             const double *w - The tuned weights, in group order.
+    Purpose: Write the weights as the C declarations of evaluate.cpp and data.cpp, rounded, ready to paste in.
+*/
+static void PrintWeights(FILE *f, const double *w) {
+    int index = 0;
+    for (int g = 0; g < NUMGROUPS; ++g) {
+        const S_TUNEGROUP *grp = &TuneGroups[g];
+        if (grp->material) {
+            int v[5];
+            for (int i = 0; i < 5; ++i)
+                v[i] = (int)lround(w[index + i]);
+            fprintf(f, "int PieceVal[13]  = {0, %d, %d, %d, %d, %d, 32767, %d, %d, %d, %d, %d, 32767};\n",
+                    v[0], v[1], v[2], v[3], v[4], v[0], v[1], v[2], v[3], v[4]);
+        } else if (grp->count == 64) {
+            fprintf(f, "\nint %s[64] = {\n", grp->name);
+            for (int i = 0; i < 64; ++i)
+                fprintf(f, "%s%4d%s", (i % 8 == 0)? "    " : " ", (int)lround(w[index + i]),
+                        (i == 63)? "\n" : (i % 8 == 7)? ",\n" : ",");
+            fprintf(f, "};\n");
+        } else if (grp->count > 1) {
+            fprintf(f, "int %s[%d] = {", grp->name, grp->count);
+            for (int i = 0; i < grp->count; ++i)
+                fprintf(f, "%s%d", (i)? ", " : "", (int)lround(w[index + i]));
+            fprintf(f, "};\n");
+        } else {
+            fprintf(f, "int %s = %d;\n", grp->name, (int)lround(w[index]));
+        }
+        index += grp->count;
+    }
+}
+
+
+/*
+    Name:    TuneEval
+    Vars:    const char *file    - Quiet positions with game results. Ex. lines of "<fen> c9 \"1-0\";" or "<fen> [0.5]"
+             int epochs          - Passes of gradient descent.
+             double rate         - Learning rate, in centipawns per step.
+             int threads         - Worker threads for the loss and gradient.
+             const char *outFile - Where the tuned weights are written, or NULL for stdout.
+    Purpose: Texel tuning. Every position is reduced once to the coefficients of the evaluation's weights, so an epoch is a
+             pass over compact arrays instead of parsing and evaluating positions. The scaling constant K is fitted to the
+             current weights, then the mean squared error between results and sigmoid(K * eval) is minimized with Adam.
+    Returns: The final loss, or -1 if there were no positions.
+*/
+double TuneEval(const char *file, int epochs, double rate, int threads, const char *outFile) {
+    S_TUNESET set;
+    if (!LoadTuneSet(file, &set) || set.positions.empty())
+        return -1;
+    if (threads < 1)
+        threads = 1;
+
+    size_t numParams = set.params.size();
+    vector<double> w(numParams), grad(numParams), m(numParams, 0), v(numParams, 0);
+    for (size_t i = 0; i < numParams; ++i)
+        w[i] = *set.params[i];
+
+    double k = FitK(&set, w.data(), threads);
+    double loss = Loss(&set, w.data(), k, threads, NULL);
+    printf("K %.3f  starting loss %.6f\n", k, loss);
+
+    const double beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+    int start = GetTimeMs();
+    for (int epoch = 1; epoch <= epochs; ++epoch) {
+        loss = Loss(&set, w.data(), k, threads, grad.data());
+        for (size_t i = 0; i < numParams; ++i) {
+            m[i] = beta1 * m[i] + (1 - beta1) * grad[i];
+            v[i] = beta2 * v[i] + (1 - beta2) * grad[i] * grad[i];
+            double mh = m[i] / (1 - pow(beta1, epoch));
+            double vh = v[i] / (1 - pow(beta2, epoch));
+            w[i] -= rate * mh / (sqrt(vh) + eps);
+        }
+        if (epoch % 10 == 0 || epoch == epochs) {
+            printf("Epoch %4d  loss %.6f  %.1f epochs/s\n", epoch, loss, 1000.0 * epoch / max(1, GetTimeMs() - start));
+            fflush(stdout);
+        }
+    }
+    loss = Loss(&set, w.data(), k, threads, NULL);
+    printf("Final loss %.6f\n\n", loss);
+
+    FILE *f = (outFile != NULL)? fopen(outFile, "w") : stdout;
+    if (f == NULL) {
+        printf("Could not write %s\n", outFile);
+        f = stdout;
+    }
+    PrintWeights(f, w.data());
+    if (f != stdout)
+        fclose(f);
+    return loss;
+}